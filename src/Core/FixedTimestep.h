@@ -0,0 +1,64 @@
+//
+// Created by Orgest on 10/29/2024.
+//
+
+#pragma once
+
+#include <algorithm>
+
+#include "PrimTypes.h"
+
+// Turns variable frame times into a whole number of fixed simulation steps. Time left over after the last step
+// carries into the next frame, Alpha() says how far into the next step the frame is so the renderer can blend the
+// last two simulation states. A frame is never allowed more than maxSteps steps: when the simulation can't keep up,
+// running more steps per frame would only make the next frame longer still (spiral of death), so the excess time is
+// dropped and the simulation slows down instead.
+class FixedTimestep
+{
+public:
+	explicit FixedTimestep(f64 rate = 60.0, u32 maxSteps = 8)
+		: m_Step(1.0 / rate), m_MaxSteps(maxSteps)
+	{
+	}
+
+	void SetRate(f64 rate) { m_Step = 1.0 / std::max(rate, 1.0); }
+	void SetMaxSteps(u32 maxSteps) { m_MaxSteps = std::max(maxSteps, 1u); }
+
+	// Adds the frame's time and returns how many steps to run before rendering it
+	u32 Advance(f64 frameSeconds)
+	{
+		m_Accumulator += std::max(frameSeconds, 0.0);
+
+		u32 steps = 0;
+		while (m_Accumulator >= m_Step && steps < m_MaxSteps)
+		{
+			m_Accumulator -= m_Step;
+			steps++;
+		}
+
+		if (m_Accumulator >= m_Step)
+		{
+			// Keep the fraction so the blend stays smooth, drop the whole steps
+			const u64 dropped = static_cast<u64>(m_Accumulator / m_Step);
+			m_Accumulator -= static_cast<f64>(dropped) * m_Step;
+			m_DroppedSteps += dropped;
+		}
+
+		m_LastSteps = steps;
+		return steps;
+	}
+
+	[[nodiscard]] f64 StepSeconds() const { return m_Step; }
+	[[nodiscard]] f64 Rate() const { return 1.0 / m_Step; }
+	// Blend factor between the previous and the latest simulation state, in [0, 1)
+	[[nodiscard]] f32 Alpha() const { return static_cast<f32>(m_Accumulator / m_Step); }
+	[[nodiscard]] u32 LastSteps() const { return m_LastSteps; }
+	[[nodiscard]] u64 DroppedSteps() const { return m_DroppedSteps; }
+
+private:
+	f64 m_Step;
+	u32 m_MaxSteps;
+	f64 m_Accumulator = 0.0;
+	u32 m_LastSteps = 0;
+	u64 m_DroppedSteps = 0;
+};
@@ -0,0 +1,137 @@
+//
+// Created by Orgest on 10/18/2024.
+//
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <memory>
+
+void JobSystem::Init(u32 threadCount)
+{
+	Shutdown();
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	stop_ = false;
+	workers_.reserve(threadCount);
+	for (u32 i = 0; i < threadCount; i++)
+	{
+		workers_.emplace_back(&JobSystem::WorkerLoop, this);
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	if (workers_.empty())
+	{
+		return;
+	}
+
+	Wait();
+	{
+		std::lock_guard lock(queueMutex_);
+		stop_ = true;
+	}
+	wakeCondition_.notify_all();
+
+	for (auto& worker : workers_)
+	{
+		worker.join();
+	}
+	workers_.clear();
+}
+
+void JobSystem::Execute(std::function<void()> job)
+{
+	if (workers_.empty())
+	{
+		job();
+		return;
+	}
+
+	pending_.fetch_add(1, std::memory_order_acq_rel);
+	{
+		std::lock_guard lock(queueMutex_);
+		queue_.push_back(std::move(job));
+	}
+	wakeCondition_.notify_one();
+}
+
+void JobSystem::Dispatch(u32 jobCount, u32 groupSize, const std::function<void(u32 index)>& job)
+{
+	if (jobCount == 0 || groupSize == 0)
+	{
+		return;
+	}
+
+	// One shared copy for every group, the caller's function may be a temporary
+	auto sharedJob = std::make_shared<std::function<void(u32)>>(job);
+
+	const u32 groupCount = (jobCount + groupSize - 1) / groupSize;
+	for (u32 group = 0; group < groupCount; group++)
+	{
+		Execute([sharedJob, group, groupSize, jobCount]
+		{
+			const u32 begin = group * groupSize;
+			const u32 end   = std::min(begin + groupSize, jobCount);
+			for (u32 i = begin; i < end; i++)
+			{
+				(*sharedJob)(i);
+			}
+		});
+	}
+}
+
+void JobSystem::Wait()
+{
+	// Help drain the queue instead of sleeping on it
+	while (RunOne())
+	{
+	}
+
+	std::unique_lock lock(queueMutex_);
+	doneCondition_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+}
+
+bool JobSystem::RunOne()
+{
+	std::function<void()> job;
+	{
+		std::lock_guard lock(queueMutex_);
+		if (queue_.empty())
+		{
+			return false;
+		}
+		job = std::move(queue_.front());
+		queue_.pop_front();
+	}
+
+	job();
+
+	if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		std::lock_guard lock(queueMutex_);
+		doneCondition_.notify_all();
+	}
+	return true;
+}
+
+void JobSystem::WorkerLoop()
+{
+	while (true)
+	{
+		{
+			std::unique_lock lock(queueMutex_);
+			wakeCondition_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+			if (stop_ && queue_.empty())
+			{
+				return;
+			}
+		}
+		RunOne();
+	}
+}
@@ -0,0 +1,53 @@
+//
+// Created by Orgest on 10/18/2024.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PrimTypes.h"
+
+// Small fixed-size worker pool. Jobs are plain functions, Dispatch() splits an index range into jobs and
+// Wait() blocks until everything that was queued has finished. Without Init() every job runs inline.
+class JobSystem
+{
+public:
+	JobSystem() = default;
+	~JobSystem() { Shutdown(); }
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// threadCount == 0 picks hardware_concurrency - 1 (the calling thread helps while waiting)
+	void Init(u32 threadCount = 0);
+	void Shutdown();
+
+	void Execute(std::function<void()> job);
+
+	// Runs job(index) for index in [0, jobCount), groupSize indices per queued job
+	void Dispatch(u32 jobCount, u32 groupSize, const std::function<void(u32 index)>& job);
+
+	void Wait();
+
+	[[nodiscard]] bool IsBusy() const { return pending_.load(std::memory_order_acquire) > 0; }
+	[[nodiscard]] u32  ThreadCount() const { return static_cast<u32>(workers_.size()); }
+
+private:
+	bool RunOne();
+	void WorkerLoop();
+
+	std::vector<std::thread>          workers_;
+	std::deque<std::function<void()>> queue_;
+	std::mutex                        queueMutex_;
+	std::condition_variable           wakeCondition_;
+	std::condition_variable           doneCondition_;
+	std::atomic<u32>                  pending_{0};
+	bool                              stop_ = false;
+};
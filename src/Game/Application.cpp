@@ -99,8 +99,10 @@ void Application::PlaySoundIfNeeded()
 void Application::Render()
 {
 #ifdef VULKAN_BUILD
-    // Draw the frame for Vulkan
-    vkEngine_.Draw();
+    // Draw one frame for Vulkan on this thread, Run draws on the engine's render thread instead
+    GraphicsAPI::Vulkan::RenderPacket packet;
+    vkEngine_.UpdateScene(packet);
+    vkEngine_.Draw(packet);
 #elif defined(OPENGL_BUILD)
     // Draw the frame for OpenGL
     // glEngine_.Draw();
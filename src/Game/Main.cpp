@@ -1,4 +1,6 @@
+#include <cstdlib>
 #include <iostream>
+#include <string_view>
 
 #include "../Platform/PlatformWindows.h"
 #include "../Renderer/Vulkan/VulkanMain.h"
@@ -24,11 +26,69 @@ void InitConsole()
 }
 #endif
 
-int main()
+#ifdef VULKAN_BUILD
+// --headless [frames] [readback.ppm]: renders offscreen without a window and exits, for automated runs
+int RunHeadless(int argc, char** argv)
+{
+	GraphicsAPI::Vulkan::HeadlessOptions options;
+	if (argc > 2)
+	{
+		options.frames = static_cast<u32>(std::strtoul(argv[2], nullptr, 10));
+	}
+	if (argc > 3)
+	{
+		options.readbackPath = argv[3];
+	}
+
+	GraphicsAPI::Vulkan::VkEngine engine{ options };
+	if (!engine.Init())
+	{
+		LOG(ERR, "Failed to initialize the headless Vulkan engine.");
+		return 1;
+	}
+	return engine.RunHeadless() ? 0 : 1;
+}
+
+// --material-benchmark [materials] [runs]: material descriptor writes, one update call per set against one batched
+// Flush, on a headless engine
+int RunMaterialBenchmark(int argc, char** argv)
+{
+	const u32 materials = argc > 2 ? static_cast<u32>(std::strtoul(argv[2], nullptr, 10)) : 2000;
+	const u32 runs = argc > 3 ? static_cast<u32>(std::strtoul(argv[3], nullptr, 10)) : 20;
+
+	GraphicsAPI::Vulkan::HeadlessOptions options;
+	options.frames = 0;
+	options.timingsPath.clear();
+	GraphicsAPI::Vulkan::VkEngine engine{ options };
+	if (!engine.Init())
+	{
+		LOG(ERR, "Failed to initialize the headless Vulkan engine.");
+		return 1;
+	}
+
+	const GraphicsAPI::Vulkan::MaterialWriteBenchmark result = engine.BenchmarkMaterialWrites(materials, runs);
+	LOG(INFO, "Material descriptor writes, ", result.materials, " sets averaged over ", result.runs, " runs: ",
+	    result.perSetMs, " ms with one update per set, ", result.batchedMs, " ms batched (flush ", result.flushMs,
+	    " ms)");
+	return 0;
+}
+#endif
+
+int main(int argc, char** argv)
 {
 	Logger::Init();
 
+
 #ifdef VULKAN_BUILD
+	if (argc > 1 && std::string_view(argv[1]) == "--headless")
+	{
+		return RunHeadless(argc, argv);
+	}
+	if (argc > 1 && std::string_view(argv[1]) == "--material-benchmark")
+	{
+		return RunMaterialBenchmark(argc, argv);
+	}
+
 #ifdef DEBUG
 	InitConsole();
 #endif
@@ -0,0 +1,76 @@
+//
+// Created by Orgest on 11/1/2024.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "../Core/PrimTypes.h"
+
+namespace GraphicsAPI
+{
+	// Picks the render scale from measured GPU frame time, a PI controller holding the time inside a band under the
+	// frame budget. GPU time follows the pixel count, the square of the scale, so the error is taken in scale units:
+	// how far the scale is from the one that would land the time in the middle of the band. The controller only acts
+	// when the time is over budget or under lowWater of it, in between it holds (the hysteresis keeping it from
+	// bouncing around the budget). Drops apply right away, growth smaller than minStep is held back
+	// so the resolution doesn't shimmer from frame to frame. Has no dependency on the graphics API.
+	class DynamicResolution
+	{
+	public:
+		// Starts from scale, with no history
+		void Reset(f32 scale)
+		{
+			integral_ = std::clamp(scale, minScale, maxScale);
+			scale_ = integral_;
+		}
+
+		// Feeds the GPU time of a finished frame, returns the scale to render the next one at. Unmeasured frames
+		// (0 ms) leave the scale alone.
+		f32 Update(f32 gpuMs)
+		{
+			lastGpuMs_ = gpuMs;
+			if (gpuMs <= 0.f)
+			{
+				return scale_;
+			}
+
+			const f32 budgetMs = BudgetMs();
+			const f32 lowMs = budgetMs * lowWater;
+			const f32 error = gpuMs > budgetMs || gpuMs < lowMs
+				? scale_ * (std::sqrt((budgetMs + lowMs) * 0.5f / gpuMs) - 1.f)
+				: 0.f;
+
+			// Clamped so a long stay at either end doesn't wind the integral up
+			integral_ = std::clamp(integral_ + ki * error, minScale, maxScale);
+			const f32 desired = std::clamp(integral_ + kp * error, minScale, maxScale);
+			if (desired < scale_ || desired - scale_ >= minStep || desired == maxScale)
+			{
+				scale_ = desired;
+			}
+			return scale_;
+		}
+
+		[[nodiscard]] f32 Scale() const { return scale_; }
+		[[nodiscard]] f32 LastGpuMs() const { return lastGpuMs_; }
+		// GPU time allowed per frame, the rest of the frame period is left for jitter
+		[[nodiscard]] f32 BudgetMs() const { return 1000.f / std::max(targetHz, 1.f) * budget; }
+
+		bool enabled  = true;
+		f32 targetHz  = 60.f;
+		f32 budget    = 0.9f;  // fraction of the frame period the GPU may take
+		f32 lowWater  = 0.8f;  // fraction of the budget below which the scale grows again
+		f32 minScale  = 0.5f;
+		f32 maxScale  = 1.0f;
+		f32 minStep   = 0.025f;
+		f32 kp        = 0.35f;
+		f32 ki        = 0.15f;
+
+	private:
+		f32 integral_  = 1.f;
+		f32 scale_     = 1.f;
+		f32 lastGpuMs_ = 0.f;
+	};
+}
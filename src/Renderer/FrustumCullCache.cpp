@@ -0,0 +1,203 @@
+//
+// Created by Orgest on 10/31/2024.
+//
+
+#include "FrustumCullCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace GraphicsAPI;
+
+namespace
+{
+	// Added to the measured camera motion, covers the rounding in the quaternion angle and the plane distances
+	constexpr f32 MOTION_EPSILON = 1e-3f;
+}
+
+void FrustumCullCache::BeginFrame(const glm::mat4& view, const glm::mat4& proj, f32 nearPlane)
+{
+	stats_ = { .rebases = stats_.rebases };
+
+	const glm::mat4 vp = proj * view;
+	const glm::vec4 row0(vp[0][0], vp[1][0], vp[2][0], vp[3][0]);
+	const glm::vec4 row1(vp[0][1], vp[1][1], vp[2][1], vp[3][1]);
+	const glm::vec4 row3(vp[0][3], vp[1][3], vp[2][3], vp[3][3]);
+	planes_[0] = row3 + row0;
+	planes_[1] = row3 - row0;
+	planes_[2] = row3 + row1;
+	planes_[3] = row3 - row1;
+	planes_[4] = glm::vec4(-view[0][2], -view[1][2], -view[2][2], -view[3][2] - nearPlane);
+	for (glm::vec4& plane : planes_)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	eye_ = glm::vec3(glm::inverse(view)[3]);
+	const glm::quat rotation = glm::quat_cast(glm::mat3(view));
+
+	// Side planes turn with the camera around the eye, a changed projection moves them in ways the bound can't cover
+	drift_ = glm::distance(eye_, referenceEye_) + MOTION_EPSILON;
+	turn_ = 2.f * std::acos(std::min(std::abs(glm::dot(rotation, referenceRotation_)), 1.f)) + MOTION_EPSILON;
+	if (proj != referenceProj_ || nearPlane != referenceNear_ || drift_ > maxDrift || turn_ > maxAngle)
+	{
+		referenceEye_ = eye_;
+		referenceRotation_ = rotation;
+		referenceProj_ = proj;
+		referenceNear_ = nearPlane;
+		drift_ = MOTION_EPSILON;
+		turn_ = MOTION_EPSILON;
+		std::ranges::fill(slack_, -1.f);
+		stats_.rebases++;
+	}
+}
+
+void FrustumCullCache::ResetStatic(u32 count)
+{
+	visible_.assign(count, 1);
+	slack_.assign(count, -1.f);
+	reach_.assign(count, 0.f);
+}
+
+bool FrustumCullCache::IsStaticVisible(u32 index, const glm::vec4& sphere)
+{
+	if (!enabled)
+	{
+		return true;
+	}
+
+	// Reference motion of the camera now and when the result was taken together bound its motion since
+	if (temporal && drift_ + turn_ * reach_[index] < slack_[index])
+	{
+		stats_.staticReused++;
+		stats_.culled += visible_[index] ? 0 : 1;
+		return visible_[index];
+	}
+
+	stats_.staticTested++;
+	f32 margin;
+	const bool visible = Test(sphere, margin);
+
+	// The eye may end up maxDrift from the reference on either side, the turn acts over that much more distance
+	reach_[index] = glm::distance(glm::vec3(sphere), eye_) + 2.f * maxDrift;
+	slack_[index] = margin - drift_ - turn_ * reach_[index];
+	visible_[index] = visible ? 1 : 0;
+	stats_.culled += visible ? 0 : 1;
+	return visible;
+}
+
+bool FrustumCullCache::IsVisible(const glm::vec4& sphere)
+{
+	if (!enabled)
+	{
+		return true;
+	}
+
+	stats_.dynamicTested++;
+	f32 margin;
+	const bool visible = Test(sphere, margin);
+	stats_.culled += visible ? 0 : 1;
+	return visible;
+}
+
+bool FrustumCullCache::Test(const glm::vec4& sphere, f32& margin) const
+{
+	const glm::vec3 center(sphere);
+	const f32 radius = sphere.w;
+
+	// Visible stays visible until some plane gets the whole sphere behind it, culled stays culled while the plane
+	// rejecting it furthest still does
+	f32 inside = std::numeric_limits<f32>::max();
+	f32 outside = 0.f;
+	for (const glm::vec4& plane : planes_)
+	{
+		const f32 distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		inside = std::min(inside, distance + radius);
+		outside = std::max(outside, -radius - distance);
+	}
+
+	const bool visible = outside <= 0.f;
+	margin = visible ? inside : outside;
+	return visible;
+}
+
+FrustumCullBenchmark GraphicsAPI::BenchmarkFrustumCulling(u32 objectCount, u32 frames)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	// A square city of buildings and props, deterministic between runs
+	std::vector<glm::vec4> spheres(objectCount);
+	const u32 side = std::max(static_cast<u32>(std::sqrt(static_cast<f64>(objectCount))), 1u);
+	constexpr f32 spacing = 6.f;
+	u32 seed = 0x9E3779B9u;
+	auto random = [&]
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<f32>(seed >> 8) / static_cast<f32>(1u << 24);
+	};
+	for (u32 i = 0; i < objectCount; i++)
+	{
+		const f32 x = (static_cast<f32>(i % side) - static_cast<f32>(side) * 0.5f) * spacing;
+		const f32 z = (static_cast<f32>(i / side) - static_cast<f32>(side) * 0.5f) * spacing;
+		spheres[i] = { x + random() * 2.f, random() * 20.f, z + random() * 2.f, 0.5f + random() * 3.f };
+	}
+
+	FrustumCullCache full;
+	FrustumCullCache cached;
+	full.temporal = false;
+	full.ResetStatic(objectCount);
+	cached.ResetStatic(objectCount);
+
+	std::vector<u8> fullVisible(objectCount);
+	std::vector<u8> cachedVisible(objectCount);
+	FrustumCullBenchmark result{ .objects = objectCount, .frames = frames };
+	const glm::mat4 proj = glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.1f, 10000.f);
+	Clock::duration fullTime{}, cachedTime{};
+	u64 retested = 0;
+
+	// 60 Hz fly-through at street level, 12 units a second along a slow S curve while looking around
+	const f32 extent = static_cast<f32>(side) * spacing * 0.4f;
+	for (u32 frame = 0; frame < frames; frame++)
+	{
+		const f32 t = static_cast<f32>(frame) / 60.f;
+		const glm::vec3 eye(std::sin(t * 0.1f) * extent, 8.f + std::sin(t * 0.5f) * 4.f, -extent + t * 12.f);
+		const f32 yaw = std::sin(t * 0.3f) * 0.8f;
+		const glm::vec3 forward(std::sin(yaw), -0.1f, std::cos(yaw));
+		const glm::mat4 view = glm::lookAt(eye, eye + forward, glm::vec3(0.f, 1.f, 0.f));
+
+		Clock::time_point start = Clock::now();
+		full.BeginFrame(view, proj, 0.1f);
+		for (u32 i = 0; i < objectCount; i++)
+		{
+			fullVisible[i] = full.IsStaticVisible(i, spheres[i]) ? 1 : 0;
+		}
+		fullTime += Clock::now() - start;
+
+		start = Clock::now();
+		cached.BeginFrame(view, proj, 0.1f);
+		for (u32 i = 0; i < objectCount; i++)
+		{
+			cachedVisible[i] = cached.IsStaticVisible(i, spheres[i]) ? 1 : 0;
+		}
+		cachedTime += Clock::now() - start;
+
+		for (u32 i = 0; i < objectCount; i++)
+		{
+			result.mismatches += cachedVisible[i] != fullVisible[i] ? 1 : 0;
+		}
+		retested += cached.GetStats().staticTested;
+	}
+
+	if (frames > 0)
+	{
+		const f64 perFrame = 1.0 / static_cast<f64>(frames);
+		result.fullMs = std::chrono::duration<f64, std::milli>(fullTime).count() * perFrame;
+		result.temporalMs = std::chrono::duration<f64, std::milli>(cachedTime).count() * perFrame;
+		result.retestedPerFrame = static_cast<f64>(retested) * perFrame;
+	}
+	return result;
+}
@@ -0,0 +1,94 @@
+//
+// Created by Orgest on 10/31/2024.
+//
+
+#pragma once
+
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "../Core/PrimTypes.h"
+
+namespace GraphicsAPI
+{
+	// CPU frustum culling of bounding spheres that remembers its answers between frames. Static objects are tested
+	// once and keep their result for as long as the camera stays in the region where it provably can't change: every
+	// result carries the distance its sphere sits from flipping (its margin), and a camera that moved t units and
+	// turned a radians from where the result was taken shifts a plane by at most t + a * distance. Objects deep inside
+	// or far outside the frustum are reused for many frames, the ones near an edge are re-tested as soon as the camera
+	// moves. Dynamic objects are a separate set and tested every frame.
+	//
+	// Camera motion is measured from a reference pose. Once it drifts past maxDrift / maxAngle, or the projection
+	// changes, the reference moves to the current camera and every static object is re-tested. Reused results always
+	// equal what a full re-test would give.
+	//
+	// Side planes come from the rows of viewProj and the near plane from the view, the far plane is left out.
+	class FrustumCullCache
+	{
+	public:
+		struct Stats
+		{
+			u32 staticTested{};
+			u32 staticReused{};
+			u32 dynamicTested{};
+			u32 culled{};
+			u32 rebases{}; // in total, every frame since the last one re-tested all static objects
+		};
+
+		void BeginFrame(const glm::mat4& view, const glm::mat4& proj, f32 nearPlane);
+
+		// Forgets the static results and sizes the set, call whenever the static objects change
+		void ResetStatic(u32 count);
+
+		// Static object by its index into the set, sphere is world space xyz center and w radius
+		[[nodiscard]] bool IsStaticVisible(u32 index, const glm::vec4& sphere);
+		// Any object, always tested
+		[[nodiscard]] bool IsVisible(const glm::vec4& sphere);
+
+		[[nodiscard]] const Stats& GetStats() const { return stats_; }
+
+		bool enabled = true;
+		bool temporal = true;  // reuse static results, otherwise every object is re-tested every frame
+		f32 maxDrift = 16.f;   // camera travel in world units before the reference pose moves
+		f32 maxAngle = 0.5f;   // camera turn in radians before the reference pose moves
+
+	private:
+		// Smallest change of any plane distance that could flip the sphere's result
+		bool Test(const glm::vec4& sphere, f32& margin) const;
+
+		glm::vec4 planes_[5]{};
+		glm::vec3 eye_{ 0.f };
+
+		glm::vec3 referenceEye_{ 0.f };
+		glm::quat referenceRotation_{ 1.f, 0.f, 0.f, 0.f };
+		glm::mat4 referenceProj_{ 0.f };
+		f32 referenceNear_ = 0.f;
+		f32 drift_ = 0.f; // camera distance from the reference eye this frame
+		f32 turn_  = 0.f; // camera angle from the reference rotation this frame
+
+		// Per static object: result, the margin left once the camera drift at test time is paid for, and the
+		// distance the camera's turn is scaled by
+		std::vector<u8>  visible_;
+		std::vector<f32> slack_;
+		std::vector<f32> reach_;
+
+		Stats stats_{};
+	};
+
+	struct FrustumCullBenchmark
+	{
+		u32 objects{};
+		u32 frames{};
+		f64 fullMs{};      // per frame, every object tested
+		f64 temporalMs{};  // per frame, static results reused
+		f64 retestedPerFrame{};
+		u32 mismatches{};  // results that differ between the two, anything but 0 is a bug
+	};
+
+	// Flies a camera through a synthetic city of objectCount static spheres and culls every frame both ways.
+	// Needs no graphics API, see the CullBenchmark target.
+	FrustumCullBenchmark BenchmarkFrustumCulling(u32 objectCount, u32 frames);
+}
@@ -0,0 +1,308 @@
+//
+// Created by Orgest on 10/19/2024.
+//
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+namespace GraphicsAPI
+{
+	namespace
+	{
+		// Symmetric 4x4 error quadric, upper triangle only
+		struct Quadric
+		{
+			f64 a00{}, a01{}, a02{}, a03{};
+			f64 a11{}, a12{}, a13{};
+			f64 a22{}, a23{};
+			f64 a33{};
+
+			void AddPlane(const glm::dvec3& n, f64 d)
+			{
+				a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z; a03 += n.x * d;
+				a11 += n.y * n.y; a12 += n.y * n.z; a13 += n.y * d;
+				a22 += n.z * n.z; a23 += n.z * d;
+				a33 += d * d;
+			}
+
+			Quadric& operator+=(const Quadric& o)
+			{
+				a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03;
+				a11 += o.a11; a12 += o.a12; a13 += o.a13;
+				a22 += o.a22; a23 += o.a23;
+				a33 += o.a33;
+				return *this;
+			}
+
+			// v^T Q v for v = (p, 1), the sum of squared distances to every accumulated plane
+			[[nodiscard]] f64 Evaluate(const glm::vec3& p) const
+			{
+				const f64 x = p.x, y = p.y, z = p.z;
+				return x * x * a00 + 2.0 * x * y * a01 + 2.0 * x * z * a02 + 2.0 * x * a03
+				     + y * y * a11 + 2.0 * y * z * a12 + 2.0 * y * a13
+				     + z * z * a22 + 2.0 * z * a23
+				     + a33;
+			}
+		};
+
+		struct Collapse
+		{
+			u32 from;
+			u32 to;
+			f64 cost;
+		};
+
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				u32 bits[3];
+				std::memcpy(bits, &p, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+
+		// Would moving vertex `from` onto `to` flip any of the triangles around it
+		bool FlipsTriangle(std::span<const glm::vec3> positions, std::span<const u32> triangles,
+		                   std::span<const u32> adjacency, u32 from, u32 to)
+		{
+			for (const u32 tri : adjacency)
+			{
+				const u32* corner = &triangles[tri * 3];
+				if (corner[0] == to || corner[1] == to || corner[2] == to)
+				{
+					continue; // collapses away
+				}
+
+				glm::vec3 p[3];
+				glm::vec3 moved[3];
+				for (u32 i = 0; i < 3; i++)
+				{
+					p[i]     = positions[corner[i]];
+					moved[i] = corner[i] == from ? positions[to] : p[i];
+				}
+
+				const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				const glm::vec3 after  = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+				if (glm::dot(before, after) <= 0.f)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+	}
+
+	std::vector<u32> MeshSimplifier::Simplify(std::span<const glm::vec3> positions, std::span<const u32> indices,
+	                                          size_t targetIndexCount, f32 maxError, f32* outError)
+	{
+		std::vector<u32> triangles(indices.begin(), indices.end());
+		triangles.resize(triangles.size() / 3 * 3);
+
+		const auto vertexCount = static_cast<u32>(positions.size());
+
+		// Vertices that share a position (uv / normal seams) are welded for the error metric and locked in place
+		std::vector<u32> canonical(vertexCount);
+		std::vector<u8>  locked(vertexCount, 0);
+		{
+			std::unordered_map<glm::vec3, u32, PositionHash> firstAtPosition;
+			firstAtPosition.reserve(vertexCount);
+			for (u32 v = 0; v < vertexCount; v++)
+			{
+				auto [it, inserted] = firstAtPosition.try_emplace(positions[v], v);
+				canonical[v] = it->second;
+				if (!inserted)
+				{
+					locked[v]          = 1;
+					locked[it->second] = 1;
+				}
+			}
+		}
+
+		// Open border edges are used by exactly one triangle, their vertices stay put so the outline doesn't shrink
+		{
+			std::unordered_map<u64, u32> edgeUse;
+			edgeUse.reserve(triangles.size());
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				for (u32 e = 0; e < 3; e++)
+				{
+					u32 a = canonical[triangles[i + e]];
+					u32 b = canonical[triangles[i + (e + 1) % 3]];
+					if (a > b)
+					{
+						std::swap(a, b);
+					}
+					edgeUse[static_cast<u64>(a) << 32 | b]++;
+				}
+			}
+			for (const auto& [key, count] : edgeUse)
+			{
+				if (count == 1)
+				{
+					locked[static_cast<u32>(key >> 32)]   = 1;
+					locked[static_cast<u32>(key & ~0u)] = 1;
+				}
+			}
+			for (u32 v = 0; v < vertexCount; v++)
+			{
+				locked[v] |= locked[canonical[v]];
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < triangles.size(); i += 3)
+		{
+			const glm::dvec3 p0 = positions[triangles[i + 0]];
+			const glm::dvec3 p1 = positions[triangles[i + 1]];
+			const glm::dvec3 p2 = positions[triangles[i + 2]];
+
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const f64 length  = glm::length(normal);
+			if (length <= 0.0)
+			{
+				continue;
+			}
+			normal /= length;
+
+			Quadric plane;
+			plane.AddPlane(normal, -glm::dot(normal, p0));
+			quadrics[canonical[triangles[i + 0]]] += plane;
+			quadrics[canonical[triangles[i + 1]]] += plane;
+			quadrics[canonical[triangles[i + 2]]] += plane;
+		}
+
+		const f64 errorLimit  = static_cast<f64>(maxError) * maxError;
+		f64       resultError = 0.0;
+
+		std::vector<Collapse> collapses;
+		std::vector<u32>      adjacencyOffsets(vertexCount + 1);
+		std::vector<u32>      adjacency;
+		std::vector<u32>      remap(vertexCount);
+		std::vector<u8>       touched(vertexCount);
+
+		// Each pass collapses the cheapest independent edges, then compacts the triangle list
+		while (triangles.size() > targetIndexCount)
+		{
+			const auto triangleCount = static_cast<u32>(triangles.size() / 3);
+
+			collapses.clear();
+			for (u32 i = 0; i < triangleCount * 3; i += 3)
+			{
+				for (u32 e = 0; e < 3; e++)
+				{
+					const u32 a = triangles[i + e];
+					const u32 b = triangles[i + (e + 1) % 3];
+					for (const auto& [from, to] : {std::pair{a, b}, std::pair{b, a}})
+					{
+						if (locked[from])
+						{
+							continue;
+						}
+						Quadric q = quadrics[canonical[from]];
+						q += quadrics[canonical[to]];
+						collapses.push_back({from, to, q.Evaluate(positions[to])});
+					}
+				}
+			}
+			if (collapses.empty())
+			{
+				break;
+			}
+			std::ranges::sort(collapses, {}, &Collapse::cost);
+
+			std::ranges::fill(adjacencyOffsets, 0u);
+			for (const u32 v : triangles)
+			{
+				adjacencyOffsets[v + 1]++;
+			}
+			for (u32 v = 0; v < vertexCount; v++)
+			{
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			adjacency.resize(triangles.size());
+			{
+				std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (u32 i = 0; i < triangleCount * 3; i++)
+				{
+					adjacency[fill[triangles[i]]++] = i / 3;
+				}
+			}
+
+			for (u32 v = 0; v < vertexCount; v++)
+			{
+				remap[v] = v;
+			}
+			std::ranges::fill(touched, u8{0});
+
+			size_t remainingIndices = triangles.size();
+			u32    collapsed        = 0;
+			for (const Collapse& c : collapses)
+			{
+				if (c.cost > errorLimit || remainingIndices <= targetIndexCount)
+				{
+					break;
+				}
+				if (touched[c.from] || touched[c.to])
+				{
+					continue;
+				}
+
+				const std::span<const u32> around(adjacency.data() + adjacencyOffsets[c.from],
+				                                  adjacencyOffsets[c.from + 1] - adjacencyOffsets[c.from]);
+				if (FlipsTriangle(positions, triangles, around, c.from, c.to))
+				{
+					continue;
+				}
+
+				// The triangles around `from` may not change again this pass
+				for (const u32 tri : around)
+				{
+					const u32* corner = &triangles[tri * 3];
+					touched[corner[0]] = touched[corner[1]] = touched[corner[2]] = 1;
+					if (corner[0] == c.to || corner[1] == c.to || corner[2] == c.to)
+					{
+						remainingIndices -= 3;
+					}
+				}
+
+				remap[c.from] = c.to;
+				quadrics[canonical[c.to]] += quadrics[canonical[c.from]];
+				resultError = std::max(resultError, c.cost);
+				collapsed++;
+			}
+
+			if (collapsed == 0)
+			{
+				break;
+			}
+
+			size_t write = 0;
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				const u32 a = remap[triangles[i + 0]];
+				const u32 b = remap[triangles[i + 1]];
+				const u32 c = remap[triangles[i + 2]];
+				if (a == b || b == c || a == c)
+				{
+					continue;
+				}
+				triangles[write++] = a;
+				triangles[write++] = b;
+				triangles[write++] = c;
+			}
+			triangles.resize(write);
+		}
+
+		if (outError)
+		{
+			*outError = static_cast<f32>(std::sqrt(resultError));
+		}
+		return triangles;
+	}
+}
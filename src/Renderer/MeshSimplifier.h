@@ -0,0 +1,27 @@
+//
+// Created by Orgest on 10/19/2024.
+//
+
+#pragma once
+
+#include <span>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "../Core/PrimTypes.h"
+
+namespace GraphicsAPI
+{
+	// Quadric error metric edge collapse (Garland & Heckbert) used to build LOD chains at import time.
+	// Vertices are never moved, an edge collapses onto one of its endpoints so the simplified index list still
+	// references the original vertex buffer. Open borders and attribute seams (several vertices sharing one
+	// position) are locked so LODs don't tear or crack.
+	class MeshSimplifier
+	{
+	public:
+		// Simplifies the triangle list until it has at most targetIndexCount indices or the next collapse would
+		// exceed maxError (object space distance). outError receives the largest error actually introduced.
+		static std::vector<u32> Simplify(std::span<const glm::vec3> positions, std::span<const u32> indices,
+		                                 size_t targetIndexCount, f32 maxError, f32* outError = nullptr);
+	};
+}
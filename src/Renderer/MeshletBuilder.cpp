@@ -0,0 +1,208 @@
+//
+// Created by Orgest on 10/20/2024.
+//
+
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace GraphicsAPI
+{
+	namespace
+	{
+		constexpr u32 NO_MESHLET = ~0u;
+
+		void ComputeBounds(std::span<const glm::vec3> positions, std::span<const u32> triangles, bool flippedWinding,
+		                   bool coneCulling, Meshlet& meshlet)
+		{
+			glm::vec3 minPos = positions[triangles[0]];
+			glm::vec3 maxPos = minPos;
+			for (const u32 v : triangles)
+			{
+				minPos = glm::min(minPos, positions[v]);
+				maxPos = glm::max(maxPos, positions[v]);
+			}
+
+			meshlet.center = (minPos + maxPos) * 0.5f;
+			meshlet.radius = 0.f;
+			for (const u32 v : triangles)
+			{
+				meshlet.radius = std::max(meshlet.radius, glm::length(positions[v] - meshlet.center));
+			}
+
+			meshlet.coneAxis   = glm::vec3(0.f, 0.f, 1.f);
+			meshlet.coneCutoff = MeshletBuilder::CONE_DISABLED;
+			if (!coneCulling)
+			{
+				return;
+			}
+
+			// Average of the unit face normals, then the widest deviation from it bounds the cone
+			std::vector<glm::vec3> normals;
+			normals.reserve(triangles.size() / 3);
+			glm::vec3 axis(0.f);
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				const glm::vec3& p0 = positions[triangles[i + 0]];
+				glm::vec3 normal = glm::cross(positions[triangles[i + 1]] - p0, positions[triangles[i + 2]] - p0);
+				const f32 length = glm::length(normal);
+				if (length <= 0.f)
+				{
+					continue;
+				}
+				normal = normal / (flippedWinding ? -length : length);
+				normals.push_back(normal);
+				axis += normal;
+			}
+
+			const f32 axisLength = glm::length(axis);
+			if (normals.empty() || axisLength <= 0.f)
+			{
+				return;
+			}
+			axis = axis / axisLength;
+
+			f32 minDot = 1.f;
+			for (const glm::vec3& normal : normals)
+			{
+				minDot = std::min(minDot, glm::dot(normal, axis));
+			}
+
+			// Cones wider than ~85 degrees almost never cull anything, skip the test for them
+			if (minDot <= 0.1f)
+			{
+				return;
+			}
+
+			meshlet.coneAxis   = axis;
+			meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+		}
+	}
+
+	std::vector<Meshlet> MeshletBuilder::Build(std::span<const glm::vec3> positions, std::span<u32> indices,
+	                                           bool flippedWinding, bool coneCulling)
+	{
+		std::vector<Meshlet> meshlets;
+
+		const auto triangleCount = static_cast<u32>(indices.size() / 3);
+		const auto vertexCount   = static_cast<u32>(positions.size());
+		if (triangleCount == 0)
+		{
+			return meshlets;
+		}
+
+		// vertex -> triangles adjacency
+		std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+		for (u32 i = 0; i < triangleCount * 3; i++)
+		{
+			adjacencyOffsets[indices[i] + 1]++;
+		}
+		for (u32 v = 0; v < vertexCount; v++)
+		{
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		std::vector<u32> adjacency(triangleCount * 3);
+		{
+			std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (u32 i = 0; i < triangleCount * 3; i++)
+			{
+				adjacency[fill[indices[i]]++] = i / 3;
+			}
+		}
+
+		std::vector<u8>  emitted(triangleCount, 0);
+		std::vector<u32> vertexMeshlet(vertexCount, NO_MESHLET); // which meshlet last used the vertex
+		std::vector<u32> reordered;
+		reordered.reserve(triangleCount * 3);
+
+		auto newVertices = [&](u32 tri, u32 meshletIndex)
+		{
+			u32 count = 0;
+			for (u32 k = 0; k < 3; k++)
+			{
+				count += vertexMeshlet[indices[tri * 3 + k]] != meshletIndex;
+			}
+			return count;
+		};
+
+		u32 cursor = 0;
+		while (true)
+		{
+			while (cursor < triangleCount && emitted[cursor])
+			{
+				cursor++;
+			}
+			if (cursor == triangleCount)
+			{
+				break;
+			}
+
+			const auto meshletIndex = static_cast<u32>(meshlets.size());
+			Meshlet meshlet{};
+			meshlet.firstIndex = static_cast<u32>(reordered.size());
+
+			u32 next = cursor;
+			while (next != NO_MESHLET)
+			{
+				const u32 tri = next;
+				emitted[tri] = 1;
+				meshlet.vertexCount += newVertices(tri, meshletIndex);
+				meshlet.triangleCount++;
+				for (u32 k = 0; k < 3; k++)
+				{
+					vertexMeshlet[indices[tri * 3 + k]] = meshletIndex;
+					reordered.push_back(indices[tri * 3 + k]);
+				}
+
+				if (meshlet.triangleCount == MAX_TRIANGLES)
+				{
+					break;
+				}
+
+				// Grow through the triangles around the last one, preferring those that add the fewest vertices
+				next = NO_MESHLET;
+				u32 bestCost = 4;
+				for (u32 k = 0; k < 3 && bestCost > 0; k++)
+				{
+					const u32 v = indices[tri * 3 + k];
+					for (u32 a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+					{
+						const u32 candidate = adjacency[a];
+						if (emitted[candidate])
+						{
+							continue;
+						}
+						const u32 cost = newVertices(candidate, meshletIndex);
+						if (cost < bestCost && meshlet.vertexCount + cost <= MAX_VERTICES)
+						{
+							bestCost = cost;
+							next     = candidate;
+						}
+					}
+				}
+
+				// Disconnected pieces (e.g. separate quads) still fill the meshlet in index order
+				if (next == NO_MESHLET)
+				{
+					while (cursor < triangleCount && emitted[cursor])
+					{
+						cursor++;
+					}
+					if (cursor < triangleCount && meshlet.vertexCount + newVertices(cursor, meshletIndex) <= MAX_VERTICES)
+					{
+						next = cursor;
+					}
+				}
+			}
+
+			ComputeBounds(positions, std::span(reordered).subspan(meshlet.firstIndex, meshlet.triangleCount * 3),
+			              flippedWinding, coneCulling, meshlet);
+			meshlets.push_back(meshlet);
+		}
+
+		std::ranges::copy(reordered, indices.begin());
+		return meshlets;
+	}
+}
@@ -0,0 +1,43 @@
+//
+// Created by Orgest on 10/20/2024.
+//
+
+#pragma once
+
+#include <span>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "../Core/PrimTypes.h"
+
+namespace GraphicsAPI
+{
+	struct Meshlet
+	{
+		u32 firstIndex;    // relative to the start of the index range passed to Build
+		u32 triangleCount;
+		u32 vertexCount;
+
+		// Bounding sphere and normal cone, the cone is disabled (cutoff > 1) when the triangles face too many ways
+		glm::vec3 center;
+		f32       radius;
+		glm::vec3 coneAxis;
+		f32       coneCutoff;
+	};
+
+	// Splits a triangle list into small spatially coherent clusters for GPU cluster culling. Triangles are
+	// reordered in place so every meshlet is a contiguous index range, no mesh shader vertex remapping needed.
+	class MeshletBuilder
+	{
+	public:
+		static constexpr u32 MAX_VERTICES  = 64;
+		static constexpr u32 MAX_TRIANGLES = 124;
+
+		// Cone value that never passes the backface test, used for double sided surfaces
+		static constexpr f32 CONE_DISABLED = 2.f;
+
+		// flippedWinding: front faces are clockwise (e.g. after mirroring Z on import)
+		static std::vector<Meshlet> Build(std::span<const glm::vec3> positions, std::span<u32> indices,
+		                                  bool flippedWinding, bool coneCulling = true);
+	};
+}
@@ -0,0 +1,659 @@
+//
+// Created by Orgest on 10/18/2024.
+//
+
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OCCLUSION_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2 1
+#endif
+
+using namespace GraphicsAPI;
+
+namespace
+{
+	// Anything closer than this (in clip w) counts as crossing the near plane
+	constexpr f32 NEAR_W = 1e-3f;
+
+	// Lanes processed per step, buffer width is padded to a multiple of 8 either way
+#if defined(OCCLUSION_AVX2)
+	constexpr u32 LANES = 8;
+#elif defined(OCCLUSION_SSE2)
+	constexpr u32 LANES = 4;
+#else
+	constexpr u32 LANES = 1;
+#endif
+}
+
+void OcclusionCuller::Init(u32 width, u32 height)
+{
+	width_  = (std::max(width, 8u) + 7u) & ~7u;
+	height_ = std::max(height, 1u);
+	depth_.assign(static_cast<size_t>(width_) * height_, 0.f);
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProj)
+{
+	viewProj_ = viewProj;
+	occluders_.clear();
+	stats_ = {};
+}
+
+void OcclusionCuller::AddOccluder(std::span<const glm::vec3> positions, std::span<const u32> indices,
+                                  const glm::mat4& world)
+{
+	if (positions.empty() || indices.size() < 3)
+	{
+		return;
+	}
+
+	occluders_.push_back({
+		.positions = positions,
+		.indices = indices,
+		.world = world,
+		.firstVertex = 0
+	});
+	stats_.occluders++;
+	stats_.occluderTriangles += static_cast<u32>(indices.size() / 3);
+}
+
+void OcclusionCuller::Rasterize(JobSystem* jobs)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	if (depth_.empty())
+	{
+		Init();
+	}
+
+	// Lay the screen space vertices of every occluder out back to back
+	u32 vertexCount = 0;
+	for (auto& occluder : occluders_)
+	{
+		occluder.firstVertex = vertexCount;
+		vertexCount += static_cast<u32>(occluder.positions.size());
+	}
+	screenVertices_.resize(vertexCount);
+
+	const u32 bandCount  = jobs ? jobs->ThreadCount() + 1 : 1u;
+	const u32 bandHeight = (height_ + bandCount - 1) / bandCount;
+	std::vector<u32> rasterizedPerBand(bandCount, 0);
+
+	if (jobs)
+	{
+		jobs->Dispatch(static_cast<u32>(occluders_.size()), 1, [this](u32 i) { TransformOccluder(occluders_[i]); });
+		jobs->Wait();
+
+		// Bands own disjoint rows, so no synchronisation is needed on the depth buffer
+		jobs->Dispatch(bandCount, 1, [&](u32 band)
+		{
+			const u32 yBegin = std::min(band * bandHeight, height_);
+			const u32 yEnd   = std::min(yBegin + bandHeight, height_);
+			RasterizeBand(yBegin, yEnd, rasterizedPerBand[band]);
+		});
+		jobs->Wait();
+	}
+	else
+	{
+		for (const auto& occluder : occluders_)
+		{
+			TransformOccluder(occluder);
+		}
+		RasterizeBand(0, height_, rasterizedPerBand[0]);
+	}
+
+	stats_.rasterizedTriangles = 0;
+	for (u32 count : rasterizedPerBand)
+	{
+		stats_.rasterizedTriangles += count;
+	}
+
+	stats_.rasterizeMs = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - start).
+		count();
+}
+
+void OcclusionCuller::TransformOccluder(const Occluder& occluder)
+{
+	const glm::mat4 mvp = viewProj_ * occluder.world;
+	const f32       halfW = 0.5f * static_cast<f32>(width_);
+	const f32       halfH = 0.5f * static_cast<f32>(height_);
+
+	ScreenVertex* out = screenVertices_.data() + occluder.firstVertex;
+	for (const glm::vec3& p : occluder.positions)
+	{
+		const glm::vec4 clip = mvp * glm::vec4(p, 1.f);
+		if (clip.w < NEAR_W)
+		{
+			*out++ = {0.f, 0.f, 0.f, true};
+			continue;
+		}
+
+		const f32 invW = 1.f / clip.w;
+		*out++ = {
+			(clip.x * invW + 1.f) * halfW,
+			(clip.y * invW + 1.f) * halfH,
+			invW,
+			false
+		};
+	}
+}
+
+void OcclusionCuller::RasterizeBand(u32 yBegin, u32 yEnd, u32& rasterized)
+{
+	if (yBegin >= yEnd)
+	{
+		return;
+	}
+
+	std::fill(depth_.begin() + static_cast<size_t>(yBegin) * width_,
+	          depth_.begin() + static_cast<size_t>(yEnd) * width_, 0.f);
+
+	const f32 bandTop    = static_cast<f32>(yBegin);
+	const f32 bandBottom = static_cast<f32>(yEnd);
+
+	for (const auto& occluder : occluders_)
+	{
+		const ScreenVertex* verts = screenVertices_.data() + occluder.firstVertex;
+		const size_t        vertexCount = occluder.positions.size();
+
+		for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+		{
+			const u32 i0 = occluder.indices[i];
+			const u32 i1 = occluder.indices[i + 1];
+			const u32 i2 = occluder.indices[i + 2];
+			if (i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount)
+			{
+				continue;
+			}
+
+			const ScreenVertex& v0 = verts[i0];
+			const ScreenVertex& v1 = verts[i1];
+			const ScreenVertex& v2 = verts[i2];
+
+			// Skipping near-plane crossers keeps the buffer conservative (occluders may only under-cover)
+			if (v0.clipped || v1.clipped || v2.clipped)
+			{
+				continue;
+			}
+
+			const f32 minY = std::min({v0.y, v1.y, v2.y});
+			const f32 maxY = std::max({v0.y, v1.y, v2.y});
+			if (maxY < bandTop || minY >= bandBottom)
+			{
+				continue;
+			}
+
+			RasterizeTriangle(v0, v1, v2, yBegin, yEnd);
+			rasterized++;
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2,
+                                        u32 yBegin, u32 yEnd)
+{
+	const ScreenVertex* a = &v0;
+	const ScreenVertex* b = &v1;
+	const ScreenVertex* c = &v2;
+
+	// Both windings occlude, flip to a positive area so the edge functions are positive inside
+	f32 area = (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+	if (std::abs(area) < 1e-6f)
+	{
+		return;
+	}
+	if (area < 0.f)
+	{
+		std::swap(b, c);
+		area = -area;
+	}
+
+	const i32 x0 = std::max(0, static_cast<i32>(std::floor(std::min({a->x, b->x, c->x}))));
+	const i32 x1 = std::min(static_cast<i32>(width_) - 1, static_cast<i32>(std::ceil(std::max({a->x, b->x, c->x}))));
+	const i32 y0 = std::max(static_cast<i32>(yBegin), static_cast<i32>(std::floor(std::min({a->y, b->y, c->y}))));
+	const i32 y1 = std::min(static_cast<i32>(yEnd) - 1, static_cast<i32>(std::ceil(std::max({a->y, b->y, c->y}))));
+	if (x0 > x1 || y0 > y1)
+	{
+		return;
+	}
+
+	// E(p) = A * p.x + B * p.y + C for the edges ab, bc and ca
+	const f32 eA[3] = {a->y - b->y, b->y - c->y, c->y - a->y};
+	const f32 eB[3] = {b->x - a->x, c->x - b->x, a->x - c->x};
+	const f32 eC[3] = {
+		-(eA[0] * a->x + eB[0] * a->y),
+		-(eA[1] * b->x + eB[1] * b->y),
+		-(eA[2] * c->x + eB[2] * c->y)
+	};
+
+	// 1/w is affine in screen space: z(p) = (E_bc * a.z + E_ca * b.z + E_ab * c.z) / area
+	const f32 invArea = 1.f / area;
+	const f32 zA = (eA[1] * a->invW + eA[2] * b->invW + eA[0] * c->invW) * invArea;
+	const f32 zB = (eB[1] * a->invW + eB[2] * b->invW + eB[0] * c->invW) * invArea;
+	const f32 zC = (eC[1] * a->invW + eC[2] * b->invW + eC[0] * c->invW) * invArea;
+
+	const u32 xStart = static_cast<u32>(x0) & ~(LANES - 1);
+
+	for (i32 y = y0; y <= y1; y++)
+	{
+		const f32 py  = static_cast<f32>(y) + 0.5f;
+		f32*      row = depth_.data() + static_cast<size_t>(y) * width_;
+
+		const f32 rowE0 = eB[0] * py + eC[0];
+		const f32 rowE1 = eB[1] * py + eC[1];
+		const f32 rowE2 = eB[2] * py + eC[2];
+		const f32 rowZ  = zB * py + zC;
+
+#if defined(OCCLUSION_AVX2)
+		const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		const __m256 zero = _mm256_setzero_ps();
+		for (u32 x = xStart; x <= static_cast<u32>(x1); x += LANES)
+		{
+			const __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<f32>(x)), laneOffsets);
+			const __m256 e0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(eA[0]), px), _mm256_set1_ps(rowE0));
+			const __m256 e1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(eA[1]), px), _mm256_set1_ps(rowE1));
+			const __m256 e2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(eA[2]), px), _mm256_set1_ps(rowE2));
+
+			__m256 inside = _mm256_cmp_ps(e0, zero, _CMP_GE_OQ);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(e1, zero, _CMP_GE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+			if (_mm256_movemask_ps(inside) == 0)
+			{
+				continue;
+			}
+
+			const __m256 z      = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(zA), px), _mm256_set1_ps(rowZ));
+			const __m256 stored = _mm256_loadu_ps(row + x);
+			_mm256_storeu_ps(row + x, _mm256_blendv_ps(stored, _mm256_max_ps(stored, z), inside));
+		}
+#elif defined(OCCLUSION_SSE2)
+		const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		for (u32 x = xStart; x <= static_cast<u32>(x1); x += LANES)
+		{
+			const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<f32>(x)), laneOffsets);
+			const __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(eA[0]), px), _mm_set1_ps(rowE0));
+			const __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(eA[1]), px), _mm_set1_ps(rowE1));
+			const __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(eA[2]), px), _mm_set1_ps(rowE2));
+
+			__m128 inside = _mm_cmpge_ps(e0, zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(e1, zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(inside) == 0)
+			{
+				continue;
+			}
+
+			const __m128 z      = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), _mm_set1_ps(rowZ));
+			const __m128 stored = _mm_loadu_ps(row + x);
+			const __m128 merged = _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(stored, z)), _mm_andnot_ps(inside, stored));
+			_mm_storeu_ps(row + x, merged);
+		}
+#else
+		for (u32 x = xStart; x <= static_cast<u32>(x1); x++)
+		{
+			const f32 px = static_cast<f32>(x) + 0.5f;
+			if (eA[0] * px + rowE0 < 0.f || eA[1] * px + rowE1 < 0.f || eA[2] * px + rowE2 < 0.f)
+			{
+				continue;
+			}
+			row[x] = std::max(row[x], zA * px + rowZ);
+		}
+#endif
+	}
+}
+
+bool OcclusionCuller::IsVisible(const glm::mat4& world, const glm::vec3& origin, const glm::vec3& extents) const
+{
+	if (!enabled || depth_.empty())
+	{
+		return true;
+	}
+
+	stats_.tested++;
+
+	const glm::mat4 mvp = viewProj_ * world;
+
+	f32 minX = std::numeric_limits<f32>::max();
+	f32 minY = std::numeric_limits<f32>::max();
+	f32 maxX = std::numeric_limits<f32>::lowest();
+	f32 maxY = std::numeric_limits<f32>::lowest();
+	f32 nearestInvW = 0.f;
+
+	for (u32 corner = 0; corner < 8; corner++)
+	{
+		const glm::vec3 sign{
+			(corner & 1) ? 1.f : -1.f,
+			(corner & 2) ? 1.f : -1.f,
+			(corner & 4) ? 1.f : -1.f
+		};
+		const glm::vec4 clip = mvp * glm::vec4(origin + extents * sign, 1.f);
+
+		// The box touches the near plane, the projected rect is meaningless
+		if (clip.w < NEAR_W)
+		{
+			return true;
+		}
+
+		const f32 invW = 1.f / clip.w;
+		const f32 sx   = (clip.x * invW + 1.f) * 0.5f * static_cast<f32>(width_);
+		const f32 sy   = (clip.y * invW + 1.f) * 0.5f * static_cast<f32>(height_);
+
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+		nearestInvW = std::max(nearestInvW, invW);
+	}
+
+	if (maxX < 0.f || maxY < 0.f || minX >= static_cast<f32>(width_) || minY >= static_cast<f32>(height_))
+	{
+		stats_.culled++;
+		return false;
+	}
+
+	const i32 x0 = std::max(0, static_cast<i32>(std::floor(minX)));
+	const i32 x1 = std::min(static_cast<i32>(width_) - 1, static_cast<i32>(maxX));
+	const i32 y0 = std::max(0, static_cast<i32>(std::floor(minY)));
+	const i32 y1 = std::min(static_cast<i32>(height_) - 1, static_cast<i32>(maxY));
+
+	// Visible as soon as one covered pixel has no occluder in front of the box's nearest point
+	const f32 testZ  = nearestInvW * (1.f + depthBias);
+	const u32 xStart = static_cast<u32>(x0) & ~(LANES - 1);
+
+	for (i32 y = y0; y <= y1; y++)
+	{
+		const f32* row = depth_.data() + static_cast<size_t>(y) * width_;
+
+#if defined(OCCLUSION_AVX2)
+		const __m256 laneIndex = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+		for (u32 x = xStart; x <= static_cast<u32>(x1); x += LANES)
+		{
+			const __m256 px      = _mm256_add_ps(_mm256_set1_ps(static_cast<f32>(x)), laneIndex);
+			__m256       inRect  = _mm256_cmp_ps(px, _mm256_set1_ps(static_cast<f32>(x0)), _CMP_GE_OQ);
+			inRect               = _mm256_and_ps(inRect, _mm256_cmp_ps(px, _mm256_set1_ps(static_cast<f32>(x1)), _CMP_LE_OQ));
+			const __m256 visible = _mm256_cmp_ps(_mm256_loadu_ps(row + x), _mm256_set1_ps(testZ), _CMP_LE_OQ);
+			if (_mm256_movemask_ps(_mm256_and_ps(inRect, visible)) != 0)
+			{
+				return true;
+			}
+		}
+#elif defined(OCCLUSION_SSE2)
+		const __m128 laneIndex = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+		for (u32 x = xStart; x <= static_cast<u32>(x1); x += LANES)
+		{
+			const __m128 px      = _mm_add_ps(_mm_set1_ps(static_cast<f32>(x)), laneIndex);
+			__m128       inRect  = _mm_cmpge_ps(px, _mm_set1_ps(static_cast<f32>(x0)));
+			inRect               = _mm_and_ps(inRect, _mm_cmple_ps(px, _mm_set1_ps(static_cast<f32>(x1))));
+			const __m128 visible = _mm_cmple_ps(_mm_loadu_ps(row + x), _mm_set1_ps(testZ));
+			if (_mm_movemask_ps(_mm_and_ps(inRect, visible)) != 0)
+			{
+				return true;
+			}
+		}
+#else
+		for (i32 x = x0; x <= x1; x++)
+		{
+			if (row[x] <= testZ)
+			{
+				return true;
+			}
+		}
+#endif
+	}
+
+	stats_.culled++;
+	return false;
+}
+
+OcclusionCullBenchmark GraphicsAPI::BenchmarkOcclusionCulling(u32 occluderCount, u32 occludeeCount, u32 frames,
+                                                              JobSystem* jobs)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	// Every building and prop is a unit cube scaled into place
+	const glm::vec3 cubePositions[8] =
+	{
+		{ -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f },
+		{ -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { -0.5f, 0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }
+	};
+	const u32 cubeIndices[36] =
+	{
+		0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 2, 6, 0, 6, 4,
+		1, 5, 7, 1, 7, 3, 0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6
+	};
+
+	// Blocks of buildings on a grid with streets between them, props scattered over the whole area. Deterministic
+	// between runs.
+	u32 seed = 0x9E3779B9u;
+	auto random = [&]
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<f32>(seed >> 8) / static_cast<f32>(1u << 24);
+	};
+	const u32 side = std::max(static_cast<u32>(std::sqrt(static_cast<f64>(occluderCount))), 1u);
+	constexpr f32 spacing = 20.f;
+	const f32 half = static_cast<f32>(side) * spacing * 0.5f;
+
+	std::vector<glm::mat4> buildings(occluderCount);
+	for (u32 i = 0; i < occluderCount; i++)
+	{
+		const f32 x = (static_cast<f32>(i % side) + 0.5f) * spacing - half;
+		const f32 z = (static_cast<f32>(i / side % side) + 0.5f) * spacing - half;
+		const glm::vec3 size(8.f + random() * 6.f, 10.f + random() * 30.f, 8.f + random() * 6.f);
+		buildings[i] = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(x, size.y * 0.5f, z)), size);
+	}
+	std::vector<glm::mat4> props(occludeeCount);
+	for (u32 i = 0; i < occludeeCount; i++)
+	{
+		const glm::vec3 size(0.5f + random() * 3.f, 0.5f + random() * 3.f, 0.5f + random() * 3.f);
+		const glm::vec3 position((random() * 2.f - 1.f) * half, size.y * 0.5f, (random() * 2.f - 1.f) * half);
+		props[i] = glm::scale(glm::translate(glm::mat4(1.f), position), size);
+	}
+
+	OcclusionCuller culler;
+	culler.Init();
+	OcclusionCullBenchmark result{ .occluders = occluderCount, .occludees = occludeeCount, .frames = frames };
+
+	// Known answers first: a wall straight ahead, a box hidden right behind it, one beside its shadow and one in
+	// front of it
+	{
+		const glm::mat4 viewProj = glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.1f, 1000.f) *
+		                           glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 1.f, 0.f));
+		const glm::mat4 wall = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, 10.f)), glm::vec3(10.f, 10.f, 1.f));
+		culler.BeginFrame(viewProj);
+		culler.AddOccluder(cubePositions, cubeIndices, wall);
+		culler.Rasterize(jobs);
+		const struct { glm::vec3 position; bool visible; } cases[] =
+		{
+			{ { 0.f, 0.f, 15.f }, false },
+			{ { 10.f, 0.f, 15.f }, true },
+			{ { 0.f, 0.f, 5.f }, true }
+		};
+		for (const auto& c : cases)
+		{
+			const glm::mat4 box = glm::translate(glm::mat4(1.f), c.position);
+			result.knownCaseFailures += culler.IsVisible(box, glm::vec3(0.f), glm::vec3(0.5f)) != c.visible ? 1 : 0;
+		}
+	}
+
+	// Ground truth by ray casting: every pixel center of the culler's buffer shoots a ray from the near to the far
+	// plane against the boxes themselves, no rasterization involved. Buildings and props are axis aligned, so a slab
+	// test is exact.
+	struct Box
+	{
+		glm::vec3 min, max;
+	};
+	auto toBox = [](const glm::mat4& world)
+	{
+		const glm::vec3 center(world[3]);
+		const glm::vec3 halfSize(0.5f * world[0][0], 0.5f * world[1][1], 0.5f * world[2][2]);
+		return Box{ center - halfSize, center + halfSize };
+	};
+	// Entry parameter of the segment origin + t * direction, t in [0, 1], or 2 when it misses
+	auto hit = [](const Box& box, const glm::vec3& origin, const glm::vec3& direction)
+	{
+		f32 tNear = 0.f;
+		f32 tFar = 1.f;
+		for (u32 axis = 0; axis < 3; axis++)
+		{
+			const f32 inv = 1.f / direction[axis];
+			f32 t0 = (box.min[axis] - origin[axis]) * inv;
+			f32 t1 = (box.max[axis] - origin[axis]) * inv;
+			if (t0 > t1)
+			{
+				std::swap(t0, t1);
+			}
+			tNear = std::max(tNear, t0);
+			tFar = std::min(tFar, t1);
+			if (tNear > tFar)
+			{
+				return 2.f;
+			}
+		}
+		return tNear;
+	};
+
+	std::vector<Box> buildingBoxes(occluderCount);
+	std::ranges::transform(buildings, buildingBoxes.begin(), toBox);
+	std::vector<Box> propBoxes(occludeeCount);
+	std::ranges::transform(props, propBoxes.begin(), toBox);
+
+	const u32 width = culler.Width();
+	const u32 height = culler.Height();
+	std::vector<glm::vec3> rayOrigins(static_cast<size_t>(width) * height);
+	std::vector<glm::vec3> rayDirections(rayOrigins.size());
+	std::vector<f32> occluderHits(rayOrigins.size());
+
+	auto castRays = [&](const glm::mat4& viewProj)
+	{
+		const glm::mat4 inverse = glm::inverse(viewProj);
+		auto unproject = [&](f32 x, f32 y, f32 z)
+		{
+			const glm::vec4 p = inverse * glm::vec4(x, y, z, 1.f);
+			return glm::vec3(p) / p.w;
+		};
+		for (u32 y = 0; y < height; y++)
+		{
+			for (u32 x = 0; x < width; x++)
+			{
+				// Same pixel mapping as the culler, depth 0 and 1 are the near and far plane
+				const f32 ndcX = (static_cast<f32>(x) + 0.5f) / static_cast<f32>(width) * 2.f - 1.f;
+				const f32 ndcY = (static_cast<f32>(y) + 0.5f) / static_cast<f32>(height) * 2.f - 1.f;
+				const size_t i = static_cast<size_t>(y) * width + x;
+				rayOrigins[i] = unproject(ndcX, ndcY, 0.f);
+				rayDirections[i] = unproject(ndcX, ndcY, 1.f) - rayOrigins[i];
+				f32 nearest = 2.f;
+				for (const Box& building : buildingBoxes)
+				{
+					nearest = std::min(nearest, hit(building, rayOrigins[i], rayDirections[i]));
+				}
+				occluderHits[i] = nearest;
+			}
+		}
+	};
+
+	// Visible when a pixel's ray reaches the prop before any building, the margin keeps float noise on shared depths
+	// out of it
+	auto isVisibleTruth = [&](const glm::mat4& viewProj, u32 prop)
+	{
+		const glm::mat4 mvp = viewProj * props[prop];
+		f32 minX = std::numeric_limits<f32>::max();
+		f32 minY = std::numeric_limits<f32>::max();
+		f32 maxX = std::numeric_limits<f32>::lowest();
+		f32 maxY = std::numeric_limits<f32>::lowest();
+		for (const glm::vec3& corner : cubePositions)
+		{
+			const glm::vec4 clip = mvp * glm::vec4(corner, 1.f);
+			if (clip.w < NEAR_W)
+			{
+				return true; // reaches behind the camera, the culler keeps these without testing
+			}
+			minX = std::min(minX, (clip.x / clip.w + 1.f) * 0.5f * static_cast<f32>(width));
+			maxX = std::max(maxX, (clip.x / clip.w + 1.f) * 0.5f * static_cast<f32>(width));
+			minY = std::min(minY, (clip.y / clip.w + 1.f) * 0.5f * static_cast<f32>(height));
+			maxY = std::max(maxY, (clip.y / clip.w + 1.f) * 0.5f * static_cast<f32>(height));
+		}
+
+		const i32 x0 = std::max(0, static_cast<i32>(std::floor(minX)) - 1);
+		const i32 x1 = std::min(static_cast<i32>(width) - 1, static_cast<i32>(maxX) + 1);
+		const i32 y0 = std::max(0, static_cast<i32>(std::floor(minY)) - 1);
+		const i32 y1 = std::min(static_cast<i32>(height) - 1, static_cast<i32>(maxY) + 1);
+		for (i32 y = y0; y <= y1; y++)
+		{
+			for (i32 x = x0; x <= x1; x++)
+			{
+				const size_t i = static_cast<size_t>(y) * width + x;
+				const f32 t = hit(propBoxes[prop], rayOrigins[i], rayDirections[i]);
+				if (t <= 1.f && t * 1.001f < occluderHits[i])
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	};
+
+	const glm::mat4 proj = glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.1f, 1000.f);
+	Clock::duration rasterizeTime{}, testTime{};
+	u64 visible = 0, culled = 0, truthCulled = 0;
+	std::vector<u8> results(occludeeCount);
+
+	// 60 Hz walk down the street between the two middle rows of blocks, looking around a little
+	for (u32 frame = 0; frame < frames; frame++)
+	{
+		const f32 t = static_cast<f32>(frame) / 60.f;
+		const glm::vec3 eye(0.f, 2.f, -half + t * 10.f);
+		const f32 yaw = std::sin(t * 0.4f) * 0.6f;
+		const glm::mat4 viewProj = proj * glm::lookAt(eye, eye + glm::vec3(std::sin(yaw), 0.f, std::cos(yaw)),
+		                                              glm::vec3(0.f, 1.f, 0.f));
+
+		Clock::time_point start = Clock::now();
+		culler.BeginFrame(viewProj);
+		for (const glm::mat4& world : buildings)
+		{
+			culler.AddOccluder(cubePositions, cubeIndices, world);
+		}
+		culler.Rasterize(jobs);
+		rasterizeTime += Clock::now() - start;
+
+		start = Clock::now();
+		for (u32 i = 0; i < occludeeCount; i++)
+		{
+			results[i] = culler.IsVisible(props[i], glm::vec3(0.f), glm::vec3(0.5f)) ? 1 : 0;
+		}
+		testTime += Clock::now() - start;
+
+		castRays(viewProj);
+		for (u32 i = 0; i < occludeeCount; i++)
+		{
+			const bool truthVisible = isVisibleTruth(viewProj, i);
+			visible += results[i];
+			culled += results[i] ? 0 : 1;
+			truthCulled += truthVisible ? 0 : 1;
+			result.falseCulls += truthVisible && !results[i] ? 1 : 0;
+		}
+	}
+
+	if (frames > 0)
+	{
+		const f64 perFrame = 1.0 / static_cast<f64>(frames);
+		result.rasterizeMs = std::chrono::duration<f64, std::milli>(rasterizeTime).count() * perFrame;
+		result.testMs = std::chrono::duration<f64, std::milli>(testTime).count() * perFrame;
+		result.visiblePerFrame = static_cast<f64>(visible) * perFrame;
+		result.culledPerFrame = static_cast<f64>(culled) * perFrame;
+		result.truthCulledPerFrame = static_cast<f64>(truthCulled) * perFrame;
+	}
+	return result;
+}
@@ -0,0 +1,114 @@
+//
+// Created by Orgest on 10/18/2024.
+//
+
+#pragma once
+
+#include <span>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "../Core/JobSystem.h"
+#include "../Core/PrimTypes.h"
+
+namespace GraphicsAPI
+{
+	// CPU occlusion culler in the spirit of masked software occlusion culling. Designated occluder meshes are
+	// rasterized into a small depth buffer (SSE/AVX2, split into horizontal bands across the job system), then
+	// object bounds are tested against it before they ever reach the draw lists.
+	//
+	// Depth is stored as 1/w (view distance reciprocal), so it works regardless of the projection's depth range
+	// convention and 0 means "nothing here". Has no dependency on the graphics API or the window, so it can run
+	// headless.
+	class OcclusionCuller
+	{
+	public:
+		static constexpr u32 DEFAULT_WIDTH  = 320;
+		static constexpr u32 DEFAULT_HEIGHT = 192;
+
+		struct Stats
+		{
+			u32 occluders{};
+			u32 occluderTriangles{};
+			u32 rasterizedTriangles{}; // counted once per band the triangle overlaps
+			u32 tested{};
+			u32 culled{};
+			f32 rasterizeMs{};
+		};
+
+		// width is rounded up to a multiple of 8 so rows can always be processed 8 lanes at a time
+		void Init(u32 width = DEFAULT_WIDTH, u32 height = DEFAULT_HEIGHT);
+
+		void BeginFrame(const glm::mat4& viewProj);
+		void AddOccluder(std::span<const glm::vec3> positions, std::span<const u32> indices, const glm::mat4& world);
+
+		// Clears and fills the depth buffer from every occluder added this frame
+		void Rasterize(JobSystem* jobs = nullptr);
+
+		// Local space AABB (center + half extents) transformed by world. Conservative: returns true unless the
+		// box is fully behind the occluders or fully off-screen.
+		[[nodiscard]] bool IsVisible(const glm::mat4& world, const glm::vec3& origin, const glm::vec3& extents) const;
+
+		[[nodiscard]] u32                 Width() const { return width_; }
+		[[nodiscard]] u32                 Height() const { return height_; }
+		[[nodiscard]] std::span<const f32> Depth() const { return depth_; }
+		[[nodiscard]] const Stats&        GetStats() const { return stats_; }
+
+		bool enabled = true;
+		// bias applied to the occludee's nearest depth before the compare, avoids self-occlusion flicker
+		f32 depthBias = 1e-4f;
+
+	private:
+		struct ScreenVertex
+		{
+			f32 x, y, invW;
+			bool clipped; // behind the near plane
+		};
+
+		struct Occluder
+		{
+			std::span<const glm::vec3> positions;
+			std::span<const u32>       indices;
+			glm::mat4                  world;
+			u32                        firstVertex; // into screenVertices_
+		};
+
+		void TransformOccluder(const Occluder& occluder);
+		void RasterizeBand(u32 yBegin, u32 yEnd, u32& rasterized);
+		void RasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, u32 yBegin,
+		                       u32 yEnd);
+
+		u32 width_  = 0;
+		u32 height_ = 0;
+
+		glm::mat4                 viewProj_{1.f};
+		std::vector<f32>          depth_;
+		std::vector<Occluder>     occluders_;
+		std::vector<ScreenVertex> screenVertices_;
+
+		mutable Stats stats_{};
+	};
+
+	struct OcclusionCullBenchmark
+	{
+		u32 occluders{};
+		u32 occludees{};
+		u32 frames{};
+		f64 rasterizeMs{};     // per frame
+		f64 testMs{};          // per frame, every occludee against the depth buffer
+		f64 visiblePerFrame{};
+		f64 culledPerFrame{};
+		f64 truthCulledPerFrame{}; // hidden at every pixel by the ray cast, what a perfect culler would remove
+		u32 falseCulls{};          // culled although a ray reaches them, anything but 0 is a bug
+		u32 knownCaseFailures{};   // wrong answers on the fixed wall scene, anything but 0 is a bug
+	};
+
+	// Checks a wall scene with known visibility, then walks a camera down a street of a synthetic city, rasterizes
+	// occluderCount buildings every frame and tests occludeeCount props against them. Every result is checked
+	// against rays cast through each pixel center against the boxes themselves. Needs no graphics API, see the
+	// CullBenchmark target.
+	OcclusionCullBenchmark BenchmarkOcclusionCulling(u32 occluderCount, u32 occludeeCount, u32 frames,
+	                                                 JobSystem* jobs = nullptr);
+}
@@ -0,0 +1,219 @@
+//
+// Created by Orgest on 10/21/2024.
+//
+
+#include "VulkanBindless.h"
+
+#include "VulkanDescriptor.h"
+#include "VulkanMain.h"
+
+using namespace GraphicsAPI::Vulkan;
+
+void BindlessRegistry::Init(VkEngine* engine, VkDevice device)
+{
+	engine_ = engine;
+
+	// Textures are registered while earlier frames may still be in flight, hence update after bind
+	VkDescriptorBindingFlags bindingFlags[] = {
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+		0
+	};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.bindingCount = 2,
+		.pBindingFlags = bindingFlags
+	};
+
+	DescriptorLayoutBuilder builder;
+	builder.AddBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_TEXTURES);
+	builder.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	layout_ = builder.Build(device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, &flagsInfo,
+	                        VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+	VkDescriptorPoolSize poolSizes[] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_TEXTURES },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+		.maxSets = 1,
+		.poolSizeCount = 2,
+		.pPoolSizes = poolSizes
+	};
+	VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool_));
+
+	VkDescriptorSetAllocateInfo allocInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = pool_,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &layout_
+	};
+	VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &set_));
+
+	materialBuffer_ = engine_->CreateBuffer(MAX_MATERIALS * sizeof(GPUBindlessMaterial),
+	                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	materials_ = static_cast<GPUBindlessMaterial*>(materialBuffer_.info.pMappedData);
+
+	VkDescriptorWriter writer;
+	writer.WriteBuffer(1, materialBuffer_.buffer, MAX_MATERIALS * sizeof(GPUBindlessMaterial), 0,
+	                   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	writer.UpdateSet(device, set_);
+}
+
+void BindlessRegistry::Cleanup(VkDevice device)
+{
+	if (!IsValid())
+	{
+		return;
+	}
+
+	engine_->DestroyBuffer(materialBuffer_);
+	vkDestroyDescriptorPool(device, pool_, nullptr);
+	vkDestroyDescriptorSetLayout(device, layout_, nullptr);
+
+	set_ = VK_NULL_HANDLE;
+	materials_ = nullptr;
+	textureSlots_.clear();
+	textureKeys_.clear();
+	textureRefs_.clear();
+	freeTextures_.clear();
+	freeMaterials_.clear();
+	pendingTextures_.clear();
+	pendingMaterials_.clear();
+	materialCount_ = 0;
+}
+
+void BindlessRegistry::BeginFrame(u64 frame, u32 framesInFlight)
+{
+	frame_ = frame;
+
+	// Frames up to frame - framesInFlight have finished by the time the slot for frame is reused
+	auto recycle = [&](std::deque<PendingSlot>& pending, std::vector<u32>& free)
+	{
+		while (!pending.empty() && pending.front().frame + framesInFlight <= frame)
+		{
+			free.push_back(pending.front().index);
+			pending.pop_front();
+		}
+	};
+	recycle(pendingTextures_, freeTextures_);
+	recycle(pendingMaterials_, freeMaterials_);
+}
+
+u32 BindlessRegistry::RegisterTexture(VkDevice device, VkImageView view, VkSampler sampler)
+{
+	const TextureKey key{ view, sampler };
+	if (auto it = textureSlots_.find(key); it != textureSlots_.end())
+	{
+		textureRefs_[it->second]++;
+		return it->second;
+	}
+
+	u32 index;
+	if (!freeTextures_.empty())
+	{
+		index = freeTextures_.back();
+		freeTextures_.pop_back();
+	}
+	else if (textureKeys_.size() < MAX_TEXTURES)
+	{
+		index = static_cast<u32>(textureKeys_.size());
+		textureKeys_.emplace_back();
+		textureRefs_.emplace_back();
+	}
+	else
+	{
+		LOG(WARN, "Bindless texture array is full, falling back to slot 0");
+		textureRefs_[0]++;
+		return 0;
+	}
+
+	textureSlots_[key]  = index;
+	textureKeys_[index] = key;
+	textureRefs_[index] = 1;
+
+	VkDescriptorImageInfo imageInfo
+	{
+		.sampler = sampler,
+		.imageView = view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	};
+
+	VkWriteDescriptorSet write
+	{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = set_,
+		.dstBinding = 0,
+		.dstArrayElement = index,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &imageInfo
+	};
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+	return index;
+}
+
+void BindlessRegistry::ReleaseTexture(u32 index)
+{
+	if (index >= textureRefs_.size() || textureRefs_[index] == 0)
+	{
+		return;
+	}
+
+	if (--textureRefs_[index] == 0)
+	{
+		// The stale descriptor stays in place, partially bound slots are fine as long as nothing samples them.
+		// Frames in flight may still do, so the slot isn't rewritten until they finish.
+		textureSlots_.erase(textureKeys_[index]);
+		pendingTextures_.push_back({ frame_, index });
+	}
+}
+
+u32 BindlessRegistry::AddMaterial(const GPUBindlessMaterial& material)
+{
+	u32 index;
+	if (!freeMaterials_.empty())
+	{
+		index = freeMaterials_.back();
+		freeMaterials_.pop_back();
+	}
+	else if (materialCount_ < MAX_MATERIALS)
+	{
+		index = materialCount_++;
+	}
+	else
+	{
+		LOG(WARN, "Bindless material buffer is full");
+		return INVALID_INDEX;
+	}
+
+	materials_[index] = material;
+	return index;
+}
+
+void BindlessRegistry::ReleaseMaterial(u32 index)
+{
+	if (index >= materialCount_)
+	{
+		return;
+	}
+
+	ReleaseTexture(materials_[index].colorTexture);
+	ReleaseTexture(materials_[index].metalRoughTexture);
+	pendingMaterials_.push_back({ frame_, index });
+}
+
+void BindlessRegistry::SetMaterialFeatures(u32 index, u32 features)
+{
+	if (index < materialCount_)
+	{
+		materials_[index].features = features;
+	}
+}
@@ -0,0 +1,117 @@
+//
+// Created by Orgest on 10/21/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanHeader.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	class VkEngine;
+
+	// Material parameters as read by mesh_bindless.vert/.frag, indexed by the per draw material ID
+	struct GPUBindlessMaterial
+	{
+		glm::vec4 colorFactors;
+		glm::vec4 metalRoughFactors; // z is the alpha cutoff
+		u32       colorTexture;
+		u32       metalRoughTexture;
+		u32       features; // MaterialFeatures::Index() bits, the shaders branch on them instead of specializing
+		u32       pad0;
+	};
+
+	// push constants for bindless mesh draws
+	struct GPUBindlessDrawPushConstants
+	{
+		glm::mat4       worldMatrix;
+		VkDeviceAddress vertexBuffer;
+		u32             materialIndex;
+	};
+
+	// One global descriptor set holding a partially bound array of every material texture (binding 0) and a
+	// storage buffer with every material's parameters (binding 1). Draws pick their material with a push constant,
+	// so switching materials costs no descriptor set binds.
+	class BindlessRegistry
+	{
+	public:
+		static constexpr u32 MAX_TEXTURES  = 4096;
+		static constexpr u32 MAX_MATERIALS = 4096;
+		static constexpr u32 INVALID_INDEX = ~0u;
+
+		void Init(VkEngine* engine, VkDevice device);
+		void Cleanup(VkDevice device);
+
+		// Call once the frame slot's previous frame has finished. Released slots are handed out again once every
+		// frame that could still index them has finished too.
+		void BeginFrame(u64 frame, u32 framesInFlight);
+
+		// The same view + sampler pair always maps to the same slot, slots are reference counted
+		u32  RegisterTexture(VkDevice device, VkImageView view, VkSampler sampler);
+		void ReleaseTexture(u32 index);
+
+		// Returns INVALID_INDEX when the materials buffer is full
+		u32  AddMaterial(const GPUBindlessMaterial& material);
+		// Also releases the material's textures
+		void ReleaseMaterial(u32 index);
+		// For features only known after AddMaterial, call before the material is first drawn
+		void SetMaterialFeatures(u32 index, u32 features);
+
+		[[nodiscard]] bool                  IsValid() const { return set_ != VK_NULL_HANDLE; }
+		[[nodiscard]] VkDescriptorSetLayout Layout() const { return layout_; }
+		[[nodiscard]] VkDescriptorSet       Set() const { return set_; }
+		[[nodiscard]] u32                   TextureCount() const { return static_cast<u32>(textureSlots_.size()); }
+		[[nodiscard]] u32                   MaterialCount() const
+		{
+			return materialCount_ - static_cast<u32>(freeMaterials_.size() + pendingMaterials_.size());
+		}
+
+	private:
+		struct TextureKey
+		{
+			VkImageView view;
+			VkSampler   sampler;
+
+			bool operator==(const TextureKey&) const = default;
+		};
+
+		struct PendingSlot
+		{
+			u64 frame; // last frame that may have used the slot
+			u32 index;
+		};
+
+		struct TextureKeyHash
+		{
+			size_t operator()(const TextureKey& key) const
+			{
+				return std::hash<VkImageView>{}(key.view) ^ (std::hash<VkSampler>{}(key.sampler) << 1);
+			}
+		};
+
+		VkEngine*             engine_{ nullptr };
+		VkDescriptorSetLayout layout_{ VK_NULL_HANDLE };
+		VkDescriptorPool      pool_{ VK_NULL_HANDLE };
+		VkDescriptorSet       set_{ VK_NULL_HANDLE };
+
+		AllocatedBuffer      materialBuffer_{};
+		GPUBindlessMaterial* materials_{ nullptr }; // persistently mapped
+		u32                  materialCount_{ 0 };   // high water mark
+		std::vector<u32>     freeMaterials_;
+		std::deque<PendingSlot> pendingMaterials_;
+		u64                  frame_{ 0 };
+
+		std::unordered_map<TextureKey, u32, TextureKeyHash> textureSlots_;
+		std::vector<TextureKey> textureKeys_;       // per slot, for releasing
+		std::vector<u32>        textureRefs_;
+		std::vector<u32>        freeTextures_;
+		std::deque<PendingSlot> pendingTextures_;
+	};
+}
+
+#endif
@@ -5,15 +5,17 @@
 #include "VulkanDescriptor.h"
 #include "VulkanHeader.h"
 
+#include <algorithm>
+
 using namespace GraphicsAPI::Vulkan;
 
-void DescriptorLayoutBuilder::AddBinding(u32 binding, VkDescriptorType type)
+void DescriptorLayoutBuilder::AddBinding(u32 binding, VkDescriptorType type, u32 count)
 {
 	VkDescriptorSetLayoutBinding newbind
 	{
 		.binding = binding,
 		.descriptorType = type,
-		.descriptorCount = 1
+		.descriptorCount = count
 	};
 
 	bindings.push_back(newbind);
@@ -47,9 +49,11 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::Build(VkDevice device, VkShaderSt
 	return set;
 }
 
-void DescriptorAllocatorGrowable::Init(VkDevice device, u32 maxSets, std::span<PoolSizeRatio> poolRatios)
+void DescriptorAllocatorGrowable::Init(VkDevice device, u32 maxSets, std::span<PoolSizeRatio> poolRatios,
+                                       VkDescriptorPoolCreateFlags flags)
 {
 	ratios.clear();
+	poolFlags = flags;
 
 	for (auto r : poolRatios) {
 		ratios.push_back(r);
@@ -132,6 +136,7 @@ VkDescriptorPool DescriptorAllocatorGrowable::CreatePool(VkDevice device, u32 se
 
     VkDescriptorPoolCreateInfo poolInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = poolFlags,
         .maxSets = setCount,
         .poolSizeCount = static_cast<u32>(poolSizes.size()),
         .pPoolSizes = poolSizes.data()
@@ -142,7 +147,8 @@ VkDescriptorPool DescriptorAllocatorGrowable::CreatePool(VkDevice device, u32 se
     return newPool;
 }
 
-VkDescriptorSet DescriptorAllocatorGrowable::Allocate(VkDevice device, VkDescriptorSetLayout layout, void* pNext)
+VkDescriptorSet DescriptorAllocatorGrowable::Allocate(VkDevice device, VkDescriptorSetLayout layout, void* pNext,
+                                                      VkDescriptorPool* outPool)
 {
     // Get or create a pool for allocation
     VkDescriptorPool pool = GetPool(device);
@@ -169,12 +175,29 @@ VkDescriptorSet DescriptorAllocatorGrowable::Allocate(VkDevice device, VkDescrip
 
     // Pool remains ready unless explicitly marked full
     readyPools.push_back(pool);
+    if (outPool)
+    {
+        *outPool = pool;
+    }
     return ds;
 }
 
+void DescriptorAllocatorGrowable::Free(VkDevice device, VkDescriptorPool pool, VkDescriptorSet set)
+{
+    VK_CHECK(vkFreeDescriptorSets(device, pool, 1, &set));
+
+    // The pool has room again
+    if (auto it = std::ranges::find(fullPools, pool); it != fullPools.end())
+    {
+        fullPools.erase(it);
+        readyPools.push_back(pool);
+    }
+}
+
 // VkDescriptorWriter: Handles descriptor set writes
 VkDescriptorWriter& VkDescriptorWriter::WriteBuffer(u32 binding, VkBuffer buffer, size_t size, size_t offset,
                                                     VkDescriptorType type) {
+	infoRefs.push_back({ .index = static_cast<u32>(bufferInfos.size()), .image = false });
 	bufferInfos.push_back({
 		.buffer = buffer,
 		.offset = offset,
@@ -185,8 +208,7 @@ VkDescriptorWriter& VkDescriptorWriter::WriteBuffer(u32 binding, VkBuffer buffer
 		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 		.dstBinding = binding,
 		.descriptorCount = 1,
-		.descriptorType = type,
-		.pBufferInfo = &bufferInfos.back()
+		.descriptorType = type
 	});
 
 	return *this;
@@ -195,23 +217,49 @@ VkDescriptorWriter& VkDescriptorWriter::WriteBuffer(u32 binding, VkBuffer buffer
 VkDescriptorWriter& VkDescriptorWriter::WriteImage(u32 binding, VkImageView image, VkSampler sampler, VkImageLayout layout,
 	VkDescriptorType type)
 {
+	infoRefs.push_back({ .index = static_cast<u32>(imageInfos.size()), .image = true });
 	imageInfos.push_back({ .sampler = sampler, .imageView = image, .imageLayout = layout });
 	writes.push_back({
 		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 		.dstBinding = binding,
 		.descriptorCount = 1,
-		.descriptorType = type,
-		.pImageInfo = &imageInfos.back()
+		.descriptorType = type
 	});
 
 	return *this;
 }
 
+void VkDescriptorWriter::Reserve(u32 writeCount, u32 imageCount, u32 bufferCount)
+{
+    writes.reserve(writeCount);
+    infoRefs.reserve(writeCount);
+    imageInfos.reserve(imageCount);
+    bufferInfos.reserve(bufferCount);
+}
+
 void VkDescriptorWriter::Clear()
 {
     imageInfos.clear();
     bufferInfos.clear();
     writes.clear();
+    infoRefs.clear();
+    queuedWrites = 0;
+    queuedSets = 0;
+}
+
+void VkDescriptorWriter::ResolveInfos()
+{
+    for (size_t i = 0; i < writes.size(); i++)
+    {
+        if (infoRefs[i].image)
+        {
+            writes[i].pImageInfo = &imageInfos[infoRefs[i].index];
+        }
+        else
+        {
+            writes[i].pBufferInfo = &bufferInfos[infoRefs[i].index];
+        }
+    }
 }
 
 void VkDescriptorWriter::UpdateSet(VkDevice device, VkDescriptorSet set)
@@ -221,5 +269,166 @@ void VkDescriptorWriter::UpdateSet(VkDevice device, VkDescriptorSet set)
         write.dstSet = set;
     }
 
+    ResolveInfos();
     vkUpdateDescriptorSets(device, static_cast<u32>(writes.size()), writes.data(), 0, nullptr);
-}
\ No newline at end of file
+}
+
+void VkDescriptorWriter::QueueSet(VkDescriptorSet set)
+{
+    for (size_t i = queuedWrites; i < writes.size(); i++)
+    {
+        writes[i].dstSet = set;
+    }
+    queuedWrites = writes.size();
+    queuedSets++;
+}
+
+u32 VkDescriptorWriter::Flush(VkDevice device)
+{
+    // Writes recorded after the last QueueSet have no destination, leave them out
+    const u32 setCount = queuedSets;
+    if (queuedWrites > 0)
+    {
+        ResolveInfos();
+        vkUpdateDescriptorSets(device, static_cast<u32>(queuedWrites), writes.data(), 0, nullptr);
+    }
+
+    Clear();
+    return setCount;
+}
+
+// DescriptorSetCache: reuses descriptor sets across frames
+void DescriptorSetCache::Init(VkDevice device, u32 maxSets, u32 frames,
+                              std::span<DescriptorAllocatorGrowable::PoolSizeRatio> poolRatios)
+{
+	capacity = maxSets;
+	framesInFlight = frames;
+	allocator.Init(device, maxSets, poolRatios, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+}
+
+void DescriptorSetCache::Destroy(VkDevice device)
+{
+	// Sets go away with their pools
+	entries.clear();
+	lookup.clear();
+	retired.clear();
+	allocator.DestroyPools(device);
+}
+
+void DescriptorSetCache::BeginFrame(VkDevice device, u64 frame)
+{
+	frameNumber = frame;
+	hits = 0;
+	misses = 0;
+
+	std::erase_if(retired, [&](const RetiredSet& r)
+	{
+		if (r.frame + framesInFlight > frameNumber)
+		{
+			return false;
+		}
+		allocator.Free(device, r.pool, r.set);
+		return true;
+	});
+}
+
+DescriptorSetCache::Key DescriptorSetCache::MakeKey(VkDescriptorSetLayout layout, const VkDescriptorWriter& writer)
+{
+	Key key;
+	key.words.reserve(1 + writer.writes.size() * 4);
+	key.words.push_back(reinterpret_cast<u64>(layout));
+
+	for (size_t i = 0; i < writer.writes.size(); i++)
+	{
+		const auto& write = writer.writes[i];
+		const auto& ref = writer.infoRefs[i];
+		key.words.push_back(static_cast<u64>(write.dstBinding) << 32 | static_cast<u64>(write.descriptorType));
+		if (ref.image)
+		{
+			const auto& info = writer.imageInfos[ref.index];
+			key.words.push_back(reinterpret_cast<u64>(info.imageView));
+			key.words.push_back(reinterpret_cast<u64>(info.sampler));
+			key.words.push_back(info.imageLayout);
+		}
+		else
+		{
+			const auto& info = writer.bufferInfos[ref.index];
+			key.words.push_back(reinterpret_cast<u64>(info.buffer));
+			key.words.push_back(info.offset);
+			key.words.push_back(info.range);
+		}
+	}
+
+	for (const u64 word : key.words)
+	{
+		key.hash ^= word + 0x9e3779b97f4a7c15ull + (key.hash << 6) + (key.hash >> 2);
+	}
+	return key;
+}
+
+VkDescriptorSet DescriptorSetCache::Get(VkDevice device, VkDescriptorSetLayout layout, VkDescriptorWriter& writer)
+{
+	Key key = MakeKey(layout, writer);
+	if (auto it = lookup.find(key); it != lookup.end())
+	{
+		entries.splice(entries.begin(), entries, it->second);
+		hits++;
+		return it->second->set;
+	}
+
+	misses++;
+	while (!entries.empty() && entries.size() >= capacity)
+	{
+		Retire(std::prev(entries.end()));
+	}
+
+	Entry entry{ .key = std::move(key) };
+	entry.set = allocator.Allocate(device, layout, nullptr, &entry.pool);
+	writer.UpdateSet(device, entry.set);
+
+	entries.push_front(std::move(entry));
+	lookup.emplace(entries.front().key, entries.begin());
+	return entries.front().set;
+}
+
+void DescriptorSetCache::Invalidate(VkBuffer buffer)
+{
+	InvalidateHandle(reinterpret_cast<u64>(buffer));
+}
+
+void DescriptorSetCache::Invalidate(VkImageView imageView)
+{
+	InvalidateHandle(reinterpret_cast<u64>(imageView));
+}
+
+void DescriptorSetCache::Invalidate(VkSampler sampler)
+{
+	InvalidateHandle(reinterpret_cast<u64>(sampler));
+}
+
+void DescriptorSetCache::InvalidateHandle(u64 handle)
+{
+	if (handle == 0)
+	{
+		return;
+	}
+
+	// Resources are destroyed rarely, a scan beats keeping a reverse index up to date.
+	// Only handle words are compared so an offset or range that happens to match costs a spurious rebuild at worst.
+	for (auto it = entries.begin(); it != entries.end();)
+	{
+		auto next = std::next(it);
+		if (std::ranges::find(it->key.words.begin() + 1, it->key.words.end(), handle) != it->key.words.end())
+		{
+			Retire(it);
+		}
+		it = next;
+	}
+}
+
+void DescriptorSetCache::Retire(std::list<Entry>::iterator it)
+{
+	retired.push_back({ .set = it->set, .pool = it->pool, .frame = frameNumber });
+	lookup.erase(it->key);
+	entries.erase(it);
+}
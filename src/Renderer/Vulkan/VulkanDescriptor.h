@@ -4,8 +4,9 @@
 #pragma once
 #ifdef VULKAN_BUILD
 
-#include <deque>
+#include <list>
 #include <span>
+#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.h>
 
@@ -18,24 +19,48 @@ namespace GraphicsAPI::Vulkan
     {
         std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-        void AddBinding(u32 binding, VkDescriptorType type);
+        void AddBinding(u32 binding, VkDescriptorType type, u32 count = 1);
         void Clear();
         VkDescriptorSetLayout Build(VkDevice device, VkShaderStageFlags shaderStages, void *pNext = nullptr, VkDescriptorSetLayoutCreateFlags flags = 0);
     };
 
     // Descriptor Writer: Handles writing descriptor sets.
+    // Writes for many sets can be batched: record a set's writes, QueueSet it, repeat, then Flush once.
     struct VkDescriptorWriter
     {
-        std::deque<VkDescriptorImageInfo> imageInfos;
-        std::deque<VkDescriptorBufferInfo> bufferInfos;
+        // Where a write's image or buffer info lives, the pointers are only patched in right before the update
+        // so the info arrays can stay contiguous and grow freely while recording.
+        struct InfoRef
+        {
+            u32 index;
+            bool image;
+        };
+
+        std::vector<VkDescriptorImageInfo> imageInfos;
+        std::vector<VkDescriptorBufferInfo> bufferInfos;
         std::vector<VkWriteDescriptorSet> writes;
+        std::vector<InfoRef> infoRefs; // one per write
+        size_t queuedWrites{0};        // writes already assigned to a set by QueueSet
+        u32 queuedSets{0};
 
         VkDescriptorWriter& WriteImage(u32 binding, VkImageView image, VkSampler sampler, VkImageLayout layout,
                                        VkDescriptorType type);
         VkDescriptorWriter& WriteBuffer(u32 binding, VkBuffer buffer, size_t size, size_t offset, VkDescriptorType type);
 
+        // Preallocate storage for a batch so recording never reallocates.
+        void Reserve(u32 writeCount, u32 imageCount, u32 bufferCount);
         void Clear();
+        // Writes everything recorded to one set right away.
         void UpdateSet(VkDevice device, VkDescriptorSet set);
+
+        // Assigns the writes recorded since the previous QueueSet to the set.
+        void QueueSet(VkDescriptorSet set);
+        // Applies every queued write with a single vkUpdateDescriptorSets and clears the writer.
+        // Returns the number of sets written.
+        u32 Flush(VkDevice device);
+
+    private:
+        void ResolveInfos();
     };
 
     // VkDescriptor: Manages descriptor pools and allocation.
@@ -49,7 +74,8 @@ namespace GraphicsAPI::Vulkan
         };
 
         // Initialize a descriptor pool with the specified pool size ratios.
-        void Init(VkDevice device, u32 initialSets, std::span<PoolSizeRatio> poolRatios);
+        void Init(VkDevice device, u32 initialSets, std::span<PoolSizeRatio> poolRatios,
+                  VkDescriptorPoolCreateFlags flags = 0);
 
         // Clear all descriptor pools.
         void ClearPools(VkDevice device);
@@ -57,19 +83,93 @@ namespace GraphicsAPI::Vulkan
         // Destroy all descriptor pools.
         void DestroyPools(VkDevice device);
 
-        // Allocate a descriptor set from the pool.
-        VkDescriptorSet Allocate(VkDevice device, VkDescriptorSetLayout layout, void *pNext = nullptr);
+        // Allocate a descriptor set from the pool, optionally returning the pool it came from.
+        VkDescriptorSet Allocate(VkDevice device, VkDescriptorSetLayout layout, void *pNext = nullptr,
+                                 VkDescriptorPool *outPool = nullptr);
+
+        // Return a single set to its pool, needs VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.
+        void Free(VkDevice device, VkDescriptorPool pool, VkDescriptorSet set);
 
     private:
         VkDescriptorPool GetPool(VkDevice device); // Retrieve a ready pool.
         VkDescriptorPool CreatePool(VkDevice device, u32 setCount, std::span<PoolSizeRatio> poolRatios); // Create a new descriptor pool.
 
         std::vector<PoolSizeRatio> ratios;  // Pool size ratios (used for creating new pools).
+        VkDescriptorPoolCreateFlags poolFlags{};  // Flags every pool is created with.
         std::vector<VkDescriptorPool> fullPools;  // Pools that are full and cannot allocate more sets.
         std::vector<VkDescriptorPool> readyPools;  // Pools that can still allocate sets.
         u32 setsPerPool{};  // Number of sets per pool.
     };
 
+    // Descriptor Set Cache: Hands out the same set for the same layout + bound resources instead of allocating
+    // and writing a new one. Least recently used sets are evicted past the capacity, and sets referencing a
+    // destroyed resource are dropped through Invalidate. Freed sets wait until no frame in flight can use them.
+    class DescriptorSetCache
+    {
+    public:
+        void Init(VkDevice device, u32 capacity, u32 framesInFlight,
+                  std::span<DescriptorAllocatorGrowable::PoolSizeRatio> poolRatios);
+        void Destroy(VkDevice device);
+
+        // Call once the frame's fence has been waited on, frees sets retired framesInFlight frames ago.
+        void BeginFrame(VkDevice device, u64 frameNumber);
+
+        // Looks up a set matching the layout and the writer's bindings, allocating and writing one on a miss.
+        VkDescriptorSet Get(VkDevice device, VkDescriptorSetLayout layout, VkDescriptorWriter& writer);
+
+        // Drop every cached set that references the resource, call before destroying it.
+        void Invalidate(VkBuffer buffer);
+        void Invalidate(VkImageView imageView);
+        void Invalidate(VkSampler sampler);
+
+        [[nodiscard]] u32 Size() const { return static_cast<u32>(entries.size()); }
+        [[nodiscard]] u32 Hits() const { return hits; }     // since the last BeginFrame
+        [[nodiscard]] u32 Misses() const { return misses; } // since the last BeginFrame
+
+    private:
+        struct Key
+        {
+            std::vector<u64> words; // layout, then binding/type and handles of every write
+            u64 hash{};
+
+            bool operator==(const Key& other) const { return hash == other.hash && words == other.words; }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const { return key.hash; }
+        };
+
+        struct Entry
+        {
+            Key key;
+            VkDescriptorSet set;
+            VkDescriptorPool pool;
+        };
+
+        struct RetiredSet
+        {
+            VkDescriptorSet set;
+            VkDescriptorPool pool;
+            u64 frame;
+        };
+
+        static Key MakeKey(VkDescriptorSetLayout layout, const VkDescriptorWriter& writer);
+        void InvalidateHandle(u64 handle);
+        void Retire(std::list<Entry>::iterator it);
+
+        DescriptorAllocatorGrowable allocator;
+        std::list<Entry> entries; // most recently used first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup;
+        std::vector<RetiredSet> retired;
+
+        u32 capacity{};
+        u32 framesInFlight{};
+        u64 frameNumber{};
+        u32 hits{};
+        u32 misses{};
+    };
+
 } // namespace GraphicsAPI::Vulkan
 
 #endif
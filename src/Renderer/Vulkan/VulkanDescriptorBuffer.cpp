@@ -0,0 +1,226 @@
+//
+// Created by Orgest on 10/22/2024.
+//
+
+#include "VulkanDescriptorBuffer.h"
+
+#include <cstring>
+
+#include "VulkanMain.h"
+
+using namespace GraphicsAPI::Vulkan;
+
+bool DescriptorBufferAllocator::LoadDevice(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+	getLayoutSize_    = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(
+		vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutSizeEXT"));
+	getBindingOffset_ = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
+		vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+	getDescriptor_    = reinterpret_cast<PFN_vkGetDescriptorEXT>(
+		vkGetDeviceProcAddr(device, "vkGetDescriptorEXT"));
+	cmdBindBuffers_   = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(
+		vkGetDeviceProcAddr(device, "vkCmdBindDescriptorBuffersEXT"));
+	cmdSetOffsets_    = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(
+		vkGetDeviceProcAddr(device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+
+	supported_ = getLayoutSize_ && getBindingOffset_ && getDescriptor_ && cmdBindBuffers_ && cmdSetOffsets_;
+	if (!supported_)
+	{
+		return false;
+	}
+
+	properties_ = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT };
+	VkPhysicalDeviceProperties2 properties
+	{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &properties_
+	};
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	return true;
+}
+
+void DescriptorBufferAllocator::Init(VkEngine* engine, VkDeviceSize size)
+{
+	if (!supported_)
+	{
+		return;
+	}
+
+	engine_ = engine;
+	size_   = size;
+	head_   = 0;
+
+	// Combined image samplers embed the sampler, so the buffer holds both kinds of descriptors
+	buffer_ = engine_->CreateBuffer(size, VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+	                                      VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+	                                      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+	                                VMA_MEMORY_USAGE_CPU_TO_GPU);
+	address_ = VkEngine::GetBufferDeviceAddress(buffer_.buffer);
+}
+
+void DescriptorBufferAllocator::Cleanup()
+{
+	if (!IsValid())
+	{
+		return;
+	}
+
+	engine_->DestroyBuffer(buffer_);
+	buffer_  = {};
+	address_ = 0;
+	head_    = 0;
+}
+
+DescriptorBufferAllocator::Allocation DescriptorBufferAllocator::Allocate(VkDevice device, VkDescriptorSetLayout layout)
+{
+	if (!IsValid())
+	{
+		return {};
+	}
+
+	const VkDeviceSize layoutSize = LayoutSize(device, layout);
+
+	const VkDeviceSize alignment = properties_.descriptorBufferOffsetAlignment;
+	const VkDeviceSize offset    = (head_ + alignment - 1) & ~(alignment - 1);
+	if (offset + layoutSize > size_)
+	{
+		LOG(WARN, "Descriptor buffer is full, ", size_, " bytes");
+		return {};
+	}
+
+	head_ = offset + layoutSize;
+	return {
+		.layout = layout,
+		.offset = offset,
+		.data = static_cast<u8*>(buffer_.info.pMappedData) + offset
+	};
+}
+
+DescriptorBufferAllocator::Allocation DescriptorBufferAllocator::Copy(VkDevice device, VkDescriptorSetLayout layout,
+                                                                    std::span<const u8> descriptors)
+{
+	Allocation set = Allocate(device, layout);
+	if (set.IsValid())
+	{
+		std::memcpy(set.data, descriptors.data(), descriptors.size());
+	}
+	return set;
+}
+
+VkDeviceSize DescriptorBufferAllocator::LayoutSize(VkDevice device, VkDescriptorSetLayout layout)
+{
+	VkDeviceSize layoutSize = 0;
+	getLayoutSize_(device, layout, &layoutSize);
+	return layoutSize;
+}
+
+size_t DescriptorBufferAllocator::DescriptorSize(VkDescriptorType type)
+{
+	switch (type)
+	{
+	case VK_DESCRIPTOR_TYPE_SAMPLER:                return properties_.samplerDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: return properties_.combinedImageSamplerDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:          return properties_.sampledImageDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:          return properties_.storageImageDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:         return properties_.uniformBufferDescriptorSize;
+	case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:         return properties_.storageBufferDescriptorSize;
+	default:
+		LOG(ERR, "Unsupported descriptor type for descriptor buffers: ", string_VkDescriptorType(type));
+		return 0;
+	}
+}
+
+void DescriptorBufferAllocator::WriteImage(VkDevice device, const Allocation& set, u32 binding, VkImageView image,
+                                           VkSampler sampler, VkImageLayout layout, VkDescriptorType type)
+{
+	if (!set.IsValid())
+	{
+		return;
+	}
+
+	VkDescriptorImageInfo imageInfo{ .sampler = sampler, .imageView = image, .imageLayout = layout };
+
+	VkDescriptorGetInfoEXT getInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT, .type = type };
+	switch (type)
+	{
+	case VK_DESCRIPTOR_TYPE_SAMPLER:                getInfo.data.pSampler = &imageInfo.sampler; break;
+	case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: getInfo.data.pCombinedImageSampler = &imageInfo; break;
+	case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:          getInfo.data.pSampledImage = &imageInfo; break;
+	default:                                        getInfo.data.pStorageImage = &imageInfo; break;
+	}
+
+	VkDeviceSize bindingOffset = 0;
+	getBindingOffset_(device, set.layout, binding, &bindingOffset);
+	getDescriptor_(device, &getInfo, DescriptorSize(type), set.data + bindingOffset);
+}
+
+void DescriptorBufferAllocator::WriteBuffer(VkDevice device, const Allocation& set, u32 binding,
+                                            VkDeviceAddress address, VkDeviceSize range, VkDescriptorType type)
+{
+	if (!set.IsValid())
+	{
+		return;
+	}
+
+	VkDescriptorAddressInfoEXT addressInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT,
+		.address = address,
+		.range = range
+	};
+
+	VkDescriptorGetInfoEXT getInfo{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT, .type = type };
+	if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+	{
+		getInfo.data.pUniformBuffer = &addressInfo;
+	}
+	else
+	{
+		getInfo.data.pStorageBuffer = &addressInfo;
+	}
+
+	VkDeviceSize bindingOffset = 0;
+	getBindingOffset_(device, set.layout, binding, &bindingOffset);
+	getDescriptor_(device, &getInfo, DescriptorSize(type), set.data + bindingOffset);
+}
+
+void DescriptorBufferAllocator::Bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                                     u32 setIndex, const Allocation& set) const
+{
+	if (!IsValid() || !set.IsValid())
+	{
+		return;
+	}
+
+	BindBuffer(cmd);
+	SetOffset(cmd, bindPoint, layout, setIndex, set);
+}
+
+void DescriptorBufferAllocator::BindBuffer(VkCommandBuffer cmd) const
+{
+	if (!IsValid())
+	{
+		return;
+	}
+
+	VkDescriptorBufferBindingInfoEXT bindingInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT,
+		.address = address_,
+		.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT
+	};
+	cmdBindBuffers_(cmd, 1, &bindingInfo);
+}
+
+void DescriptorBufferAllocator::SetOffset(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                                          u32 setIndex, const Allocation& set) const
+{
+	if (!IsValid() || !set.IsValid())
+	{
+		return;
+	}
+
+	const u32 bufferIndex = 0;
+	cmdSetOffsets_(cmd, bindPoint, layout, setIndex, 1, &bufferIndex, &set.offset);
+}
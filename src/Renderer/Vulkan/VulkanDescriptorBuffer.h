@@ -0,0 +1,84 @@
+//
+// Created by Orgest on 10/22/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include "VulkanHeader.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	class VkEngine;
+
+	// VK_EXT_descriptor_buffer backend for per frame descriptors. Sets are aligned ranges of one persistently mapped
+	// buffer handed out linearly, descriptors are copied straight into them with vkGetDescriptorEXT and the whole
+	// buffer is recycled with Reset once the frame's fence has signaled. No pools, no vkUpdateDescriptorSets.
+	// Layouts and pipelines used with it need the DESCRIPTOR_BUFFER create flags.
+	class DescriptorBufferAllocator
+	{
+	public:
+		struct Allocation
+		{
+			VkDescriptorSetLayout layout{ VK_NULL_HANDLE };
+			VkDeviceSize          offset{ 0 };
+			u8*                   data{ nullptr }; // nullptr when the buffer was full
+
+			[[nodiscard]] bool IsValid() const { return data != nullptr; }
+		};
+
+		// Checks for the extension's entry points and caches the descriptor sizes, false when the device lacks it
+		static bool LoadDevice(VkDevice device, VkPhysicalDevice physicalDevice);
+		static bool IsSupported() { return supported_; }
+
+		void Init(VkEngine* engine, VkDeviceSize size);
+		void Cleanup();
+
+		void Reset() { head_ = 0; }
+
+		Allocation Allocate(VkDevice device, VkDescriptorSetLayout layout);
+		// Allocates a set and fills it with descriptors written ahead of time, see LayoutSize
+		Allocation Copy(VkDevice device, VkDescriptorSetLayout layout, std::span<const u8> descriptors);
+
+		// Bytes a set of the layout takes. Sets written into host memory of this size, through an Allocation whose
+		// data points there, can be copied into any frame's buffer later.
+		static VkDeviceSize LayoutSize(VkDevice device, VkDescriptorSetLayout layout);
+
+		static void WriteImage(VkDevice device, const Allocation& set, u32 binding, VkImageView image,
+		                       VkSampler sampler, VkImageLayout layout, VkDescriptorType type);
+		static void WriteBuffer(VkDevice device, const Allocation& set, u32 binding, VkDeviceAddress address,
+		                        VkDeviceSize range, VkDescriptorType type);
+
+		// Binds this buffer and points the set at the allocation
+		void Bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, u32 setIndex,
+		          const Allocation& set) const;
+		// Same thing in two steps, for command buffers that bind the buffer once and then only move set offsets
+		void BindBuffer(VkCommandBuffer cmd) const;
+		void SetOffset(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, u32 setIndex,
+		               const Allocation& set) const;
+
+		[[nodiscard]] bool         IsValid() const { return buffer_.buffer != VK_NULL_HANDLE; }
+		[[nodiscard]] VkDeviceSize Used() const { return head_; }
+		[[nodiscard]] VkDeviceSize Capacity() const { return size_; }
+
+	private:
+		static size_t DescriptorSize(VkDescriptorType type);
+
+		static inline bool                                      supported_{ false };
+		static inline VkPhysicalDeviceDescriptorBufferPropertiesEXT properties_{};
+
+		static inline PFN_vkGetDescriptorSetLayoutSizeEXT          getLayoutSize_{ nullptr };
+		static inline PFN_vkGetDescriptorSetLayoutBindingOffsetEXT getBindingOffset_{ nullptr };
+		static inline PFN_vkGetDescriptorEXT                       getDescriptor_{ nullptr };
+		static inline PFN_vkCmdBindDescriptorBuffersEXT            cmdBindBuffers_{ nullptr };
+		static inline PFN_vkCmdSetDescriptorBufferOffsetsEXT       cmdSetOffsets_{ nullptr };
+
+		VkEngine*       engine_{ nullptr };
+		AllocatedBuffer buffer_{};
+		VkDeviceAddress address_{ 0 };
+		VkDeviceSize    size_{ 0 };
+		VkDeviceSize    head_{ 0 };
+	};
+}
+
+#endif
@@ -0,0 +1,348 @@
+//
+// Created by Orgest on 10/26/2024.
+//
+
+#include "VulkanGpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace GraphicsAPI::Vulkan;
+
+namespace
+{
+	// One u64 per statistic plus the availability word
+	constexpr u32 STATISTIC_COUNT = sizeof(GpuProfiler::PipelineStatistics) / sizeof(u64);
+	constexpr u32 STATISTIC_STRIDE = STATISTIC_COUNT + 1;
+}
+
+GpuProfiler::PassCounters& GpuProfiler::PassCounters::operator+=(const PassCounters& other)
+{
+	draws             += other.draws;
+	indirectDraws     += other.indirectDraws;
+	instances         += other.instances;
+	dispatches        += other.dispatches;
+	pipelineBinds     += other.pipelineBinds;
+	descriptorBinds   += other.descriptorBinds;
+	indexBufferBinds  += other.indexBufferBinds;
+	pushConstantBytes += other.pushConstantBytes;
+	return *this;
+}
+
+void GpuProfiler::Init(VkDevice device, VkPhysicalDevice physicalDevice, u32 queueFamily, u32 framesInFlight,
+                       bool pipelineStatisticsSupported)
+{
+	device_ = device;
+	frames_.resize(framesInFlight);
+	for (FrameQueries& frame : frames_)
+	{
+		frame.scopes.reserve(MAX_SCOPES);
+	}
+
+	u32 familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+	const u32 validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+	timestamps_ = validBits != 0;
+	if (timestamps_)
+	{
+		validMask_ = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		timestampPeriod_ = properties.limits.timestampPeriod;
+
+		VkQueryPoolCreateInfo poolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = MAX_SCOPES * 2
+		};
+		for (FrameQueries& frame : frames_)
+		{
+			VK_CHECK(vkCreateQueryPool(device_, &poolInfo, nullptr, &frame.timestampPool));
+		}
+	}
+	else
+	{
+		LOG(WARN, "Graphics queue has no timestamp support, GPU timings disabled");
+	}
+
+	statisticsSupported_ = pipelineStatisticsSupported;
+	if (statisticsSupported_)
+	{
+		VkQueryPoolCreateInfo poolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+			.queryCount = MAX_SCOPES,
+			.pipelineStatistics = STATISTIC_FLAGS
+		};
+		for (FrameQueries& frame : frames_)
+		{
+			VK_CHECK(vkCreateQueryPool(device_, &poolInfo, nullptr, &frame.statisticsPool));
+		}
+	}
+}
+
+void GpuProfiler::Destroy()
+{
+	for (FrameQueries& frame : frames_)
+	{
+		if (frame.timestampPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device_, frame.timestampPool, nullptr);
+		}
+		if (frame.statisticsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device_, frame.statisticsPool, nullptr);
+		}
+	}
+	frames_.clear();
+	current_ = nullptr;
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer cmd, u32 frameSlot)
+{
+	if (frames_.empty())
+	{
+		return;
+	}
+
+	current_ = &frames_[frameSlot % frames_.size()];
+	Collect(*current_);
+	current_->scopes.clear();
+	openScopes_.clear();
+	statisticsScope_ = MAX_SCOPES;
+
+	if (current_->timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(cmd, current_->timestampPool, 0, MAX_SCOPES * 2);
+	}
+	if (current_->statisticsPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(cmd, current_->statisticsPool, 0, MAX_SCOPES);
+	}
+}
+
+u32 GpuProfiler::BeginScope(VkCommandBuffer cmd, std::string_view name, bool pipelineStatistics)
+{
+	if (!current_ || current_->scopes.size() >= MAX_SCOPES)
+	{
+		return MAX_SCOPES;
+	}
+
+	const u32 scope = static_cast<u32>(current_->scopes.size());
+	ScopeRecord& record = current_->scopes.emplace_back();
+	record.name = name;
+	openScopes_.push_back(scope);
+
+	if (current_->timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, current_->timestampPool, scope * 2);
+	}
+	if (pipelineStatistics && this->pipelineStatistics && current_->statisticsPool != VK_NULL_HANDLE &&
+	    statisticsScope_ == MAX_SCOPES)
+	{
+		vkCmdBeginQuery(cmd, current_->statisticsPool, scope, 0);
+		statisticsScope_ = scope;
+		record.statistics = true;
+	}
+	return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer cmd, u32 scope)
+{
+	if (!current_ || scope >= MAX_SCOPES)
+	{
+		return;
+	}
+
+	if (statisticsScope_ == scope)
+	{
+		vkCmdEndQuery(cmd, current_->statisticsPool, scope);
+		statisticsScope_ = MAX_SCOPES;
+	}
+	if (current_->timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, current_->timestampPool, scope * 2 + 1);
+	}
+	std::erase(openScopes_, scope);
+}
+
+GpuProfiler::PassCounters& GpuProfiler::Counters()
+{
+	if (!current_ || openScopes_.empty())
+	{
+		discarded_ = {};
+		return discarded_;
+	}
+	return current_->scopes[openScopes_.back()].counters;
+}
+
+void GpuProfiler::Collect(FrameQueries& frame)
+{
+	if (frame.scopes.empty())
+	{
+		return;
+	}
+
+	// Value and availability per query. The frame that last used this slot has finished, no need to wait.
+	const u32 scopeCount = static_cast<u32>(frame.scopes.size());
+	std::vector<u64> timestamps;
+	if (frame.timestampPool != VK_NULL_HANDLE)
+	{
+		timestamps.resize(scopeCount * 4);
+		const VkResult result = vkGetQueryPoolResults(device_, frame.timestampPool, 0, scopeCount * 2,
+		                                              timestamps.size() * sizeof(u64), timestamps.data(),
+		                                              2 * sizeof(u64),
+		                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			timestamps.clear();
+		}
+	}
+
+	std::vector<u64> statistics;
+	if (frame.statisticsPool != VK_NULL_HANDLE && std::ranges::any_of(frame.scopes, &ScopeRecord::statistics))
+	{
+		statistics.resize(scopeCount * STATISTIC_STRIDE);
+		const VkResult result = vkGetQueryPoolResults(device_, frame.statisticsPool, 0, scopeCount,
+		                                              statistics.size() * sizeof(u64), statistics.data(),
+		                                              STATISTIC_STRIDE * sizeof(u64),
+		                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			statistics.clear();
+		}
+	}
+
+	frameCounters_ = {};
+	for (u32 i = 0; i < scopeCount; i++)
+	{
+		const ScopeRecord& record = frame.scopes[i];
+		ScopeStats& stats = Find(record.name);
+		stats.counters = record.counters;
+		frameCounters_ += record.counters;
+
+		stats.hasStatistics = false;
+		if (record.statistics && !statistics.empty() && statistics[i * STATISTIC_STRIDE + STATISTIC_COUNT] != 0)
+		{
+			std::memcpy(&stats.statistics, &statistics[i * STATISTIC_STRIDE], sizeof(PipelineStatistics));
+			stats.hasStatistics = true;
+		}
+
+		if (!timestamps.empty())
+		{
+			const u64* begin = &timestamps[i * 4];
+			const u64* end   = &timestamps[i * 4 + 2];
+			if (begin[1] != 0 && end[1] != 0)
+			{
+				const u64 ticks = ((end[0] & validMask_) - (begin[0] & validMask_)) & validMask_;
+				RecordTime(stats, static_cast<f32>(static_cast<f64>(ticks) * timestampPeriod_ * 1e-6));
+			}
+		}
+	}
+	framesCollected_++;
+}
+
+GpuProfiler::ScopeStats& GpuProfiler::Find(const std::string& name)
+{
+	auto it = std::ranges::find(stats_, name, &ScopeStats::name);
+	if (it != stats_.end())
+	{
+		return *it;
+	}
+
+	history_.push_back({ .samples = std::vector<f32>(WINDOW_SIZE) });
+	return stats_.emplace_back(ScopeStats{ .name = name });
+}
+
+void GpuProfiler::RecordTime(ScopeStats& stats, f32 ms)
+{
+	History& history = history_[&stats - stats_.data()];
+	history.samples[history.next] = ms;
+	history.next  = (history.next + 1) % WINDOW_SIZE;
+	history.count = std::min(history.count + 1, WINDOW_SIZE);
+
+	std::vector<f32> sorted(history.samples.begin(), history.samples.begin() + history.count);
+	std::ranges::sort(sorted);
+	auto percentile = [&](f32 p) { return sorted[static_cast<size_t>(p * static_cast<f32>(sorted.size() - 1) + 0.5f)]; };
+
+	f32 sum = 0.f;
+	for (const f32 sample : sorted)
+	{
+		sum += sample;
+	}
+
+	stats.lastMs  = ms;
+	stats.avgMs   = sum / static_cast<f32>(sorted.size());
+	stats.p50Ms   = percentile(0.50f);
+	stats.p95Ms   = percentile(0.95f);
+	stats.p99Ms   = percentile(0.99f);
+	stats.samples = history.count;
+}
+
+f32 GpuProfiler::AverageMs(std::string_view name) const
+{
+	auto it = std::ranges::find(stats_, name, &ScopeStats::name);
+	return it != stats_.end() ? it->avgMs : 0.f;
+}
+
+f32 GpuProfiler::LastMs(std::string_view name) const
+{
+	auto it = std::ranges::find(stats_, name, &ScopeStats::name);
+	return it != stats_.end() ? it->lastMs : 0.f;
+}
+
+bool GpuProfiler::WriteJson(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+	{
+		LOG(WARN, "Could not write GPU timings to ", path.string());
+		return false;
+	}
+
+	file << "{\n  \"frames\": " << framesCollected_ << ",\n  \"window\": " << WINDOW_SIZE << ",\n  \"scopes\": [";
+	for (size_t i = 0; i < stats_.size(); i++)
+	{
+		const ScopeStats& s = stats_[i];
+		const PassCounters& c = s.counters;
+		file << (i == 0 ? "\n" : ",\n")
+		     << "    { \"name\": \"" << s.name << "\""
+		     << ", \"samples\": " << s.samples
+		     << ", \"last_ms\": " << s.lastMs
+		     << ", \"avg_ms\": " << s.avgMs
+		     << ", \"p50_ms\": " << s.p50Ms
+		     << ", \"p95_ms\": " << s.p95Ms
+		     << ", \"p99_ms\": " << s.p99Ms
+		     << ",\n      \"counters\": { \"draws\": " << c.draws
+		     << ", \"indirect_draws\": " << c.indirectDraws
+		     << ", \"instances\": " << c.instances
+		     << ", \"dispatches\": " << c.dispatches
+		     << ", \"pipeline_binds\": " << c.pipelineBinds
+		     << ", \"descriptor_binds\": " << c.descriptorBinds
+		     << ", \"index_buffer_binds\": " << c.indexBufferBinds
+		     << ", \"push_constant_bytes\": " << c.pushConstantBytes << " }";
+		if (s.hasStatistics)
+		{
+			const PipelineStatistics& p = s.statistics;
+			file << ",\n      \"pipeline_statistics\": { \"input_vertices\": " << p.inputVertices
+			     << ", \"input_primitives\": " << p.inputPrimitives
+			     << ", \"vertex_invocations\": " << p.vertexInvocations
+			     << ", \"clipping_invocations\": " << p.clippingInvocations
+			     << ", \"clipping_primitives\": " << p.clippingPrimitives
+			     << ", \"fragment_invocations\": " << p.fragmentInvocations
+			     << ", \"compute_invocations\": " << p.computeInvocations << " }";
+		}
+		file << " }";
+	}
+	file << "\n  ]\n}\n";
+
+	LOG(INFO, "Wrote GPU timings for ", stats_.size(), " scopes to ", path.string());
+	return true;
+}
@@ -0,0 +1,159 @@
+//
+// Created by Orgest on 10/26/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "VulkanHeader.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	// Timestamp queries around named scopes, one query pool per frame in flight. A slot's results are read when the
+	// slot comes around again, after the frame timeline shows it finished, so reading never stalls. Each scope name
+	// keeps a rolling window of samples for averages and percentiles. Works without Tracy.
+	//
+	// Scopes also carry CPU side counters of the commands recorded in them, and optionally a pipeline statistics
+	// query. Counters go to the innermost open scope, so summing every scope gives the frame total.
+	class GpuProfiler
+	{
+	public:
+		// Incremented by the code recording the commands, see Counters()
+		struct PassCounters
+		{
+			u32 draws{};             // direct draw calls
+			u32 indirectDraws{};     // indirect draw calls, each may expand to many draws on the GPU
+			u32 instances{};         // instances of the direct draws
+			u32 dispatches{};
+			u32 pipelineBinds{};
+			u32 descriptorBinds{};
+			u32 indexBufferBinds{};
+			u32 pushConstantBytes{};
+
+			PassCounters& operator+=(const PassCounters& other);
+		};
+
+		// In the order the query writes them
+		struct PipelineStatistics
+		{
+			u64 inputVertices{};
+			u64 inputPrimitives{};
+			u64 vertexInvocations{};
+			u64 clippingInvocations{};
+			u64 clippingPrimitives{};
+			u64 fragmentInvocations{};
+			u64 computeInvocations{};
+		};
+
+		struct ScopeStats
+		{
+			std::string name;
+			f32 lastMs{};
+			f32 avgMs{};
+			f32 p50Ms{};
+			f32 p95Ms{};
+			f32 p99Ms{};
+			u32 samples{};
+			PassCounters counters;         // of the last collected frame
+			PipelineStatistics statistics; // of the last collected frame, zero unless queried
+			bool hasStatistics{ false };
+		};
+
+		static constexpr u32 MAX_SCOPES   = 64;
+		static constexpr u32 WINDOW_SIZE  = 240; // samples per scope the statistics are taken over
+		static constexpr VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+		// Timestamps are skipped when the graphics queue can't write them, pipeline statistics when the device feature
+		// wasn't enabled. Counters always work.
+		void Init(VkDevice device, VkPhysicalDevice physicalDevice, u32 queueFamily, u32 framesInFlight,
+		          bool pipelineStatisticsSupported);
+		void Destroy();
+
+		// Collects the results this slot produced last time around and resets its queries, call right after
+		// vkBeginCommandBuffer
+		void BeginFrame(VkCommandBuffer cmd, u32 frameSlot);
+
+		// Returns the scope index for EndScope, scopes past MAX_SCOPES are ignored. Only one pipeline statistics query
+		// can be active at a time, a nested request for one is dropped.
+		u32  BeginScope(VkCommandBuffer cmd, std::string_view name, bool pipelineStatistics = false);
+		void EndScope(VkCommandBuffer cmd, u32 scope);
+
+		// Counters of the innermost open scope
+		PassCounters& Counters();
+		// Statistics of the active pipeline statistics query, secondary command buffers executed under it inherit these
+		[[nodiscard]] VkQueryPipelineStatisticFlags ActiveStatistics() const
+		{
+			return statisticsScope_ != MAX_SCOPES ? STATISTIC_FLAGS : 0;
+		}
+
+		[[nodiscard]] bool IsEnabled() const { return timestamps_; }
+		[[nodiscard]] bool PipelineStatisticsSupported() const { return statisticsSupported_; }
+		[[nodiscard]] const std::vector<ScopeStats>& Stats() const { return stats_; }
+		// Sum of every scope's counters in the last collected frame
+		[[nodiscard]] const PassCounters& FrameCounters() const { return frameCounters_; }
+		// Average and last collected time of the named scope, 0 when it was never measured
+		[[nodiscard]] f32 AverageMs(std::string_view name) const;
+		[[nodiscard]] f32 LastMs(std::string_view name) const;
+
+		// Every scope's statistics as JSON, for scripts comparing runs
+		bool WriteJson(const std::filesystem::path& path) const;
+
+		bool pipelineStatistics{ false }; // query pipeline statistics in scopes asking for them
+
+	private:
+		struct History
+		{
+			std::vector<f32> samples; // ring buffer of WINDOW_SIZE
+			u32 next{};
+			u32 count{};
+		};
+
+		struct ScopeRecord
+		{
+			std::string name;
+			PassCounters counters;
+			bool statistics{ false };
+		};
+
+		struct FrameQueries
+		{
+			VkQueryPool timestampPool{ VK_NULL_HANDLE };
+			VkQueryPool statisticsPool{ VK_NULL_HANDLE };
+			std::vector<ScopeRecord> scopes; // written this frame, in query order
+		};
+
+		void Collect(FrameQueries& frame);
+		ScopeStats& Find(const std::string& name);
+		void RecordTime(ScopeStats& stats, f32 ms);
+
+		VkDevice device_{ VK_NULL_HANDLE };
+		bool timestamps_{ false };
+		bool statisticsSupported_{ false };
+		f32 timestampPeriod_{ 1.f }; // nanoseconds per tick
+		u64 validMask_{ ~0ull };
+
+		std::vector<FrameQueries> frames_;
+		FrameQueries* current_{ nullptr };
+		std::vector<u32> openScopes_;
+		u32 statisticsScope_{ MAX_SCOPES }; // scope owning the active statistics query
+		PassCounters discarded_;            // taken by Counters() outside of any scope
+
+		std::vector<ScopeStats> stats_;
+		std::vector<History> history_; // parallel to stats_
+		PassCounters frameCounters_;
+		u64 framesCollected_{ 0 };
+	};
+}
+
+#endif
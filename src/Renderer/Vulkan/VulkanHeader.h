@@ -69,12 +69,25 @@ namespace GraphicsAPI::Vulkan
 		glm::vec4 color;
 	};
 
+	// meshlet as read by meshlet_cull.comp, indices live in the mesh's regular index buffer
+	struct GPUMeshlet
+	{
+		glm::vec4 sphere;     // xyz center, w radius
+		glm::vec4 cone;       // xyz axis, w cutoff (> 1 disables the backface test)
+		u32       firstIndex;
+		u32       indexCount;
+		u32       pad0;
+		u32       pad1;
+	};
+
 	// holds the resources needed for a mesh
 	struct GPUMeshBuffers
 	{
 		AllocatedBuffer indexBuffer;
 		AllocatedBuffer vertexBuffer;
 		VkDeviceAddress vertexBufferAddress;
+		AllocatedBuffer meshletBuffer{};   // empty when the mesh has no meshlets
+		VkDeviceAddress meshletBufferAddress{};
 	};
 
 	// push constants for our mesh object draws
@@ -84,6 +97,30 @@ namespace GraphicsAPI::Vulkan
 		VkDeviceAddress vertexBuffer;
 	};
 
+	// per frame input of the cluster culling pass, followed by one GPUClusterDraw per clustered draw
+	struct GPUClusterCullHeader
+	{
+		glm::vec4 frustum[5]; // left, right, bottom, top, near; xyz normal, w distance
+		glm::vec4 cameraPosition;
+	};
+
+	struct GPUClusterDraw
+	{
+		glm::mat4       transform;
+		VkDeviceAddress meshlets;      // already offset to the surface's first meshlet
+		u32             meshletCount;
+		u32             commandOffset; // first VkDrawIndexedIndirectCommand slot of this draw
+	};
+
+	struct MeshletCullPushConstants
+	{
+		VkDeviceAddress cullData;
+		VkDeviceAddress drawCommands;
+		VkDeviceAddress drawCounts;
+		u32             drawCount;
+		u32             coneCulling;
+	};
+
 	struct AllocatedImage
 	{
 		VkImage		  image;
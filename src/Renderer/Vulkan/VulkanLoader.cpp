@@ -5,6 +5,8 @@
 #include "VulkanLoader.h"
 #include "VulkanMain.h"
 
+#include <chrono>
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include <fastgltf/core.hpp>
 #include <fastgltf/glm_element_traits.hpp>
@@ -14,6 +16,8 @@
 #include <stb_image.h>
 
 #include "VulkanImages.h"
+#include "../MeshletBuilder.h"
+#include "../MeshSimplifier.h"
 
 
 using namespace GraphicsAPI::Vulkan;
@@ -174,11 +178,16 @@ std::optional<std::shared_ptr<LoadedGLTF>> VkLoader::LoadGltfMeshes(VkEngine*
 	std::vector<std::shared_ptr<GLTFMaterial>> materials;
 
 	file.materialDataBuffer = engine->CreateBuffer(sizeof(GLTFMetallicRoughness::MaterialConstants) *
-		gltf.materials.size(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		gltf.materials.size(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU);
 	int data_index = 0;
 	auto* sceneMaterialConstants =
 		static_cast<GLTFMetallicRoughness::MaterialConstants*>(file.materialDataBuffer.info.pMappedData);
 
+	// Material sets are written in one batch after the loop
+	engine->metalRoughMaterial.BeginMaterialWrites(static_cast<u32>(gltf.materials.size()));
+	f64 materialWriteMs = 0.0;
+
 	for (fastgltf::Material& mat : gltf.materials)
 	{
 		auto newMat = std::make_shared<GLTFMaterial>();
@@ -193,12 +202,19 @@ std::optional<std::shared_ptr<LoadedGLTF>> VkLoader::LoadGltfMeshes(VkEngine*
 
         constants.metalRoughnessFactors.x = mat.pbrData.metallicFactor;
         constants.metalRoughnessFactors.y = mat.pbrData.roughnessFactor;
+        constants.metalRoughnessFactors.z = mat.alphaCutoff;
 
         // write material parameters to buffer
         sceneMaterialConstants[data_index] = constants;
 
 		MaterialPass passType = (mat.alphaMode == fastgltf::AlphaMode::Blend) ?
 								MaterialPass::Transparent : MaterialPass::MainColor;
+		newMat->doubleSided = mat.doubleSided;
+
+		// Vertex colors are only known once the primitives using the material are loaded
+		newMat->features.textured = mat.pbrData.baseColorTexture.has_value();
+		newMat->features.alphaTest = mat.alphaMode == fastgltf::AlphaMode::Mask;
+		newMat->features.vertexColors = false;
 
         GLTFMetallicRoughness::MaterialResources materialResources;
         // default the material textures
@@ -223,10 +239,24 @@ std::optional<std::shared_ptr<LoadedGLTF>> VkLoader::LoadGltfMeshes(VkEngine*
 			}
 		}
 
-		newMat->data = engine->metalRoughMaterial.WriteMaterial(vd.device, passType, materialResources, file.descriptorPool);
+		const auto queueStart = std::chrono::high_resolution_clock::now();
+		newMat->data = engine->metalRoughMaterial.QueueMaterial(vd.device, passType, materialResources, file.descriptorPool);
+		materialWriteMs += std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - queueStart).count();
+
+		engine->metalRoughMaterial.WriteBindlessMaterial(vd.device, engine->bindless_, constants, materialResources, newMat->data);
 		data_index++;
     }
 
+	{
+		const auto flushStart = std::chrono::high_resolution_clock::now();
+		const u32 setCount = engine->metalRoughMaterial.FlushMaterialWrites(vd.device);
+		materialWriteMs += std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - flushStart).count();
+		if (setCount > 0)
+		{
+			LOG(INFO, "Material descriptors: ", setCount, " sets in 1 vkUpdateDescriptorSets call, ", materialWriteMs, " ms");
+		}
+	}
+
 	// Load meshes
 	std::vector<uint32_t> indices;
 	std::vector<Vertex> vertices;
@@ -365,12 +395,59 @@ std::optional<std::shared_ptr<LoadedGLTF>> VkLoader::LoadGltfMeshes(VkEngine*
 				}
 			}
 
+			// Calculate the surface bounds from the vertices this primitive added
+			if (vertices.size() > initialVertex)
+			{
+				glm::vec3 minPos = vertices[initialVertex].position;
+				glm::vec3 maxPos = vertices[initialVertex].position;
+				for (size_t i = initialVertex; i < vertices.size(); i++)
+				{
+					minPos = glm::min(minPos, vertices[i].position);
+					maxPos = glm::max(maxPos, vertices[i].position);
+				}
+				newSurface.bounds.origin = (maxPos + minPos) / 2.f;
+				newSurface.bounds.extents = (maxPos - minPos) / 2.f;
+				newSurface.bounds.sphereRadius = glm::length(newSurface.bounds.extents);
+			}
+
 			newSurface.material = primitive.materialIndex.has_value() ?
 								  materials[primitive.materialIndex.value()] : materials[0];
+			if (colorsAttribute != primitive.attributes.end())
+			{
+				newSurface.material->features.vertexColors = true;
+			}
 			newMesh->surfaces.push_back(newSurface);
 		}
 
-		newMesh->meshBuffers = engine->UploadMesh(indices, vertices);
+		std::vector<glm::vec3> positions;
+		positions.reserve(vertices.size());
+		for (const Vertex& v : vertices)
+		{
+			positions.push_back(v.position);
+		}
+
+		// Keep a CPU copy of designated occluders for the software occlusion culler
+		if (IsOccluderName(mesh.name))
+		{
+			newMesh->occluderPositions = positions;
+			newMesh->occluderIndices = indices;
+		}
+
+		std::vector<GPUMeshlet> meshlets = BuildMeshlets(*newMesh, indices, positions, flipZAxis);
+		GenerateLods(*newMesh, indices, positions);
+
+		newMesh->meshBuffers = engine->UploadMesh(indices, vertices, meshlets);
+	}
+
+	// Every feature is known now, point the materials at their specialized pipelines
+	for (const auto& material : materials)
+	{
+		material->data.pipeline = engine->metalRoughMaterial.GetPermutation(
+			engine, vd.device, material->data.passType, material->features);
+		if (material->data.bindlessIndex != BindlessRegistry::INVALID_INDEX)
+		{
+			engine->bindless_.SetMaterialFeatures(material->data.bindlessIndex, material->features.Index());
+		}
 	}
 
 	// Load nodes
@@ -525,12 +602,100 @@ std::optional<AllocatedImage> VkLoader::LoadImage(VkEngine* engine, fastgltf::As
     return newImage.image != VK_NULL_HANDLE ? std::optional<AllocatedImage>{newImage} : std::nullopt;
 }
 
-void LoadedGLTF::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
+bool VkLoader::IsOccluderName(std::string_view name)
+{
+	// Meshes are tagged as occluders in the DCC tool by putting "occluder" anywhere in their name
+	constexpr std::string_view tag = "occluder";
+	auto it = std::search(name.begin(), name.end(), tag.begin(), tag.end(), [](char a, char b)
+	{
+		return std::tolower(static_cast<unsigned char>(a)) == b;
+	});
+	return it != name.end();
+}
+
+std::vector<GPUMeshlet> VkLoader::BuildMeshlets(MeshAsset& mesh, std::vector<u32>& indices,
+                                                std::span<const glm::vec3> positions, bool flippedWinding)
+{
+	std::vector<GPUMeshlet> gpuMeshlets;
+
+	for (GeoSurface& surface : mesh.surfaces)
+	{
+		// Backfacing clusters of double sided materials are still visible, keep their cones disabled
+		const bool coneCulling = !surface.material || !surface.material->doubleSided;
+
+		std::span<u32> surfaceIndices(indices.data() + surface.startIndex, surface.count);
+		std::vector<Meshlet> meshlets = MeshletBuilder::Build(positions, surfaceIndices, flippedWinding, coneCulling);
+
+		surface.firstMeshlet = static_cast<u32>(gpuMeshlets.size());
+		surface.meshletCount = static_cast<u32>(meshlets.size());
+		for (const Meshlet& meshlet : meshlets)
+		{
+			gpuMeshlets.push_back({
+				.sphere = glm::vec4(meshlet.center, meshlet.radius),
+				.cone = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff),
+				.firstIndex = surface.startIndex + meshlet.firstIndex,
+				.indexCount = meshlet.triangleCount * 3
+			});
+		}
+	}
+
+	return gpuMeshlets;
+}
+
+void VkLoader::GenerateLods(MeshAsset& mesh, std::vector<u32>& indices, std::span<const glm::vec3> positions)
+{
+	for (GeoSurface& surface : mesh.surfaces)
+	{
+		const f32 maxError = surface.bounds.sphereRadius * LOD_MAX_RELATIVE_ERROR;
+
+		// Each level halves the previous one, simplifying from it rather than from LOD 0 keeps import fast
+		std::vector<u32> source(indices.begin() + surface.startIndex,
+		                        indices.begin() + surface.startIndex + surface.count);
+		f32 accumulatedError = 0.f;
+
+		for (u32 level = 1; level < MAX_LOD_COUNT; level++)
+		{
+			const size_t target = source.size() / 2 / 3 * 3;
+			if (target < 3)
+			{
+				break;
+			}
+
+			f32 levelError = 0.f;
+			std::vector<u32> lod = MeshSimplifier::Simplify(positions, source, target,
+			                                                maxError - accumulatedError, &levelError);
+
+			// Stop once the simplifier hits locked borders or the error budget and stops making real progress
+			if (lod.empty() || lod.size() * 10 > source.size() * 9)
+			{
+				break;
+			}
+
+			accumulatedError += levelError;
+			surface.lods.push_back({
+				.startIndex = static_cast<u32>(indices.size()),
+				.count = static_cast<u32>(lod.size()),
+				.error = accumulatedError
+			});
+			indices.insert(indices.end(), lod.begin(), lod.end());
+			source = std::move(lod);
+		}
+	}
+}
+
+void LoadedGLTF::RegisterProxies(const glm::mat4& topMatrix, RenderProxies& proxies)
+{
+	for (auto& n : topNodes)
+	{
+		n->RegisterProxies(topMatrix, proxies);
+	}
+}
+
+void LoadedGLTF::UpdateProxies(const glm::mat4& topMatrix, RenderProxies& proxies)
 {
-	// create renderables from the scenenodes
 	for (auto& n : topNodes)
 	{
-		n->Draw(topMatrix, ctx);
+		n->UpdateProxies(topMatrix, glm::mat4{ 1.f }, proxies, false);
 	}
 }
 
@@ -541,10 +706,22 @@ void LoadedGLTF::ClearAll()
 	descriptorPool.DestroyPools(dv);
 	creator->DestroyBuffer(materialDataBuffer);
 
+	for (auto& [k, v] : materials)
+	{
+		if (v->data.bindlessIndex != BindlessRegistry::INVALID_INDEX)
+		{
+			creator->bindless_.ReleaseMaterial(v->data.bindlessIndex);
+		}
+	}
+
 	for (auto& [k, v] : meshes) {
 
 		creator->DestroyBuffer(v->meshBuffers.indexBuffer);
 		creator->DestroyBuffer(v->meshBuffers.vertexBuffer);
+		if (v->meshBuffers.meshletBuffer.buffer != VK_NULL_HANDLE)
+		{
+			creator->DestroyBuffer(v->meshBuffers.meshletBuffer);
+		}
 	}
 
 	for (auto& [k, v] : images) {
@@ -553,10 +730,11 @@ void LoadedGLTF::ClearAll()
 			//dont destroy the default images
 			continue;
 		}
-		VkImages::DestroyImage(v, vd.device, creator->allocator_);
+		creator->DestroyImage(v);
 	}
 
 	for (auto& sampler : samplers) {
+		creator->descriptorCache_.Invalidate(sampler);
 		vkDestroySampler(dv, sampler, nullptr);
 	}
 }
@@ -32,19 +32,62 @@ namespace GraphicsAPI::Vulkan
 	{
 		MaterialPipeline* pipeline{ nullptr };   // Pointer to the associated pipeline
 		VkDescriptorSet materialSet{ VK_NULL_HANDLE };   // Descriptor set for the material
+		std::vector<u8> descriptors;   // Descriptor buffer path: the same set written ahead of time, copied per frame
 		MaterialPass passType{};   // The type of material pass (MainColor, Transparent, etc.)
+
+		// Bindless path: pipeline reading the global material buffer and this instance's slot in it
+		MaterialPipeline* bindlessPipeline{ nullptr };
+		u32 bindlessIndex{ ~0u };
+	};
+
+	// Shader features a material actually needs, each one maps to a specialization constant of the mesh shaders.
+	// The defaults describe the generic pipeline that handles every material.
+	struct MaterialFeatures
+	{
+		bool textured = true;      // samples the base color texture
+		bool alphaTest = false;    // discards below the material's alpha cutoff
+		bool vertexColors = true;  // multiplies by the per vertex color
+
+		static constexpr u32 PERMUTATION_COUNT = 8;
+
+		[[nodiscard]] u32 Index() const
+		{
+			return (textured ? 1u : 0u) | (alphaTest ? 2u : 0u) | (vertexColors ? 4u : 0u);
+		}
 	};
 
 	struct GLTFMaterial
 	{
 		MaterialInstance data;
+		MaterialFeatures features;
+		bool doubleSided = false;
+	};
+
+
+	// Local space bounds of a surface, AABB as center + half extents plus an enclosing sphere
+	struct Bounds
+	{
+		glm::vec3 origin;
+		f32       sphereRadius;
+		glm::vec3 extents;
 	};
 
+	// Simplified index range of a surface, lives in the same index buffer as the full detail one
+	struct MeshLod
+	{
+		u32 startIndex;
+		u32 count;
+		f32 error; // object space deviation from the full detail surface
+	};
 
 	struct GeoSurface
 	{
 		u32 startIndex;
 		u32 count;
+		Bounds bounds;
+		std::vector<MeshLod> lods; // coarser levels after LOD 0 (startIndex/count), ordered by increasing error
+		u32 firstMeshlet;          // LOD 0 split into clusters, see MeshAsset::meshBuffers.meshletBuffer
+		u32 meshletCount;
 		std::shared_ptr<GLTFMaterial> material;
 	};
 
@@ -55,12 +98,16 @@ namespace GraphicsAPI::Vulkan
 
 		std::vector<GeoSurface> surfaces;
 		GPUMeshBuffers meshBuffers;
+
+		// CPU copy kept only for meshes designated as occluders (see VkLoader::IsOccluderName)
+		std::vector<glm::vec3> occluderPositions;
+		std::vector<u32>       occluderIndices;
 	};
 
 	// forward declaration
 	class VkEngine;
 
-	struct LoadedGLTF : IRenderable
+	struct LoadedGLTF
 	{
 		// storage for all the data on a given glTF file
 		std::unordered_map<std::string, std::shared_ptr<MeshAsset>> meshes;
@@ -78,9 +125,11 @@ namespace GraphicsAPI::Vulkan
 
 		VkEngine* creator;
 
-		~LoadedGLTF() override { ClearAll(); };
+		~LoadedGLTF() { ClearAll(); };
 
-		void Draw(const glm::mat4& topMatrix, DrawContext& ctx) override;
+		// Render proxies of every mesh node, see Node::UpdateProxies
+		void RegisterProxies(const glm::mat4& topMatrix, RenderProxies& proxies);
+		void UpdateProxies(const glm::mat4& topMatrix, RenderProxies& proxies);
 	private:
 		void ClearAll();
 	};
@@ -96,6 +145,18 @@ namespace GraphicsAPI::Vulkan
 		                                                                 const std::filesystem::path& filePath,
 		                                                                 bool flipZAxis = true);
 		static std::optional<AllocatedImage> LoadImage(VkEngine* engine, fastgltf::Asset& asset, fastgltf::Image& image);
+		static bool IsOccluderName(std::string_view name);
+
+		// Appends a chain of simplified index ranges for every surface of the mesh to indices
+		static void GenerateLods(MeshAsset& mesh, std::vector<u32>& indices, std::span<const glm::vec3> positions);
+
+		// Reorders every surface's LOD 0 range into meshlets for GPU cluster culling
+		static std::vector<GPUMeshlet> BuildMeshlets(MeshAsset& mesh, std::vector<u32>& indices,
+		                                             std::span<const glm::vec3> positions, bool flippedWinding);
+
+		static constexpr u32 MAX_LOD_COUNT = 4;
+		// LODs may deviate at most this fraction of the surface's bounding sphere radius
+		static constexpr f32 LOD_MAX_RELATIVE_ERROR = 0.25f;
 	};
 } // namespace GraphicsAPI::Vulkan
 #endif
\ No newline at end of file
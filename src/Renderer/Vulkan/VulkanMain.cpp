@@ -4,6 +4,8 @@
 #ifdef VULKAN_BUILD
 #include "VulkanMain.h"
 
+#include <bit>
+#include <fstream>
 #include <VkBootstrap.h>
 #include <vk_mem_alloc.h>
 #include <backends/imgui_impl_win32.h>
@@ -12,6 +14,7 @@
 #include "../../Core/Timer.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/transform.hpp>
 
@@ -30,6 +33,14 @@ VkEngine::VkEngine(Platform::WindowContext *winManager, const std::wstring& rend
 	windowContext_->appName += renderName;
 }
 
+VkEngine::VkEngine(const HeadlessOptions& options) :
+	allocator_(nullptr), swapchainImageFormat_(), stats(), windowContext_(nullptr), camera_(),
+	frames_{}, meshPipelineLayout_(nullptr), meshPipeline_(nullptr)
+{
+	headless_ = true;
+	headlessOptions_ = options;
+}
+
 VkEngine::~VkEngine()
 {
 	Cleanup();
@@ -42,6 +53,8 @@ void VkEngine::Run()
 	MSG msg = {};
 	bool bQuit = false;
 
+	renderThread_ = std::thread(&VkEngine::RenderThreadMain, this);
+
 	while (!bQuit)
 	{
 		// Get delta time for the current frame
@@ -67,13 +80,6 @@ void VkEngine::Run()
 			break;
 		}
 
-		// Handle resizing if requested
-		if (resizeRequested_)
-		{
-			ResizeSwapchain();
-			resizeRequested_ = false; // Reset the flag after resizing
-		}
-
 		// Avoid drawing if the window is minimized
 		if (stopRendering_)
 		{
@@ -109,25 +115,175 @@ void VkEngine::Run()
 			input.mouseLookActive = true;
 		}
 
-		// Start ImGui new frame
+		// Simulate into a free packet while the render thread records the previous one
+		RenderPacket& packet = AcquireRenderPacket();
+		UpdateScene(packet);
+
+		// The UI shows the newest stats Draw published, copied out so recording never waits on it
+		{
+			std::lock_guard lock(renderStateMutex_);
+			uiStats_ = publishedStats_;
+		}
+		sceneResolution_ = GetScreenResolution();
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplWin32_NewFrame();
 		ImGui::NewFrame();
 		RenderUI();
 		ImGui::Render();
+		packet.CaptureUI(ImGui::GetDrawData());
+		// Edits made this frame take effect with the next packet
 
-		// Draw the scene
-		UpdateScene();
-
-		// Draw the frame
-		Draw();
+		// Hand the frame to the render thread
+		SubmitRenderPacket();
 	}
 
 	// Clean up after exiting the main loop
+	StopRenderThread();
 	Cleanup();
 	PostQuitMessage(0);
 }
 
+bool VkEngine::RunHeadless()
+{
+	if (!isInit || !headless_)
+	{
+		LOG(ERR, "RunHeadless needs an engine initialized with HeadlessOptions");
+		return false;
+	}
+
+	const bool readback = !headlessOptions_.readbackPath.empty();
+	if (readback)
+	{
+		// RGBA16F, sized for the whole draw image
+		readbackBuffer_ = CreateBuffer(static_cast<size_t>(drawImage_.imageExtent.width) * drawImage_.imageExtent.height * 8,
+		                               VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+	}
+
+	// Fixed steps so every run animates the same frames
+	deltaTime = 1.f / 60.f;
+	std::vector<f32> frameTimes;
+	frameTimes.reserve(headlessOptions_.frames);
+
+	LOG(INFO, "Rendering ", headlessOptions_.frames, " headless frames at ", headlessOptions_.width, "x",
+	    headlessOptions_.height);
+	// No render thread, simulation and recording take turns so the timings stay comparable between runs
+	RenderPacket packet;
+	for (u32 i = 0; i < headlessOptions_.frames; i++)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		packet.readback = readback && i + 1 == headlessOptions_.frames;
+
+		UpdateScene(packet);
+		Draw(packet);
+
+		frameTimes.push_back(std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+	vkDeviceWaitIdle(vd.device);
+
+	if (!frameTimes.empty())
+	{
+		f32 sum = 0.f;
+		for (const f32 time : frameTimes)
+		{
+			sum += time;
+		}
+		std::ranges::sort(frameTimes);
+		auto percentile = [&](f32 p) { return frameTimes[static_cast<size_t>(p * static_cast<f32>(frameTimes.size() - 1))]; };
+
+		stats.frametime = sum / static_cast<f32>(frameTimes.size());
+		LOG(INFO, "CPU frame time: avg ", stats.frametime, " ms, p50 ", percentile(0.5f), " ms, p95 ",
+		    percentile(0.95f), " ms, p99 ", percentile(0.99f), " ms, max ", frameTimes.back(), " ms");
+	}
+
+	if (!headlessOptions_.timingsPath.empty())
+	{
+		gpuProfiler_.WriteJson(headlessOptions_.timingsPath);
+	}
+
+	bool succeeded = true;
+	if (readback)
+	{
+		succeeded = WriteReadback(headlessOptions_.readbackPath);
+		DestroyBuffer(readbackBuffer_);
+		readbackBuffer_ = {};
+	}
+	return succeeded;
+}
+
+MaterialWriteBenchmark VkEngine::BenchmarkMaterialWrites(u32 materialCount, u32 runs)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	MaterialWriteBenchmark result{ .materials = materialCount, .runs = runs };
+	if (materialCount == 0 || runs == 0)
+	{
+		return result;
+	}
+
+	// The loader's layout and pool ratios, every material with its own constants and the default textures
+	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes =
+	{
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 }
+	};
+	DescriptorAllocatorGrowable allocator;
+	allocator.Init(vd.device, materialCount, sizes);
+	std::vector<VkDescriptorSet> sets(materialCount);
+	for (VkDescriptorSet& set : sets)
+	{
+		set = allocator.Allocate(vd.device, metalRoughMaterial.materialLayout);
+	}
+	const AllocatedBuffer constants = CreateBuffer(materialCount * sizeof(GLTFMetallicRoughness::MaterialConstants),
+	                                               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+	VkDescriptorWriter writer;
+	auto record = [&](u32 i)
+	{
+		writer.WriteBuffer(0, constants.buffer, sizeof(GLTFMetallicRoughness::MaterialConstants),
+		                   i * sizeof(GLTFMetallicRoughness::MaterialConstants), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		writer.WriteImage(1, whiteImage_.imageView, defaultSamplerLinear_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		writer.WriteImage(2, errorCheckerboardImage_.imageView, defaultSamplerLinear_,
+		                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	};
+
+	// Nothing uses the sets, so both ways can rewrite the same ones
+	Clock::duration perSetTime{}, batchedTime{}, flushTime{};
+	for (u32 run = 0; run < runs; run++)
+	{
+		Clock::time_point start = Clock::now();
+		for (u32 i = 0; i < materialCount; i++)
+		{
+			writer.Clear();
+			record(i);
+			writer.UpdateSet(vd.device, sets[i]);
+		}
+		perSetTime += Clock::now() - start;
+
+		start = Clock::now();
+		writer.Clear();
+		writer.Reserve(materialCount * 3, materialCount * 2, materialCount);
+		for (u32 i = 0; i < materialCount; i++)
+		{
+			record(i);
+			writer.QueueSet(sets[i]);
+		}
+		const Clock::time_point flushStart = Clock::now();
+		writer.Flush(vd.device);
+		const Clock::time_point end = Clock::now();
+		batchedTime += end - start;
+		flushTime += end - flushStart;
+	}
+
+	DestroyBuffer(constants);
+	allocator.DestroyPools(vd.device);
+
+	const f64 perRun = 1.0 / static_cast<f64>(runs);
+	result.perSetMs = std::chrono::duration<f64, std::milli>(perSetTime).count() * perRun;
+	result.batchedMs = std::chrono::duration<f64, std::milli>(batchedTime).count() * perRun;
+	result.flushMs = std::chrono::duration<f64, std::milli>(flushTime).count() * perRun;
+	return result;
+}
+
 void VkEngine::ResizeSwapchain()
 {
 	if (swapchainExtent_.width == 0 || swapchainExtent_.height == 0)
@@ -142,10 +298,103 @@ void VkEngine::ResizeSwapchain()
 	// windowContext_->GetWindowSize(swapchainExtent_.width, swapchainExtent_.height);
 
 	CreateSwapchain(swapchainExtent_.width, swapchainExtent_.height);
+	// New swapchain images, possibly reusing old handles
+	renderGraph_.ResetHistory();
 
 	resizeRequested_ = false;
 }
 
+void VkEngine::RenderThreadMain()
+{
+	while (true)
+	{
+		{
+			std::unique_lock lock(renderQueueMutex_);
+			renderQueueCondition_.wait(lock, [this] { return renderThreadQuit_ || packetsCompleted_ < packetsSubmitted_; });
+			if (packetsCompleted_ == packetsSubmitted_)
+			{
+				return; // quitting, and every submitted packet was drawn
+			}
+		}
+
+		// Only this thread advances packetsCompleted_, the main thread leaves the packet alone until it does
+		RenderPacket& packet = renderPackets_[packetsCompleted_ % RENDER_QUEUE_DEPTH];
+
+		// The swapchain is only touched on this thread
+		if (resizeRequested_)
+		{
+			ResizeSwapchain();
+		}
+		if (!stopRendering_)
+		{
+			Draw(packet);
+		}
+		packet.ReleaseUI();
+
+		{
+			std::lock_guard lock(renderQueueMutex_);
+			packetsCompleted_++;
+		}
+		renderQueueCondition_.notify_all();
+	}
+}
+
+RenderPacket& VkEngine::AcquireRenderPacket()
+{
+	std::unique_lock lock(renderQueueMutex_);
+	renderQueueCondition_.wait(lock, [this] { return packetsSubmitted_ - packetsCompleted_ < RENDER_QUEUE_DEPTH; });
+	return renderPackets_[packetsSubmitted_ % RENDER_QUEUE_DEPTH];
+}
+
+void VkEngine::SubmitRenderPacket()
+{
+	{
+		std::lock_guard lock(renderQueueMutex_);
+		packetsSubmitted_++;
+	}
+	renderQueueCondition_.notify_all();
+}
+
+void VkEngine::StopRenderThread()
+{
+	if (!renderThread_.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard lock(renderQueueMutex_);
+		renderThreadQuit_ = true;
+	}
+	renderQueueCondition_.notify_all();
+	renderThread_.join();
+}
+
+void RenderPacket::CaptureUI(const ImDrawData* drawData)
+{
+	ReleaseUI();
+	if (!drawData || !drawData->Valid)
+	{
+		return;
+	}
+
+	// Display size, scale and counts are copied as they are, the lists are cloned
+	uiDrawData = *drawData;
+	for (ImDrawList*& list : uiDrawData.CmdLists)
+	{
+		list = list->CloneOutput();
+	}
+}
+
+void RenderPacket::ReleaseUI()
+{
+	for (ImDrawList* list : uiDrawData.CmdLists)
+	{
+		IM_DELETE(list);
+	}
+	uiDrawData.Clear();
+}
+
 #pragma endregion Run
 
 #pragma region UI
@@ -153,13 +402,156 @@ void VkEngine::ResizeSwapchain()
 void VkEngine::RenderQuickStatsImGui()
 {
     ImGui::Text("Window Resolution: %ux%u", windowContext_->screenWidth, windowContext_->screenHeight);
-    ImGui::Text("Render Resolution: %ux%u", drawExtent_.width, drawExtent_.height);
+    ImGui::Text("Render Resolution: %ux%u", uiStats_.drawExtent.width, uiStats_.drawExtent.height);
     ImGui::Text("FPS: %.2f", displayedFPS);
+	const EngineStats& frameStats = uiStats_.stats;
+	ImGui::Text("CPU wait on GPU: %.3f ms (%u frames in flight)", frameStats.cpuWaitTime, uiStats_.framesInFlight);
+
+	// Next to the frame time so batching regressions show up right away
+	const GpuProfiler::PassCounters& frameCounters = uiStats_.frameCounters;
+	ImGui::Text("Draws: %d (%u indirect), Triangles: %d (%d saved by LODs)", frameStats.drawcallCount,
+	            frameCounters.indirectDraws, frameStats.triCout, frameStats.lodTrisSaved);
+	ImGui::Text("Binds: %u pipelines, %u descriptor sets, %u index buffers, %u push constant bytes",
+	            frameCounters.pipelineBinds, frameCounters.descriptorBinds, frameCounters.indexBufferBinds,
+	            frameCounters.pushConstantBytes);
 
     for (const auto& [functionName, elapsedMillis] : timingResults)
     {
         ImGui::Text("%s: %.3f ms", functionName.c_str(), elapsedMillis);
     }
+    for (const auto& [functionName, elapsedMillis] : uiStats_.timings)
+    {
+        ImGui::Text("%s (render thread): %.3f ms", functionName.c_str(), elapsedMillis);
+    }
+
+	ImGui::Separator();
+	if (uiStats_.gpuProfilerEnabled)
+	{
+		ImGui::Text("GPU Frame: %.3f ms, Geometry: %.3f ms, Update Scene (CPU): %.3f ms", frameStats.gpuFrametime,
+		            frameStats.meshDrawtime, sceneUpdateMs_);
+	}
+	if (ImGui::BeginTable("GPU Timings", 9, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("Avg ms");
+		ImGui::TableSetupColumn("p50");
+		ImGui::TableSetupColumn("p95");
+		ImGui::TableSetupColumn("p99");
+		ImGui::TableSetupColumn("Draws");
+		ImGui::TableSetupColumn("Pipelines");
+		ImGui::TableSetupColumn("Sets");
+		ImGui::TableSetupColumn("Push B");
+		ImGui::TableHeadersRow();
+		for (const GpuProfiler::ScopeStats& scope : uiStats_.gpuScopes)
+		{
+			const GpuProfiler::PassCounters& c = scope.counters;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(scope.name.c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.avgMs);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.p50Ms);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.p95Ms);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.p99Ms);
+			ImGui::TableNextColumn(); ImGui::Text("%u", c.draws + c.indirectDraws + c.dispatches);
+			ImGui::TableNextColumn(); ImGui::Text("%u", c.pipelineBinds);
+			ImGui::TableNextColumn(); ImGui::Text("%u", c.descriptorBinds);
+			ImGui::TableNextColumn(); ImGui::Text("%u", c.pushConstantBytes);
+		}
+		ImGui::EndTable();
+	}
+
+	if (uiStats_.pipelineStatisticsSupported)
+	{
+		ImGui::Checkbox("Pipeline Statistics", &uiSettings_.pipelineStatistics);
+	}
+	if (uiSettings_.pipelineStatistics &&
+	    ImGui::BeginTable("Pipeline Statistics", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Pass");
+		ImGui::TableSetupColumn("Vertices");
+		ImGui::TableSetupColumn("VS Invocations");
+		ImGui::TableSetupColumn("Clipped In / Out");
+		ImGui::TableSetupColumn("FS Invocations");
+		ImGui::TableSetupColumn("CS Invocations");
+		ImGui::TableHeadersRow();
+		for (const GpuProfiler::ScopeStats& scope : uiStats_.gpuScopes)
+		{
+			if (!scope.hasStatistics)
+			{
+				continue;
+			}
+			const GpuProfiler::PipelineStatistics& p = scope.statistics;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(scope.name.c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%llu", p.inputVertices);
+			ImGui::TableNextColumn(); ImGui::Text("%llu", p.vertexInvocations);
+			ImGui::TableNextColumn(); ImGui::Text("%llu / %llu", p.clippingInvocations, p.clippingPrimitives);
+			ImGui::TableNextColumn(); ImGui::Text("%llu", p.fragmentInvocations);
+			ImGui::TableNextColumn(); ImGui::Text("%llu", p.computeInvocations);
+		}
+		ImGui::EndTable();
+	}
+
+	if (ImGui::Button("Dump GPU Timings"))
+	{
+		uiSettings_.dumpGpuTimings = true; // the profiler belongs to the render thread
+	}
+	ImGui::Separator();
+
+	ImGui::Text("Pipelines: %u (%u reused, %u compiling)", pipelineRegistry_.PipelineCount(), pipelineRegistry_.Hits(),
+	            pipelineRegistry_.PendingCount());
+	ImGui::Text("Render graph: %u passes (%u culled), %u barriers in %u batches", uiStats_.graphPasses,
+	            uiStats_.graphCulled, uiStats_.graphBarriers, uiStats_.graphBarrierBatches);
+	ImGui::Text("Material permutations: %u", uiStats_.materialPermutations);
+	ImGui::Text("Descriptor cache: %u sets, %u hits, %u misses", uiStats_.descriptorCacheSize,
+	            uiStats_.descriptorCacheHits, uiStats_.descriptorCacheMisses);
+	if (useDescriptorBuffers_)
+	{
+		ImGui::Text("Descriptor buffer: %llu / %llu bytes", uiStats_.descriptorBufferUsed,
+		            uiStats_.descriptorBufferCapacity);
+	}
+	else
+	{
+		ImGui::Text("Descriptor buffer: unsupported, using pools");
+	}
+
+	if (uiStats_.bindless)
+	{
+		ImGui::Text("Bindless: %u materials, %u textures", uiStats_.bindlessMaterials, uiStats_.bindlessTextures);
+	}
+
+	ImGui::Text("Geometry recorded in %u command buffer%s", uiStats_.geometrySlices,
+	            uiStats_.geometrySlices > 1 ? "s" : "");
+
+	ImGui::Text("Render proxies: %u (%u written last frame)", renderProxies_.Count(), renderProxies_.PublishedWrites());
+	if (uiSettings_.retainedStaticDraws)
+	{
+		ImGui::Text("Static draw list: %u surfaces in %u cells (%u culled), %zu dynamic, %u rebuilds",
+		            uiStats_.staticSurfaces, uiStats_.staticCells, uiStats_.staticCulledCells, uiStats_.staticDynamic,
+		            uiStats_.staticRebuilds);
+	}
+	ImGui::Text("Simulation: %.0f Hz, %u steps this frame, %llu steps dropped", simulationClock_.Rate(),
+	            simulationClock_.LastSteps(), simulationClock_.DroppedSteps());
+
+	if (uiSettings_.meshletCulling)
+	{
+		ImGui::Text("Cluster Culled Draws: %u (%u meshlets)", uiStats_.clusterDraws, uiStats_.clusterMeshlets);
+	}
+
+	if (uiSettings_.frustumCulling)
+	{
+		const FrustumCullCache::Stats& frustumStats = uiStats_.frustum;
+		ImGui::Text("Frustum: %u static tested, %u reused, %u dynamic, %u culled", frustumStats.staticTested,
+		            frustumStats.staticReused, frustumStats.dynamicTested, frustumStats.culled);
+	}
+
+	if (uiSettings_.occlusionCulling)
+	{
+		const OcclusionCuller::Stats& occlusionStats = uiStats_.occlusion;
+		ImGui::Separator();
+		ImGui::Text("Occluders: %u (%u tris)", occlusionStats.occluders, occlusionStats.occluderTriangles);
+		ImGui::Text("Occlusion Raster: %.3f ms", occlusionStats.rasterizeMs);
+		ImGui::Text("Occlusion Culled: %u / %u", occlusionStats.culled, occlusionStats.tested);
+	}
 }
 
 void VkEngine::RenderMemoryUsageImGui()
@@ -176,33 +568,98 @@ void VkEngine::RenderMemoryUsageImGui()
     ImGui::Text("Free VRAM: %.2f MB", freeMB);
     ImGui::Text("Total VRAM: %.2f MB", totalMB);
 
+    ImGui::Text("Transient Peak: %.2f MB (%.2f MB without aliasing)",
+                static_cast<float>(uiStats_.transientPeakBytes) / (1024.0f * 1024.0f),
+                static_cast<float>(uiStats_.transientNaiveBytes) / (1024.0f * 1024.0f));
+
     std::string usageText = std::to_string(static_cast<int>(vramUsage.usagePercentage)) + "% Used";
     ImGui::ProgressBar(vramUsage.usagePercentage / 100.0f, ImVec2(0.0f, 0.0f), usageText.c_str());
 }
 
 void VkEngine::RenderSettingsImGui()
 {
-    // Render scale slider
-    ImGui::SliderFloat("Render Scale", &renderScale, 0.3f, 1.0f);
-	if (ImGui::BeginPopupContextItem("Render Scale Options"))
+	// Render scale, picked from the GPU frame time while dynamic resolution is on
+	RenderSettings& settings = uiSettings_;
+	ImGui::Checkbox("Dynamic Resolution", &settings.dynamicResolution);
+	if (settings.dynamicResolution)
+	{
+		// Turning it off keeps the scale it picked last
+		settings.renderScale = uiStats_.renderScale;
+		ImGui::Text("Render Scale: %.2f (GPU %.2f / %.2f ms)", uiStats_.renderScale, uiStats_.dynamicResolutionGpuMs,
+		            uiStats_.dynamicResolutionBudgetMs);
+		ImGui::SliderFloat("Target Hz", &settings.targetHz, 30.f, 240.f, "%.0f");
+		ImGui::SliderFloat("Min Scale", &settings.minScale, 0.3f, settings.maxScale);
+		ImGui::SliderFloat("Max Scale", &settings.maxScale, settings.minScale, 1.0f);
+	}
+	else
+	{
+		ImGui::SliderFloat("Render Scale", &settings.renderScale, 0.3f, 1.0f);
+		if (ImGui::BeginPopupContextItem("Render Scale Options"))
+		{
+			if (ImGui::MenuItem("Reset to Default")) settings.renderScale = 1.0f;
+			ImGui::EndPopup();
+		}
+	}
+	ImGui::Checkbox("Compute Upscaler", &settings.computeUpscale);
+	if (settings.computeUpscale)
 	{
-		if (ImGui::MenuItem("Reset to Default")) renderScale = 1.0f;
-		ImGui::EndPopup();
+		ImGui::SliderFloat("Sharpness", &settings.upscaleSharpness, 0.0f, 1.0f);
 	}
 
     // Background effect settings
     ImGui::Separator();
-    ComputeEffect& selected = backgroundEffects[currentBackgroundEffect_];
+    const ComputeEffect& selected = backgroundEffects[settings.backgroundEffect];
     ImGui::Text("Selected effect: %s", selected.name);
-    ImGui::SliderInt("Effect Index", &currentBackgroundEffect_, 0, static_cast<int>(backgroundEffects.size()) - 1);
+    ImGui::SliderInt("Effect Index", &settings.backgroundEffect, 0, static_cast<int>(backgroundEffects.size()) - 1);
 
     // Camera settings
     ImGui::Separator();
     ImGui::Text("Camera Settings");
     ImGui::SliderFloat3("Position", glm::value_ptr(camera_.position), -100.0f, 100.0f);
     ImGui::SliderFloat("FOV", &fov, 1.0f, 180.0f);
-    ImGui::SliderFloat("Near Plane", &nearPlane, 0.01f, 1.0f, "%.2f");
+    ImGui::SliderFloat("Near Plane", &settings.nearPlane, 0.01f, 1.0f, "%.2f");
     ImGui::SliderFloat("Far Plane", &farPlane, 10.0f, 1000.0f, "%.2f");
+
+	// Culling settings
+	ImGui::Separator();
+	ImGui::Text("Culling");
+	ImGui::Checkbox("CPU Frustum Culling", &settings.frustumCulling);
+	ImGui::Checkbox("Temporal Frustum Cache", &settings.temporalFrustumCache);
+	ImGui::Checkbox("CPU Occlusion Culling", &settings.occlusionCulling);
+	if (meshletCullingSupported_)
+	{
+		ImGui::Checkbox("GPU Meshlet Culling", &settings.meshletCulling);
+	}
+	ImGui::Checkbox("Parallel Geometry Recording", &settings.parallelRecording);
+	ImGui::Checkbox("Retained Static Draw List", &settings.retainedStaticDraws);
+	if (meshletCullingSupported_)
+	{
+		ImGui::Checkbox("Meshlet Backface Cones", &settings.meshletConeCulling);
+	}
+
+	// Material settings
+	ImGui::Separator();
+	ImGui::Text("Materials");
+	if (bindlessSupported_)
+	{
+		ImGui::Checkbox("Bindless Materials", &settings.bindless);
+	}
+	else
+	{
+		ImGui::Text("Bindless materials: unsupported");
+	}
+
+	// Frame pacing settings
+	ImGui::Separator();
+	ImGui::Text("Frame Pacing");
+	ImGui::SliderInt("Frames In Flight", &settings.framesInFlight, 1, static_cast<int>(MAX_FRAMES_IN_FLIGHT));
+	ImGui::SliderInt("Simulation Rate (Hz)", &simulationRate_, 10, 240);
+
+	// Level of detail settings
+	ImGui::Separator();
+	ImGui::Text("Level of Detail");
+	ImGui::Checkbox("Mesh LODs", &lodEnabled);
+	ImGui::SliderFloat("LOD Bias (px)", &lodBias, 0.25f, 8.0f, "%.2f");
 }
 
 void VkEngine::RenderMainMenu() const
@@ -271,9 +728,16 @@ void VkEngine::RenderUI()
 
 bool VkEngine::Init()
 {
-	if (windowContext_)
+	if (windowContext_ || headless_)
 	{
+		jobSystem_.Init();
+		occlusionCuller_.Init();
+
 		InitVulkan();
+		if (vd.device == VK_NULL_HANDLE)
+		{
+			return false;
+		}
 		// SetupDebugMessenger();
 		InitSwapchain();
 		InitCommands();
@@ -281,17 +745,24 @@ bool VkEngine::Init()
 		InitDescriptors();
 		InitPipelines();
 		InitDefaultData();
-		InitImgui();
+		if (!headless_)
+		{
+			InitImgui();
+		}
 
 		// Load the GLTF scene
-		auto structureFile = VkLoader::LoadGltfMeshes(this, "Models\\structure.glb");
+		auto structureFile = VkLoader::LoadGltfMeshes(this, "Models/structure.glb");
 		assert(structureFile.has_value());
 		loadedScenes["structure"] = *structureFile;
+		loadedScenes["structure"]->RegisterProxies(glm::mat4{ 1.f }, renderProxies_);
+		renderProxies_.Publish();
 		camera_.velocity = glm::vec3(0.f);
 		camera_.position = glm::vec3(30.f, -00.f, -085.f);
 
 		camera_.pitch = 0;
 		camera_.yaw = 0;
+		previousCameraPosition_ = camera_.position;
+		sceneResolution_ = GetScreenResolution();
 		isInit = true;
 		return true;
 	}
@@ -307,6 +778,7 @@ void VkEngine::InitVulkan()
 	                      .request_validation_layers(bUseValidationLayers)
 	                      .require_api_version(1, 3)
 	                      .use_default_debug_messenger()
+	                      .set_headless(headless_)
 	                      .build();
 
 	if (!instRet)
@@ -318,7 +790,10 @@ void VkEngine::InitVulkan()
 	vd.instance = instRet.value().instance;
 	vd.dbgMessenger = instRet.value().debug_messenger;
 
-	CreateSurfaceWin32(windowContext_->hInstance, windowContext_->hwnd, vd);
+	if (!headless_)
+	{
+		CreateSurfaceWin32(windowContext_->hInstance, windowContext_->hwnd, vd);
+	}
 
 	//vulkan 1.3 features
 	VkPhysicalDeviceVulkan13Features features13{};
@@ -329,10 +804,15 @@ void VkEngine::InitVulkan()
 	VkPhysicalDeviceVulkan12Features features12{};
 	features12.bufferDeviceAddress = true;
 	features12.descriptorIndexing = true;
+	features12.timelineSemaphore = true; // frame pacing
 
+	// Without a surface any device with a graphics queue will do, software rasterizers included
 	vkb::PhysicalDeviceSelector selector{instRet.value()};
-	auto physDeviceRet = selector.set_surface(vd.surface)
-	                             .set_minimum_version(1, 3)
+	if (!headless_)
+	{
+		selector.set_surface(vd.surface);
+	}
+	auto physDeviceRet = selector.set_minimum_version(1, 3)
 	                             .set_required_features_13(features13)
 	                             .set_required_features_12(features12)
 	                             .prefer_gpu_device_type(vkb::PreferredDeviceType::discrete)
@@ -342,16 +822,65 @@ void VkEngine::InitVulkan()
 		LOG(ERR, "Failed to select a Vulkan physical device. Error: " + physDeviceRet.error().message());
 		return;
 	}
-	vd.physicalDevice = physDeviceRet.value().physical_device;
+	vkb::PhysicalDevice& physicalDevice = physDeviceRet.value();
+	vd.physicalDevice = physicalDevice.physical_device;
+
+	// Optional, per frame descriptors fall back to pools without it
+	VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures
+	{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT,
+		.descriptorBuffer = VK_TRUE
+	};
+	const bool descriptorBufferAvailable =
+		physicalDevice.enable_extension_if_present(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) &&
+		physicalDevice.enable_extension_features_if_present(descriptorBufferFeatures);
+
+	// Optional, only the profiler's pipeline statistics need it
+	VkPhysicalDeviceFeatures statisticsFeatures{};
+	statisticsFeatures.pipelineStatisticsQuery = true;
+	pipelineStatisticsSupported_ = physicalDevice.enable_features_if_present(statisticsFeatures);
+	// Lets parallel geometry recording keep running under the Geometry pass's statistics query
+	VkPhysicalDeviceFeatures inheritedQueryFeatures{};
+	inheritedQueryFeatures.inheritedQueries = true;
+	inheritedQueriesSupported_ = pipelineStatisticsSupported_ &&
+	                             physicalDevice.enable_features_if_present(inheritedQueryFeatures);
+
+	// Optional, the bindless material path falls back to per material sets without it
+	VkPhysicalDeviceVulkan12Features bindlessFeatures
+	{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+		.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+		.descriptorBindingPartiallyBound = VK_TRUE,
+		.runtimeDescriptorArray = VK_TRUE
+	};
+	bindlessSupported_ = physicalDevice.enable_extension_features_if_present(bindlessFeatures);
+
+	// Optional, GPU cluster culling writes its own draw counts, without it surfaces are drawn whole
+	VkPhysicalDeviceFeatures multiDrawFeatures{};
+	multiDrawFeatures.multiDrawIndirect = true;
+	VkPhysicalDeviceVulkan12Features indirectCountFeatures
+	{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.drawIndirectCount = VK_TRUE
+	};
+	meshletCullingSupported_ = physicalDevice.enable_features_if_present(multiDrawFeatures) &&
+	                           physicalDevice.enable_extension_features_if_present(indirectCountFeatures);
+	if (!bindlessSupported_ || !meshletCullingSupported_)
+	{
+		LOG(WARN, "Missing device features, bindless materials ", bindlessSupported_ ? "on" : "off",
+		    ", GPU meshlet culling ", meshletCullingSupported_ ? "on" : "off");
+	}
+	uiSettings_.bindless = uiSettings_.bindless && bindlessSupported_;
+	uiSettings_.meshletCulling = uiSettings_.meshletCulling && meshletCullingSupported_;
 
-	VkPhysicalDeviceProperties deviceProperties;
 	vkGetPhysicalDeviceProperties(vd.physicalDevice, &deviceProperties);
 	gpuName = deviceProperties.deviceName;
 
 	LOG(INFO, "Selected GPU: " + std::string(gpuName));
 	LOG(INFO, "Driver Version: " + decodeDriverVersion(deviceProperties.driverVersion, deviceProperties.vendorID));
 
-	vkb::DeviceBuilder deviceBuilder{physDeviceRet.value()};
+	vkb::DeviceBuilder deviceBuilder{physicalDevice};
 	auto devRet = deviceBuilder.build();
 	if (!devRet)
 	{
@@ -360,6 +889,9 @@ void VkEngine::InitVulkan()
 	}
 	vd.device = devRet.value().device;
 
+	useDescriptorBuffers_ = descriptorBufferAvailable && DescriptorBufferAllocator::LoadDevice(vd.device, vd.physicalDevice);
+	LOG(INFO, useDescriptorBuffers_ ? "Using descriptor buffers for per frame descriptors" : "Using descriptor pools for per frame descriptors");
+
 	VmaAllocatorCreateInfo allocInfo
 	{
 		.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
@@ -557,7 +1089,17 @@ void VkEngine::InitDescriptors()
 	{
 		DescriptorLayoutBuilder builder;
 		builder.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		drawImageDescriptorLayout_ = builder.Build(vd.device, VK_SHADER_STAGE_COMPUTE_BIT);
+		drawImageDescriptorLayout_ = builder.Build(vd.device, VK_SHADER_STAGE_COMPUTE_BIT, nullptr,
+		                                           useDescriptorBuffers_ ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0);
+	}
+
+	// Upscaler source and target, written every frame like the background's set
+	{
+		DescriptorLayoutBuilder builder;
+		builder.AddBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		builder.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		upscaleDescriptorLayout_ = builder.Build(vd.device, VK_SHADER_STAGE_COMPUTE_BIT, nullptr,
+		                                         useDescriptorBuffers_ ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0);
 	}
 
 	// Single-Image sampler layout for the mesh draw
@@ -567,20 +1109,28 @@ void VkEngine::InitDescriptors()
 		singleImageDescriptorLayout_ = builder.Build(vd.device, VK_SHADER_STAGE_FRAGMENT_BIT);
 	}
 
-
-	//allocate a descriptor set for our draw image
-	drawImageDescriptors_ = globalDescriptorAllocator.Allocate(vd.device, drawImageDescriptorLayout_);
-
-	VkDescriptorWriter writer;
-	writer.WriteImage(0, drawImage_.imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-	writer.UpdateSet(vd.device, drawImageDescriptors_);
-
 	// Create a descriptor set layout with a single uniform buffer binding
 	{
 		DescriptorLayoutBuilder builder;
 		builder.AddBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
 		gpuSceneDataDescriptorLayout_ = builder.Build(vd.device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+		// The material pipelines take it from the frame's descriptor buffer, bindless ones keep the set above
+		if (useDescriptorBuffers_)
+		{
+			gpuSceneDataBufferLayout_ = builder.Build(vd.device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			                                          nullptr, VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+		}
+	}
+
+	// Global texture array + material buffer for the bindless draw path, left invalid without device support
+	if (bindlessSupported_)
+	{
+		bindless_.Init(this, vd.device);
 	}
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		bindless_.Cleanup(vd.device);
+	}, "Bindless Registry");
 
 	mainDeletionQueue_.pushFunction([device = vd.device, layout = drawImageDescriptorLayout_]() {
 	vkDestroyDescriptorSetLayout(device, layout, nullptr);
@@ -590,10 +1140,18 @@ void VkEngine::InitDescriptors()
 		vkDestroyDescriptorSetLayout(device, layout, nullptr);
 	}, "Single Image Descriptor Set Layout");
 
+	mainDeletionQueue_.pushFunction([device = vd.device, layout = upscaleDescriptorLayout_]() {
+		vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	}, "Upscale Descriptor Set Layout");
+
 	mainDeletionQueue_.pushFunction([device = vd.device, layout = gpuSceneDataDescriptorLayout_]() {
 		vkDestroyDescriptorSetLayout(device, layout, nullptr);
 	}, "GPU Scene Data Descriptor Set Layout");
 
+	mainDeletionQueue_.pushFunction([device = vd.device, layout = gpuSceneDataBufferLayout_]() {
+		vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	}, "GPU Scene Data Descriptor Buffer Layout");
+
 	for (auto & frame : frames_) {
 		// create a descriptor pool
 		std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> frameSizes
@@ -610,8 +1168,35 @@ void VkEngine::InitDescriptors()
 		mainDeletionQueue_.pushFunction([&frame, device = vd.device]() {
 		   frame.frameDescriptors_.DestroyPools(device);
 	   }, "Frame Descriptor Pools");
+
+		if (useDescriptorBuffers_)
+		{
+			// Holds a copy of every material drawn in the frame besides the few compute sets
+			frame.frameDescriptorBuffer_.Init(this, 1024 * 1024);
+			mainDeletionQueue_.pushFunction([&frame]() {
+				frame.frameDescriptorBuffer_.Cleanup();
+			}, "Frame Descriptor Buffer");
+		}
+
+		frame.sceneDataBuffer_ = CreateBuffer(sizeof(GPUSceneData),
+		                                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		                                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+		mainDeletionQueue_.pushFunction([&frame, this]() {
+			DestroyBuffer(frame.sceneDataBuffer_);
+		}, "Frame Scene Data Buffer");
 	}
 
+	// Sets that are rebuilt with identical contents every frame
+	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> cacheSizes
+	{
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+	};
+	descriptorCache_.Init(vd.device, 256, MAX_FRAMES_IN_FLIGHT, cacheSizes);
+	mainDeletionQueue_.pushFunction([this]() {
+		descriptorCache_.Destroy(vd.device);
+	}, "Descriptor Set Cache");
+
 	// Add global descriptor allocator destruction to the deletion queue
 	mainDeletionQueue_.pushFunction([this]() {
 		globalDescriptorAllocator.DestroyPools(vd.device);
@@ -626,19 +1211,25 @@ void VkEngine::Cleanup()
 {
 	if (isInit)
 	{
+		StopRenderThread();
 		vkDeviceWaitIdle(vd.device);
+		jobSystem_.Shutdown();
 		loadedScenes.clear();
 		TracyVkDestroy(tracyContext_);
 
+		vkDestroySemaphore(vd.device, frameTimeline_, nullptr);
 		for (auto& frame : frames_)
 		{
 			// Destroy sync objects
-			vkDestroyFence(vd.device, frame.renderFence_, nullptr);
 			vkDestroySemaphore(vd.device, frame.renderSemaphore_, nullptr);
 			vkDestroySemaphore(vd.device, frame.swapChainSemaphore_, nullptr);
 
 			frame.deletionQueue_.Flush();
 			vkDestroyCommandPool(vd.device, frame.commandPool_, nullptr);
+			for (VkCommandPool pool : frame.workerCommandPools_)
+			{
+				vkDestroyCommandPool(vd.device, pool, nullptr);
+			}
 		}
 
 		for (const auto &mesh : testMeshes)
@@ -781,6 +1372,10 @@ void VkEngine::CreateSwapchain(u32 width, u32 height)
 
 VkExtent3D VkEngine::GetScreenResolution() const
 {
+    if (headless_)
+    {
+	    return VkExtent3D{ .width = headlessOptions_.width, .height = headlessOptions_.height, .depth = 1 };
+    }
     return VkExtent3D
 	{
         .width = windowContext_->screenWidth,
@@ -793,53 +1388,80 @@ void VkEngine::InitSwapchain()
 {
     // Clean up the old swapchain before creating a new one
     DestroySwapchain();
-    CreateSurfaceWin32(windowContext_->hInstance, windowContext_->hwnd, vd);
+    if (headless_)
+    {
+	    // Nothing to present to, frames end in the draw image
+	    swapchainExtent_ = { headlessOptions_.width, headlessOptions_.height };
+    }
+    else
+    {
+	    CreateSurfaceWin32(windowContext_->hInstance, windowContext_->hwnd, vd);
+
+	    // Create a new swapchain
+	    CreateSwapchain(windowContext_->screenWidth, windowContext_->screenHeight);
+    }
+
+    // Setup the draw targets at full resolution, Draw resizes them to the render resolution
+    CreateDrawImage(GetScreenResolution());
+
+    // Sized for the most frames that can be in flight, so changing the count at runtime stays safe
+    renderGraph_.Init(vd.device, allocator_, MAX_FRAMES_IN_FLIGHT);
+
+    // Add cleanup to the deletion queue
+    mainDeletionQueue_.pushFunction([this]()
+    {
+        renderGraph_.Destroy();
 
-    // Create a new swapchain
-    CreateSwapchain(windowContext_->screenWidth, windowContext_->screenHeight);
+        vkDestroyImageView(vd.device, drawImage_.imageView, nullptr);
+        vmaDestroyImage(allocator_, drawImage_.image, drawImage_.allocation);
+    }, "Draw Image and Render Graph");
+}
 
-    // Setup the draw image
-    drawImage_.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-    drawImage_.imageExtent = GetScreenResolution();
+void VkEngine::CreateDrawImage(VkExtent3D extent)
+{
+	drawImage_.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+	drawImage_.imageExtent = extent;
 
 	VkImageUsageFlags drawImageUsages{};
 	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
 	drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	drawImageUsages |= VK_IMAGE_USAGE_SAMPLED_BIT; // upscaler source
 
+	VkImageCreateInfo drawImageInfo = VkInfo::ImageInfo(drawImage_.imageFormat, drawImageUsages, drawImage_.imageExtent);
+	VkImages::CreateImageWithVMA(drawImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawImage_.image,
+		drawImage_.allocation, allocator_);
 
-    VkImageCreateInfo drawImageInfo = VkInfo::ImageInfo(drawImage_.imageFormat, drawImageUsages, drawImage_.imageExtent);
-    VkImages::CreateImageWithVMA(drawImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawImage_.image,
-    	drawImage_.allocation, allocator_);
-
-    VkImageViewCreateInfo drawImageViewInfo = VkInfo::ImageViewInfo(drawImage_.imageFormat, drawImage_.image, VK_IMAGE_ASPECT_COLOR_BIT);
-    VK_CHECK(vkCreateImageView(vd.device, &drawImageViewInfo, nullptr, &drawImage_.imageView));
+	VkImageViewCreateInfo drawImageViewInfo = VkInfo::ImageViewInfo(drawImage_.imageFormat, drawImage_.image, VK_IMAGE_ASPECT_COLOR_BIT);
+	VK_CHECK(vkCreateImageView(vd.device, &drawImageViewInfo, nullptr, &drawImage_.imageView));
 
-    // Setup the depth image (for depth testing)
-    depthImage_.imageFormat = VK_FORMAT_D32_SFLOAT;
-    depthImage_.imageExtent = GetScreenResolution(); // Match draw image size
+	// Setup the depth image (for depth testing). Only described here, it is a render graph transient that Draw
+	// points image and imageView at every frame.
+	depthImage_.imageFormat = VK_FORMAT_D32_SFLOAT;
+	depthImage_.imageExtent = extent; // Match draw image size
+}
 
-    VkImageUsageFlags depthImageUsages {};
-	depthImageUsages |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+void VkEngine::ResizeDrawTargets(VkExtent2D extent)
+{
+	if (extent.width == drawImage_.imageExtent.width && extent.height == drawImage_.imageExtent.height)
+	{
+		return;
+	}
 
-    VkImageCreateInfo depthImageInfo = VkInfo::ImageInfo(depthImage_.imageFormat, depthImageUsages, GetScreenResolution());
-    VkImages::CreateImageWithVMA(depthImageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage_.image,
-    	depthImage_.allocation, allocator_);
+	// Frames still in flight may be using the old image. This slot's queue is flushed once its frame has finished,
+	// and frames finish in order, so by then they all have.
+	const AllocatedImage old = drawImage_;
+	GetCurrentFrame().deletionQueue_.pushFunction([=, this]()
+	{
+		vkDestroyImageView(vd.device, old.imageView, nullptr);
+		vmaDestroyImage(allocator_, old.image, old.allocation);
+	});
+	renderGraph_.ForgetImage(old.image);
 
-    VkImageViewCreateInfo depthImageViewInfo = VkInfo::ImageViewInfo(depthImage_.imageFormat, depthImage_.image, VK_IMAGE_ASPECT_DEPTH_BIT);
-    VK_CHECK(vkCreateImageView(vd.device, &depthImageViewInfo, nullptr, &depthImage_.imageView));
-
-    // Add cleanup to the deletion queue
-    mainDeletionQueue_.pushFunction([this]()
-    {
-        vkDestroyImageView(vd.device, drawImage_.imageView, nullptr);
-        vmaDestroyImage(allocator_, drawImage_.image, drawImage_.allocation);
-
-        vkDestroyImageView(vd.device, depthImage_.imageView, nullptr);
-        vmaDestroyImage(allocator_, depthImage_.image, depthImage_.allocation);
-    }, "Draw and Depth Images");
-}
+	CreateDrawImage({ extent.width, extent.height, 1 });
+	LOG(INFO, "Draw targets resized to ", extent.width, "x", extent.height);
+}
 
 void VkEngine::SetViewportAndScissor(VkCommandBuffer cmd, const VkExtent2D& extent)
 {
@@ -894,6 +1516,14 @@ void VkEngine::InitCommands()
 	}, "Command Pool");
 
 	tracyContext_ = TracyVkContext(vd.physicalDevice, vd.device, graphicsQueue_, immCommandBuffer_);
+
+	gpuProfiler_.Init(vd.device, vd.physicalDevice, graphicsQueueFamily_, MAX_FRAMES_IN_FLIGHT,
+	                  pipelineStatisticsSupported_);
+	renderGraph_.SetProfiler(&gpuProfiler_);
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		gpuProfiler_.Destroy();
+	}, "GPU Profiler");
 }
 
 void VkEngine::InitializeCommandPoolsAndBuffers()
@@ -916,6 +1546,21 @@ void VkEngine::InitializeCommandPoolsAndBuffers()
 			LOG(ERR, "Failed to allocate command buffers");
 			return;
 		}
+
+		// One recording slice per worker plus the main thread, which helps while it waits
+		const u32 sliceCount = jobSystem_.ThreadCount() > 0 ? jobSystem_.ThreadCount() + 1 : 0;
+		frame.workerCommandPools_.resize(sliceCount);
+		frame.workerCommandBuffers_.resize(sliceCount);
+		for (u32 i = 0; i < sliceCount; i++)
+		{
+			VkCommandPoolCreateInfo workerPoolInfo = VkInfo::CommandPoolInfo(graphicsQueueFamily_,
+			                                                                 VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			VK_CHECK(vkCreateCommandPool(vd.device, &workerPoolInfo, nullptr, &frame.workerCommandPools_[i]));
+
+			VkCommandBufferAllocateInfo secondaryAllocInfo = VkInfo::CommandBufferAllocateInfo(frame.workerCommandPools_[i], 1);
+			secondaryAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			VK_CHECK(vkAllocateCommandBuffers(vd.device, &secondaryAllocInfo, &frame.workerCommandBuffers_[i]));
+		}
 	}
 }
 
@@ -926,16 +1571,24 @@ void VkEngine::InitializeCommandPoolsAndBuffers()
 void VkEngine::InitSyncStructures()
 {
 	// Create synchronization structures:
-	// - One fence to control when the GPU has finished rendering the frame.
-	// - Two semaphores to synchronize rendering with the swapchain.
-	// We want the fence to start signaled so we can wait on it on the first frame.
+	// - One timeline semaphore counting finished frames, Draw waits on it before reusing a frame's resources.
+	// - Two semaphores per frame to synchronize rendering with the swapchain.
+	// The fence is only used by immediate submits.
 	const VkFenceCreateInfo     fenceCreateInfo     = VkInfo::FenceInfo(VK_FENCE_CREATE_SIGNALED_BIT);
 	const VkSemaphoreCreateInfo semaphoreCreateInfo = VkInfo::SemaphoreInfo(0);
 
-	for (int i = 0; i < FRAME_OVERLAP; i++)
+	VkSemaphoreTypeCreateInfo timelineTypeInfo
 	{
-		VK_CHECK(vkCreateFence(vd.device, &fenceCreateInfo, nullptr, &frames_[i].renderFence_));
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+	VkSemaphoreCreateInfo timelineCreateInfo = VkInfo::SemaphoreInfo(0);
+	timelineCreateInfo.pNext = &timelineTypeInfo;
+	VK_CHECK(vkCreateSemaphore(vd.device, &timelineCreateInfo, nullptr, &frameTimeline_));
 
+	for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
 		VK_CHECK(vkCreateSemaphore(vd.device, &semaphoreCreateInfo, nullptr, &frames_[i].swapChainSemaphore_));
 		VK_CHECK(vkCreateSemaphore(vd.device, &semaphoreCreateInfo, nullptr, &frames_[i].renderSemaphore_));
 	}
@@ -1061,11 +1714,18 @@ void VkEngine::UnmapBuffer(const AllocatedBuffer& buffer)
 	vmaUnmapMemory(allocator_, buffer.allocation);
 }
 
-void VkEngine::DestroyBuffer(const AllocatedBuffer& buffer) const
+void VkEngine::DestroyBuffer(const AllocatedBuffer& buffer)
 {
+	descriptorCache_.Invalidate(buffer.buffer);
 	vmaDestroyBuffer(allocator_, buffer.buffer, buffer.allocation);
 }
 
+void VkEngine::DestroyImage(const AllocatedImage& image)
+{
+	descriptorCache_.Invalidate(image.imageView);
+	VkImages::DestroyImage(image, vd.device, allocator_);
+}
+
 void VkEngine::CleanupAlloc()
 {
 	vmaDestroyAllocator(allocator_);
@@ -1080,10 +1740,11 @@ VkDeviceAddress VkEngine::GetBufferDeviceAddress(VkBuffer buffer)
     return vkGetBufferDeviceAddress(vd.device, &deviceAddressInfo);
 }
 
-GPUMeshBuffers VkEngine::UploadMesh(std::span<u32> indices, std::span<Vertex> vertices)
+GPUMeshBuffers VkEngine::UploadMesh(std::span<u32> indices, std::span<Vertex> vertices, std::span<const GPUMeshlet> meshlets)
 {
     const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
     const size_t indexBufferSize = indices.size() * sizeof(u32);
+    const size_t meshletBufferSize = meshlets.size() * sizeof(GPUMeshlet);
 
     GPUMeshBuffers newSurface{};
 
@@ -1098,8 +1759,17 @@ GPUMeshBuffers VkEngine::UploadMesh(std::span<u32> indices, std::span<Vertex> ve
                                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                           VMA_MEMORY_USAGE_GPU_ONLY);
 
+    // Meshlets are only read by the cluster culling compute pass, through their device address
+    if (meshletBufferSize > 0)
+    {
+        newSurface.meshletBuffer = CreateBuffer(meshletBufferSize,
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                VMA_MEMORY_USAGE_GPU_ONLY);
+        newSurface.meshletBufferAddress = GetBufferDeviceAddress(newSurface.meshletBuffer.buffer);
+    }
+
     // Create staging buffer on CPU (host-visible)
-    AllocatedBuffer stagingBuffer = CreateBuffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    AllocatedBuffer stagingBuffer = CreateBuffer(vertexBufferSize + indexBufferSize + meshletBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
 
     // Map staging buffer to CPU address space
     void* mappedData = nullptr;
@@ -1108,6 +1778,10 @@ GPUMeshBuffers VkEngine::UploadMesh(std::span<u32> indices, std::span<Vertex> ve
     // Copy vertex and index data to staging buffer
     memcpy(mappedData, vertices.data(), vertexBufferSize);
     memcpy(static_cast<char*>(mappedData) + vertexBufferSize, indices.data(), indexBufferSize);
+    if (meshletBufferSize > 0)
+    {
+        memcpy(static_cast<char*>(mappedData) + vertexBufferSize + indexBufferSize, meshlets.data(), meshletBufferSize);
+    }
 
     // Unmap the staging buffer
     vmaUnmapMemory(allocator_, stagingBuffer.allocation);
@@ -1127,6 +1801,16 @@ GPUMeshBuffers VkEngine::UploadMesh(std::span<u32> indices, std::span<Vertex> ve
 		indexCopy.size = indexBufferSize;
 
 		vkCmdCopyBuffer(cmd, stagingBuffer.buffer, newSurface.indexBuffer.buffer, 1, &indexCopy);
+
+		if (meshletBufferSize > 0)
+		{
+			VkBufferCopy meshletCopy{};
+			meshletCopy.dstOffset = 0;
+			meshletCopy.srcOffset = vertexBufferSize + indexBufferSize;
+			meshletCopy.size = meshletBufferSize;
+
+			vkCmdCopyBuffer(cmd, stagingBuffer.buffer, newSurface.meshletBuffer.buffer, 1, &meshletCopy);
+		}
     });
 
     // Clean up staging buffer
@@ -1141,11 +1825,45 @@ GPUMeshBuffers VkEngine::UploadMesh(std::span<u32> indices, std::span<Vertex> ve
 
 void VkEngine::InitPipelines()
 {
-	InitBackgroundPipelines();
+	pipelineCache_.Init(vd.device, deviceProperties, "pipeline_cache.bin");
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		pipelineCache_.Save(vd.device);
+		pipelineCache_.Destroy(vd.device);
+	}, "Pipeline Cache");
+
+	pipelineRegistry_.Init(pipelineCache_.Handle());
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		pipelineRegistry_.Destroy(vd.device);
+	}, "Pipeline Registry");
 
-	InitMeshPipeline();
+	const auto start = std::chrono::high_resolution_clock::now();
 
-	metalRoughMaterial.BuildPipelines(this, vd.device);
+	// The groups don't depend on each other and only share the pipeline cache, which is internally synchronized
+	jobSystem_.Execute([this] { InitBackgroundPipelines(); });
+	jobSystem_.Execute([this] { InitMeshPipeline(); });
+	jobSystem_.Execute([this] { InitMeshletCullPipeline(); });
+	jobSystem_.Execute([this] { InitUpscalePipelines(); });
+	jobSystem_.Execute([this] { metalRoughMaterial.BuildPipelines(this, vd.device); });
+	jobSystem_.Wait();
+
+	// Shared by both bindless material pipelines, null when the device has no bindless support
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		vkDestroyPipelineLayout(vd.device, metalRoughMaterial.bindlessOpaquePipeline.layout, nullptr);
+	}, "Bindless Material Pipeline Layout");
+
+	// Null unless the material pipelines were built for descriptor buffers
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		vkDestroyDescriptorSetLayout(vd.device, metalRoughMaterial.materialBufferLayout, nullptr);
+	}, "Material Descriptor Buffer Layout");
+
+	const f32 elapsedMs = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	const char* cacheState = pipelineCache_.WasLoaded() ? "warm" : "cold";
+	timingResults[std::string("Pipeline Creation (") + cacheState + ")"] = elapsedMs;
+	LOG(INFO, "Created pipelines in ", elapsedMs, " ms (", cacheState, " cache, ", jobSystem_.ThreadCount(), " workers)");
 }
 void VkEngine::InitBackgroundPipelines()
 {
@@ -1191,17 +1909,22 @@ void VkEngine::InitBackgroundPipelines()
 		gradientPipelineLayout_);
 	VkComputePipelineCreateInfo skyPipelineCreateInfo = VkInfo::ComputePipelineInfo(skyStageInfo,
 		gradientPipelineLayout_);
+	if (useDescriptorBuffers_)
+	{
+		gradientPipelineCreateInfo.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+		skyPipelineCreateInfo.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+	}
 
 	gradient.name	= "gradient";
 	gradient.layout = gradientPipelineLayout_;
 	gradient.data	= {glm::vec4(1, 0, 0, 1), glm::vec4(0, 0, 1, 1)};
-	VK_CHECK(vkCreateComputePipelines(vd.device, VK_NULL_HANDLE, 1, &gradientPipelineCreateInfo, nullptr,
+	VK_CHECK(vkCreateComputePipelines(vd.device, pipelineCache_.Handle(), 1, &gradientPipelineCreateInfo, nullptr,
 									  &gradient.pipeline));
 
 	sky.name   = "sky";
 	sky.layout = gradientPipelineLayout_;
 	sky.data   = {glm::vec4(0.1, 0.2, 0.4, 0.97)};
-	VK_CHECK(vkCreateComputePipelines(vd.device, VK_NULL_HANDLE, 1, &skyPipelineCreateInfo, nullptr, &sky.pipeline));
+	VK_CHECK(vkCreateComputePipelines(vd.device, pipelineCache_.Handle(), 1, &skyPipelineCreateInfo, nullptr, &sky.pipeline));
 
 	backgroundEffects.push_back(gradient);
 	backgroundEffects.push_back(sky);
@@ -1236,14 +1959,14 @@ void VkEngine::InitBackgroundPipelines()
 
 void VkEngine::InitMeshPipeline()
 {
-    VkShaderModule triangleFragShader;
-    if (!loader_.LoadShader("shaders/texImg.frag.spv", vd.device, &triangleFragShader))
+    VkShaderModule triangleFragShader = pipelineRegistry_.LoadShader(vd.device, "shaders/texImg.frag.spv");
+    if (!triangleFragShader)
     {
         LOG(ERR, "Error when building the triangle fragment shader module");
     }
 
-    VkShaderModule triangleVertexShader;
-    if (!loader_.LoadShader("shaders/coloredTriangleMesh.vert.spv", vd.device, &triangleVertexShader))
+    VkShaderModule triangleVertexShader = pipelineRegistry_.LoadShader(vd.device, "shaders/coloredTriangleMesh.vert.spv");
+    if (!triangleVertexShader)
     {
         LOG(ERR, "Error when building the triangle vertex shader module");
     }
@@ -1273,24 +1996,109 @@ void VkEngine::InitMeshPipeline()
 		.Layout(meshPipelineLayout_)
 		.EnableBlendingAdditive();
 
-    meshPipeline_ = pipelineBuilder.BuildPipeline(vd.device, pipelineBuilder.data);
-
-	// Destroy shader modules immediately
-	vkDestroyShaderModule(vd.device, triangleFragShader, nullptr);
-	vkDestroyShaderModule(vd.device, triangleVertexShader, nullptr);
+    // Pipeline and shader modules are owned by the registry
+    meshPipeline_ = pipelineRegistry_.GetOrCreate(vd.device, pipelineBuilder.data);
 
     mainDeletionQueue_.pushFunction([&]()
     {
         vkDestroyPipelineLayout(vd.device, meshPipelineLayout_, nullptr);
-        vkDestroyPipeline(vd.device, meshPipeline_, nullptr);
-    }, "Mesh Pipeline");
+    }, "Mesh Pipeline Layout");
+}
+
+void VkEngine::InitMeshletCullPipeline()
+{
+	// Everything is reached through buffer device addresses, so no descriptor sets are needed
+	VkPushConstantRange pushConstant
+	{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset     = 0,
+		.size       = sizeof(MeshletCullPushConstants)
+	};
+
+	VkPipelineLayoutCreateInfo layoutInfo = VkInfo::CreatePipelineLayoutInfo(0, nullptr, 1, &pushConstant);
+	VK_CHECK(vkCreatePipelineLayout(vd.device, &layoutInfo, nullptr, &meshletCullPipelineLayout_));
+
+	VkShaderModule cullShader;
+	if (!loader_.LoadShader("shaders/meshlet_cull.comp.spv", vd.device, &cullShader))
+	{
+		LOG(ERR, "Error when building the meshlet culling compute shader");
+	}
+
+	VkPipelineShaderStageCreateInfo stageInfo = VkInfo::PipelineShaderStageInfo(VK_SHADER_STAGE_COMPUTE_BIT, cullShader);
+	VkComputePipelineCreateInfo pipelineInfo = VkInfo::ComputePipelineInfo(stageInfo, meshletCullPipelineLayout_);
+	VK_CHECK(vkCreateComputePipelines(vd.device, pipelineCache_.Handle(), 1, &pipelineInfo, nullptr, &meshletCullPipeline_));
+
+	vkDestroyShaderModule(vd.device, cullShader, nullptr);
+
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		vkDestroyPipelineLayout(vd.device, meshletCullPipelineLayout_, nullptr);
+		vkDestroyPipeline(vd.device, meshletCullPipeline_, nullptr);
+	}, "Meshlet Cull Pipeline");
+
+	// Created by the first frame that culls meshlets
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		if (clusterCommandCapacity_ > 0)
+		{
+			DestroyBuffer(clusterCommandBuffer_);
+			DestroyBuffer(clusterCountBuffer_);
+		}
+	}, "Cluster Cull Buffers");
+}
+
+void VkEngine::InitUpscalePipelines()
+{
+	VkPushConstantRange pushConstant
+	{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset     = 0,
+		.size       = sizeof(UpscalePushConstants)
+	};
+
+	VkPipelineLayoutCreateInfo layoutInfo = VkInfo::CreatePipelineLayoutInfo(1, &upscaleDescriptorLayout_, 1, &pushConstant);
+	VK_CHECK(vkCreatePipelineLayout(vd.device, &layoutInfo, nullptr, &upscalePipelineLayout_));
+
+	VkShaderModule upscaleShader;
+	if (!loader_.LoadShader("shaders/upscale.comp.spv", vd.device, &upscaleShader))
+	{
+		LOG(ERR, "Error when building the upscale compute shader");
+	}
+
+	VkShaderModule sharpenShader;
+	if (!loader_.LoadShader("shaders/sharpen.comp.spv", vd.device, &sharpenShader))
+	{
+		LOG(ERR, "Error when building the sharpen compute shader");
+	}
+
+	VkComputePipelineCreateInfo upscaleInfo = VkInfo::ComputePipelineInfo(
+		VkInfo::PipelineShaderStageInfo(VK_SHADER_STAGE_COMPUTE_BIT, upscaleShader), upscalePipelineLayout_);
+	VkComputePipelineCreateInfo sharpenInfo = VkInfo::ComputePipelineInfo(
+		VkInfo::PipelineShaderStageInfo(VK_SHADER_STAGE_COMPUTE_BIT, sharpenShader), upscalePipelineLayout_);
+	if (useDescriptorBuffers_)
+	{
+		upscaleInfo.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+		sharpenInfo.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+	}
+	VK_CHECK(vkCreateComputePipelines(vd.device, pipelineCache_.Handle(), 1, &upscaleInfo, nullptr, &upscalePipeline_));
+	VK_CHECK(vkCreateComputePipelines(vd.device, pipelineCache_.Handle(), 1, &sharpenInfo, nullptr, &sharpenPipeline_));
+
+	vkDestroyShaderModule(vd.device, upscaleShader, nullptr);
+	vkDestroyShaderModule(vd.device, sharpenShader, nullptr);
+
+	mainDeletionQueue_.pushFunction([&]()
+	{
+		vkDestroyPipelineLayout(vd.device, upscalePipelineLayout_, nullptr);
+		vkDestroyPipeline(vd.device, upscalePipeline_, nullptr);
+		vkDestroyPipeline(vd.device, sharpenPipeline_, nullptr);
+	}, "Upscale Pipelines");
 }
 
 #pragma endregion Pipelines
 
 #pragma region Draw
 
-void VkEngine::DrawImGui(VkCommandBuffer cmd, VkImageView targetImageView)
+void VkEngine::DrawImGui(VkCommandBuffer cmd, VkImageView targetImageView, ImDrawData* drawData)
 {
 	TracyVkZone(tracyContext_, cmd, "Draw ImGui");
 
@@ -1308,91 +2116,521 @@ void VkEngine::DrawImGui(VkCommandBuffer cmd, VkImageView targetImageView)
 
 	vkCmdBeginRendering(cmd, &renderInfo);
 
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+	ImGui_ImplVulkan_RenderDrawData(drawData, cmd);
 
 	vkCmdEndRendering(cmd);
 }
 
+void VkEngine::CopyDrawImageToReadback(VkCommandBuffer cmd)
+{
+	readbackExtent_ = drawExtent_;
+	VkBufferImageCopy region
+	{
+		.bufferOffset = 0,
+		.imageSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
+		.imageExtent = { readbackExtent_.width, readbackExtent_.height, 1 }
+	};
+	vkCmdCopyImageToBuffer(cmd, drawImage_.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer_.buffer, 1,
+	                       &region);
+
+	// The host reads the buffer once the frame timeline passes this frame, the copy has to be visible to it by then
+	VkMemoryBarrier2 hostBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+		.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT
+	};
+	VkDependencyInfo depInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &hostBarrier
+	};
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+bool VkEngine::WriteReadback(const std::filesystem::path& path)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		LOG(ERR, "Could not open ", path.string(), " for the readback");
+		return false;
+	}
+
+	VK_CHECK(vmaInvalidateAllocation(allocator_, readbackBuffer_.allocation, 0, VK_WHOLE_SIZE));
+	const u16* pixels = static_cast<const u16*>(readbackBuffer_.info.pMappedData);
+
+	// Binary PPM, the half floats clamped to 8 bit without tone mapping
+	const u32 width = readbackExtent_.width;
+	const u32 height = readbackExtent_.height;
+	file << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<u8> row(static_cast<size_t>(width) * 3);
+	for (u32 y = 0; y < height; y++)
+	{
+		for (u32 x = 0; x < width; x++)
+		{
+			const u16* pixel = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+			for (u32 c = 0; c < 3; c++)
+			{
+				const f32 value = std::clamp(glm::unpackHalf1x16(pixel[c]), 0.f, 1.f);
+				row[x * 3 + c] = static_cast<u8>(value * 255.f + 0.5f);
+			}
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+	}
+
+	LOG(INFO, "Wrote the last frame (", width, "x", height, ") to ", path.string());
+	return file.good();
+}
+
 void VkEngine::DrawBackground(VkCommandBuffer cmd)
 {
 	TracyVkZone(tracyContext_, cmd, "Draw Background");
 
-	ComputeEffect& effect = backgroundEffects[currentBackgroundEffect_];
+	ComputeEffect& effect = backgroundEffects[settings_.backgroundEffect];
 	// Bind the background compute pipeline
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, effect.pipeline);
 
+	GpuProfiler::PassCounters& counters = gpuProfiler_.Counters();
+	counters.pipelineBinds++;
+	counters.descriptorBinds++;
+
 	// Bind the descriptor set containing the draw image for the compute pipeline
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, gradientPipelineLayout_, 0, 1, &drawImageDescriptors_, 0, nullptr);
+	if (useDescriptorBuffers_)
+	{
+		// Written straight into this frame's mapped descriptor buffer
+		DescriptorBufferAllocator& descriptors = GetCurrentFrame().frameDescriptorBuffer_;
+		DescriptorBufferAllocator::Allocation set = descriptors.Allocate(vd.device, drawImageDescriptorLayout_);
+		descriptors.WriteImage(vd.device, set, 0, drawImage_.imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL,
+		                       VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		descriptors.Bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, gradientPipelineLayout_, 0, set);
+	}
+	else
+	{
+		// The draw image is reallocated when the render resolution changes, so its set is written every frame too
+		VkDescriptorSet set = GetCurrentFrame().frameDescriptors_.Allocate(vd.device, drawImageDescriptorLayout_);
+		VkDescriptorWriter writer;
+		writer.WriteImage(0, drawImage_.imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.UpdateSet(vd.device, set);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, gradientPipelineLayout_, 0, 1, &set, 0, nullptr);
+	}
 
 	vkCmdPushConstants(cmd, gradientPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &effect.data);
+	counters.pushConstantBytes += sizeof(ComputePushConstants);
 
 	// Execute the compute pipeline dispatch. We are using 16x16 workgroup size so we need to divide by it
 	vkCmdDispatch(cmd, static_cast<u32>(std::ceil(drawExtent_.width / 16.0)), static_cast<u32>(std::ceil(drawExtent_.height / 16.0)), 1);
+	counters.dispatches++;
+}
+
+void VkEngine::DispatchUpscale(VkCommandBuffer cmd, VkPipeline pipeline, VkImageView source, VkExtent2D sourceSize,
+                               VkImageView target, VkExtent2D targetSize)
+{
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	GpuProfiler::PassCounters& counters = gpuProfiler_.Counters();
+	counters.pipelineBinds++;
+	counters.descriptorBinds++;
+
+	// The shaders fetch texels themselves, the sampler only has to be there
+	if (useDescriptorBuffers_)
+	{
+		DescriptorBufferAllocator& descriptors = GetCurrentFrame().frameDescriptorBuffer_;
+		DescriptorBufferAllocator::Allocation set = descriptors.Allocate(vd.device, upscaleDescriptorLayout_);
+		descriptors.WriteImage(vd.device, set, 0, source, defaultSamplerNearest_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		descriptors.WriteImage(vd.device, set, 1, target, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL,
+		                       VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		descriptors.Bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, upscalePipelineLayout_, 0, set);
+	}
+	else
+	{
+		// Transient views come and go with the render graph, so the set is the frame's rather than a cached one
+		VkDescriptorSet set = GetCurrentFrame().frameDescriptors_.Allocate(vd.device, upscaleDescriptorLayout_);
+		VkDescriptorWriter writer;
+		writer.WriteImage(0, source, defaultSamplerNearest_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		writer.WriteImage(1, target, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.UpdateSet(vd.device, set);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, upscalePipelineLayout_, 0, 1, &set, 0, nullptr);
+	}
+
+	const UpscalePushConstants pushConstants
+	{
+		.sourceSize = { static_cast<f32>(sourceSize.width), static_cast<f32>(sourceSize.height) },
+		.targetSize = { static_cast<f32>(targetSize.width), static_cast<f32>(targetSize.height) },
+		.sharpness = settings_.upscaleSharpness
+	};
+	vkCmdPushConstants(cmd, upscalePipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(UpscalePushConstants),
+	                   &pushConstants);
+	counters.pushConstantBytes += sizeof(UpscalePushConstants);
+
+	vkCmdDispatch(cmd, (targetSize.width + 15) / 16, (targetSize.height + 15) / 16, 1);
+	counters.dispatches++;
+}
+
+
+bool VkEngine::PrepareMeshletCull()
+{
+	clusterDrawCount_ = 0;
+	clusterMeshletCount_ = 0;
+	clusterMaxMeshlets_ = 0;
+	if (!settings_.meshletCulling)
+	{
+		return false;
+	}
+
+	for (const RenderObject& r : mainDrawContext.OpaqueSurfaces)
+	{
+		if (r.meshletCount > 0)
+		{
+			clusterDrawCount_++;
+			clusterMeshletCount_ += r.meshletCount;
+			clusterMaxMeshlets_ = std::max(clusterMaxMeshlets_, r.meshletCount);
+		}
+	}
+	if (clusterDrawCount_ == 0)
+	{
+		return false;
+	}
+
+	constexpr VkBufferUsageFlags clusterUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+	                                            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	GrowClusterBuffer(clusterCommandBuffer_, clusterCommandCapacity_,
+	                  clusterMeshletCount_ * sizeof(VkDrawIndexedIndirectCommand), clusterUsage);
+	GrowClusterBuffer(clusterCountBuffer_, clusterCountCapacity_, clusterDrawCount_ * sizeof(u32),
+	                  clusterUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	// Per frame upload buffer, released with the frame like the scene data buffer
+	const size_t cullDataSize = sizeof(GPUClusterCullHeader) + clusterDrawCount_ * sizeof(GPUClusterDraw);
+	AllocatedBuffer cullDataBuffer = CreateBuffer(cullDataSize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+	GetCurrentFrame().deletionQueue_.pushFunction([=, this]()
+	{
+		DestroyBuffer(cullDataBuffer);
+	});
+
+	void* data = nullptr;
+	VK_CHECK(vmaMapMemory(allocator_, cullDataBuffer.allocation, &data));
+
+	// Side planes from the rows of viewproj, the near plane from the view matrix so the depth range convention
+	// doesn't matter. Far is left out, it only ever rejects what the depth test would anyway.
+	auto* header = static_cast<GPUClusterCullHeader*>(data);
+	const glm::mat4& vp = sceneData.viewproj;
+	const glm::vec4 row0(vp[0][0], vp[1][0], vp[2][0], vp[3][0]);
+	const glm::vec4 row1(vp[0][1], vp[1][1], vp[2][1], vp[3][1]);
+	const glm::vec4 row3(vp[0][3], vp[1][3], vp[2][3], vp[3][3]);
+	const glm::mat4& view = sceneData.view;
+	header->frustum[0] = row3 + row0;
+	header->frustum[1] = row3 - row0;
+	header->frustum[2] = row3 + row1;
+	header->frustum[3] = row3 - row1;
+	header->frustum[4] = glm::vec4(-view[0][2], -view[1][2], -view[2][2], -view[3][2] - settings_.nearPlane);
+	for (glm::vec4& plane : header->frustum)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	// The eye of this frame's interpolated view, camera_ belongs to the main thread
+	header->cameraPosition = glm::inverse(view)[3];
+
+	auto* draws = reinterpret_cast<GPUClusterDraw*>(header + 1);
+	u32 drawIndex = 0;
+	u32 commandOffset = 0;
+	for (RenderObject& r : mainDrawContext.OpaqueSurfaces)
+	{
+		if (r.meshletCount == 0)
+		{
+			continue;
+		}
+
+		draws[drawIndex] = {
+			.transform = r.transform,
+			.meshlets = r.meshletBufferAddress,
+			.meshletCount = r.meshletCount,
+			.commandOffset = commandOffset
+		};
+		r.clusterDrawIndex = drawIndex++;
+		r.clusterCommandOffset = commandOffset;
+		commandOffset += r.meshletCount;
+	}
+	vmaUnmapMemory(allocator_, cullDataBuffer.allocation);
+
+	clusterCullDataBuffer_ = cullDataBuffer.buffer;
+	return true;
 }
 
+void VkEngine::GrowClusterBuffer(AllocatedBuffer& buffer, VkDeviceSize& capacity, VkDeviceSize size,
+                                 VkBufferUsageFlags usage)
+{
+	if (size <= capacity)
+	{
+		return;
+	}
+
+	// Frames still in flight may read the old one, it goes with this slot's queue like a resized draw image
+	if (capacity > 0)
+	{
+		const AllocatedBuffer old = buffer;
+		GetCurrentFrame().deletionQueue_.pushFunction([=, this]()
+		{
+			DestroyBuffer(old);
+		});
+		renderGraph_.ForgetBuffer(old.buffer);
+	}
+
+	capacity = std::bit_ceil(size);
+	buffer = CreateBuffer(capacity, usage, VMA_MEMORY_USAGE_GPU_ONLY);
+}
+
+void VkEngine::CullMeshlets(VkCommandBuffer cmd)
+{
+	TracyVkZone(tracyContext_, cmd, "Cull Meshlets");
+
+	// Only the fill has to be ordered inside the pass, the render graph makes the results visible to the draws
+	vkCmdFillBuffer(cmd, clusterCountBuffer_.buffer, 0, VK_WHOLE_SIZE, 0);
+
+	VkMemoryBarrier2 fillBarrier
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+	};
+	VkDependencyInfo depInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &fillBarrier
+	};
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+
+	MeshletCullPushConstants pushConstants
+	{
+		.cullData = GetBufferDeviceAddress(clusterCullDataBuffer_),
+		.drawCommands = GetBufferDeviceAddress(clusterCommandBuffer_.buffer),
+		.drawCounts = GetBufferDeviceAddress(clusterCountBuffer_.buffer),
+		.drawCount = clusterDrawCount_,
+		.coneCulling = settings_.meshletConeCulling ? 1u : 0u
+	};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, meshletCullPipeline_);
+	vkCmdPushConstants(cmd, meshletCullPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletCullPushConstants), &pushConstants);
+	// 64 meshlets per workgroup along x, one row of workgroups per draw
+	vkCmdDispatch(cmd, (clusterMaxMeshlets_ + 63) / 64, clusterDrawCount_, 1);
+
+	GpuProfiler::PassCounters& counters = gpuProfiler_.Counters();
+	counters.pipelineBinds++;
+	counters.pushConstantBytes += sizeof(MeshletCullPushConstants);
+	counters.dispatches++;
+}
 
 void VkEngine::DrawGeometry(VkCommandBuffer cmd)
 {
     TracyVkZone(tracyContext_, cmd, "Draw Geometry");
+	Timer recordTimer("Record Geometry", renderTimingResults_);
 	// Prepare rendering attachments for color and depth
-	VkRenderingAttachmentInfo colorAttachment = VkInfo::RenderAttachmentInfo(drawImage_.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL);
+	VkRenderingAttachmentInfo colorAttachment = VkInfo::RenderAttachmentInfo(drawImage_.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 	VkRenderingAttachmentInfo depthAttachment = VkInfo::DepthAttachmentInfo(depthImage_.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 	VkRenderingInfo renderInfo = VkInfo::RenderInfo(drawExtent_, &colorAttachment, &depthAttachment);
 
     // Allocate a uniform buffer for the scene data
-    AllocatedBuffer gpuSceneDataBuffer = CreateBuffer(
-        sizeof(GPUSceneData),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VMA_MEMORY_USAGE_CPU_TO_GPU
-    );
-
-    // Add the buffer to the current frame's deletion queue
-    GetCurrentFrame().deletionQueue_.pushFunction([=, this]() {
-        DestroyBuffer(gpuSceneDataBuffer);
-    });
-
-	// Map and copy scene data if necessary
-	void* data = nullptr;
-	VK_CHECK(vmaMapMemory(allocator_, gpuSceneDataBuffer.allocation, &data));
-	auto* sceneUniformData = static_cast<GPUSceneData*>(data);
-	*sceneUniformData = sceneData;
-	vmaUnmapMemory(allocator_, gpuSceneDataBuffer.allocation);
-
-    // Create and update descriptor set for the scene data buffer
-    VkDescriptorSet globalDescriptor = GetCurrentFrame().frameDescriptors_.Allocate(
-        vd.device,
-        gpuSceneDataDescriptorLayout_
-    );
+	// The frame's scene buffer is free again once the frame timeline passes it
+	const AllocatedBuffer& gpuSceneDataBuffer = GetCurrentFrame().sceneDataBuffer_;
+	*static_cast<GPUSceneData*>(gpuSceneDataBuffer.info.pMappedData) = sceneData;
 
+    // Same buffer every time this frame slot comes around, so the set comes from the cache after the first frames
 	VkDescriptorWriter writer;
 	writer.WriteBuffer(0, gpuSceneDataBuffer.buffer, sizeof(GPUSceneData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.UpdateSet(vd.device, globalDescriptor);
+	GeometryDescriptors descriptors{ .scene = descriptorCache_.Get(vd.device, gpuSceneDataDescriptorLayout_, writer) };
+
+	// Opaque then transparent, the slices below index into both as one list
+	const u32 drawCount = static_cast<u32>(mainDrawContext.OpaqueSurfaces.size() +
+	                                       mainDrawContext.TransparentSurfaces.size());
+
+	FrameData& frame = GetCurrentFrame();
+	if (useDescriptorBuffers_)
+	{
+		// Written here, before any slice records, so the recording threads only read the frame's buffer
+		DescriptorBufferAllocator& frameDescriptors = frame.frameDescriptorBuffer_;
+		descriptors.buffer = &frameDescriptors;
+		descriptors.sceneBuffer = frameDescriptors.Allocate(vd.device, gpuSceneDataBufferLayout_);
+		DescriptorBufferAllocator::WriteBuffer(vd.device, descriptors.sceneBuffer, 0,
+		                                       GetBufferDeviceAddress(gpuSceneDataBuffer.buffer), sizeof(GPUSceneData),
+		                                       VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+
+		// Every material drawn is copied in once, its draws all point at that copy
+		frameMaterialSets_.clear();
+		drawMaterialSets_.resize(drawCount);
+		const u32 opaqueCount = static_cast<u32>(mainDrawContext.OpaqueSurfaces.size());
+		for (u32 i = 0; i < drawCount; i++)
+		{
+			const MaterialInstance* material = i < opaqueCount
+				? mainDrawContext.OpaqueSurfaces[i].material
+				: mainDrawContext.TransparentSurfaces[i - opaqueCount].material;
 
-    // Begin rendering
-    vkCmdBeginRendering(cmd, &renderInfo);
+			auto [it, inserted] = frameMaterialSets_.try_emplace(material);
+			if (inserted)
+			{
+				it->second = frameDescriptors.Copy(vd.device, metalRoughMaterial.materialBufferLayout,
+				                                   material->descriptors);
+			}
+			drawMaterialSets_[i] = it->second;
+		}
+		descriptors.materials = drawMaterialSets_;
+	}
 
-	// Bind the mesh pipeline
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline_);
+	// Big draw lists are cut into contiguous slices recorded into secondary command buffers on the job system, one
+	// slice per thread at most. Each slice keeps the order of the list, so state sorting still pays off within it.
+	// Secondaries can only run under the pass's statistics query when they may inherit it, else record inline
+	u32 sliceCount = 1;
+	if (settings_.parallelRecording && !frame.workerCommandBuffers_.empty() &&
+	    (inheritedQueriesSupported_ || gpuProfiler_.ActiveStatistics() == 0))
+	{
+		sliceCount = std::clamp((drawCount + MIN_DRAWS_PER_SLICE - 1) / MIN_DRAWS_PER_SLICE, 1u,
+		                        static_cast<u32>(frame.workerCommandBuffers_.size()));
+	}
+	geometrySlices_ = sliceCount;
 
-	SetViewportAndScissor(cmd, drawExtent_);
+	std::vector<GeometrySlice> slices(sliceCount);
+	if (sliceCount > 1)
+	{
+		renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+		vkCmdBeginRendering(cmd, &renderInfo);
 
-    // Bind a fallback texture (error checkerboard image)
-    VkDescriptorSet imageSet = GetCurrentFrame().frameDescriptors_.Allocate(vd.device, singleImageDescriptorLayout_);
-    {
-        VkDescriptorWriter imgWrite;
-        imgWrite.WriteImage(0, errorCheckerboardImage_.imageView, defaultSamplerNearest_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-        imgWrite.UpdateSet(vd.device, imageSet);
-    }
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineLayout_, 0, 1, &imageSet, 0, nullptr);
+		VkCommandBufferInheritanceRenderingInfo renderingInheritance
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+			.colorAttachmentCount = 1,
+			.pColorAttachmentFormats = &drawImage_.imageFormat,
+			.depthAttachmentFormat = depthImage_.imageFormat,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+		};
+		VkCommandBufferInheritanceInfo inheritance
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+			.pNext = &renderingInheritance,
+			.pipelineStatistics = gpuProfiler_.ActiveStatistics()
+		};
+		const VkCommandBufferBeginInfo secondaryBeginInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+			.pInheritanceInfo = &inheritance
+		};
+
+		const u32 sliceSize = (drawCount + sliceCount - 1) / sliceCount;
+		// Every slice owns its pool, so no two threads ever record from the same one
+		jobSystem_.Dispatch(sliceCount, 1, [&](u32 slice)
+		{
+			VK_CHECK(vkResetCommandPool(vd.device, frame.workerCommandPools_[slice], 0));
+			VkCommandBuffer secondary = frame.workerCommandBuffers_[slice];
+			VK_CHECK(vkBeginCommandBuffer(secondary, &secondaryBeginInfo));
+
+			const u32 begin = std::min(slice * sliceSize, drawCount);
+			const u32 end = std::min(begin + sliceSize, drawCount);
+			RecordGeometryDraws(secondary, begin, end, descriptors, slices[slice]);
+
+			VK_CHECK(vkEndCommandBuffer(secondary));
+		});
+		jobSystem_.Wait();
+
+		vkCmdExecuteCommands(cmd, sliceCount, frame.workerCommandBuffers_.data());
+	}
+	else
+	{
+		// Begin rendering
+		vkCmdBeginRendering(cmd, &renderInfo);
 
-	//defined outside of the draw function, this is the state we will try to skip
-	MaterialPipeline* lastPipeline = nullptr;
-	MaterialInstance* lastMaterial = nullptr;
+		// Bind the mesh pipeline
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline_);
+		slices[0].counters.pipelineBinds++;
+
+		SetViewportAndScissor(cmd, drawExtent_);
+
+	    // Bind a fallback texture (error checkerboard image)
+	    VkDescriptorSet imageSet;
+	    {
+	        VkDescriptorWriter imgWrite;
+	        imgWrite.WriteImage(0, errorCheckerboardImage_.imageView, defaultSamplerNearest_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	        imageSet = descriptorCache_.Get(vd.device, singleImageDescriptorLayout_, imgWrite);
+	    }
+	    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineLayout_, 0, 1, &imageSet, 0, nullptr);
+		slices[0].counters.descriptorBinds++;
+
+		RecordGeometryDraws(cmd, 0, drawCount, descriptors, slices[0]);
+	}
+
+    // End rendering
+    vkCmdEndRendering(cmd);
+
+	//stats
+	GpuProfiler::PassCounters& counters = gpuProfiler_.Counters();
+	for (const GeometrySlice& slice : slices)
+	{
+		counters += slice.counters;
+		stats.drawcallCount += static_cast<int>(slice.counters.draws + slice.counters.indirectDraws);
+		stats.triCout += static_cast<int>(slice.triangles);
+	}
+
+	// Clear surfaces after drawing
+	mainDrawContext.OpaqueSurfaces.clear();
+	mainDrawContext.TransparentSurfaces.clear();
+}
+
+void VkEngine::RecordGeometryDraws(VkCommandBuffer cmd, u32 begin, u32 end, const GeometryDescriptors& descriptors,
+                                   GeometrySlice& slice) const
+{
+	// Buffer bindings aren't inherited either, bind it once and only move set offsets below
+	if (descriptors.buffer)
+	{
+		descriptors.buffer->BindBuffer(cmd);
+	}
+
+	// Nothing is inherited by a secondary command buffer, so the first draw binds everything it needs
+	const MaterialPipeline* lastPipeline = nullptr;
+	const MaterialInstance* lastMaterial = nullptr;
 	VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+	bool bindlessSetBound = false;
 
-    auto draw = [&](const RenderObject& r)
-    {
-	    if (r.material != lastMaterial)
+	const bool useBindless = settings_.bindless && bindless_.IsValid();
+	GpuProfiler::PassCounters& counters = slice.counters;
+
+	const u32 opaqueCount = static_cast<u32>(mainDrawContext.OpaqueSurfaces.size());
+	for (u32 i = begin; i < end; i++)
+	{
+		const RenderObject& r = i < opaqueCount
+			? mainDrawContext.OpaqueSurfaces[i]
+			: mainDrawContext.TransparentSurfaces[i - opaqueCount];
+
+	    // Bindless pipelines compile in the background, draw with the descriptor set path until they are ready
+	    const bool bindless = useBindless && r.material->bindlessPipeline != nullptr &&
+	                          r.material->bindlessPipeline->pipeline != VK_NULL_HANDLE;
+	    if (bindless)
+	    {
+		    // All bindless pipelines share one layout, so sets 0 and 1 survive pipeline switches
+		    if (r.material->bindlessPipeline != lastPipeline)
+		    {
+			    lastPipeline = r.material->bindlessPipeline;
+			    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->pipeline);
+			    SetViewportAndScissor(cmd, drawExtent_);
+			    counters.pipelineBinds++;
+		    }
+		    if (!bindlessSetBound)
+		    {
+			    VkDescriptorSet sets[] = { descriptors.scene, bindless_.Set() };
+			    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->layout, 0, 2, sets, 0,
+			                            nullptr);
+			    bindlessSetBound = true;
+			    counters.descriptorBinds++;
+		    }
+		    lastMaterial = nullptr;
+	    }
+	    else if (r.material != lastMaterial)
 	    {
 		    lastMaterial = r.material;
 		    //rebind pipeline and descriptors if the material changed
@@ -1400,52 +2638,84 @@ void VkEngine::DrawGeometry(VkCommandBuffer cmd)
 		    {
 			    lastPipeline = r.material->pipeline;
 			    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->pipeline);
-			    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 0, 1,
-			                            &globalDescriptor, 0, nullptr);
+			    if (descriptors.buffer)
+			    {
+				    descriptors.buffer->SetOffset(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 0,
+				                                  descriptors.sceneBuffer);
+			    }
+			    else
+			    {
+				    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 0, 1,
+				                            &descriptors.scene, 0, nullptr);
+			    }
 
 		    	SetViewportAndScissor(cmd, drawExtent_);
+			    counters.pipelineBinds++;
+			    counters.descriptorBinds++;
 		    }
 
-		    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 1, 1,
-		                            &r.material->materialSet, 0, nullptr);
+		    if (descriptors.buffer)
+		    {
+			    descriptors.buffer->SetOffset(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 1,
+			                                  descriptors.materials[i]);
+		    }
+		    else
+		    {
+			    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 1, 1,
+			                            &r.material->materialSet, 0, nullptr);
+		    }
+		    bindlessSetBound = false;
+		    counters.descriptorBinds++;
 	    }
 	    //rebind index buffer if needed
 	    if (r.indexBuffer != lastIndexBuffer)
 	    {
 		    lastIndexBuffer = r.indexBuffer;
 		    vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		    counters.indexBufferBinds++;
 	    }
 	    // calculate final mesh matrix
-	    GPUDrawPushConstants pushConstants{
-		    .worldMatrix = r.transform,
-		    .vertexBuffer = r.vertexBufferAddress
-	    };
-
-	    vkCmdPushConstants(cmd, r.material->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
-	                       sizeof(GPUDrawPushConstants), &pushConstants);
-
-	    vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
-	    //stats
-	    stats.drawcallCount++;
-	    stats.triCout += r.indexCount / 3;
-    };
-
-	for (auto& r : mainDrawContext.OpaqueSurfaces)
-	{
-		draw(r);
-	}
+	    if (bindless)
+	    {
+		    GPUBindlessDrawPushConstants pushConstants{
+			    .worldMatrix = r.transform,
+			    .vertexBuffer = r.vertexBufferAddress,
+			    .materialIndex = r.material->bindlessIndex
+		    };
+
+		    vkCmdPushConstants(cmd, lastPipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+		                       sizeof(GPUBindlessDrawPushConstants), &pushConstants);
+		    counters.pushConstantBytes += sizeof(GPUBindlessDrawPushConstants);
+	    }
+	    else
+	    {
+		    GPUDrawPushConstants pushConstants{
+			    .worldMatrix = r.transform,
+			    .vertexBuffer = r.vertexBufferAddress
+		    };
+
+		    vkCmdPushConstants(cmd, r.material->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+		                       sizeof(GPUDrawPushConstants), &pushConstants);
+		    counters.pushConstantBytes += sizeof(GPUDrawPushConstants);
+	    }
 
-	for (auto& r : mainDrawContext.TransparentSurfaces)
-	{
-		draw(r);
+	    if (r.clusterDrawIndex != RenderObject::NO_CLUSTER_DRAW)
+	    {
+		    // one command per surviving meshlet, the count was written by CullMeshlets
+		    vkCmdDrawIndexedIndirectCount(cmd, clusterCommandBuffer_.buffer,
+		                                  r.clusterCommandOffset * sizeof(VkDrawIndexedIndirectCommand),
+		                                  clusterCountBuffer_.buffer, r.clusterDrawIndex * sizeof(u32), r.meshletCount,
+		                                  sizeof(VkDrawIndexedIndirectCommand));
+		    counters.indirectDraws++;
+	    }
+	    else
+	    {
+		    vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
+		    counters.draws++;
+		    counters.instances++;
+	    }
+	    slice.triangles += r.indexCount / 3;
 	}
-
-	// Clear surfaces after drawing
-	mainDrawContext.OpaqueSurfaces.clear();
-	mainDrawContext.TransparentSurfaces.clear();
-
-    // End rendering
-    vkCmdEndRendering(cmd);
 }
 
 void VkEngine::InitDefaultData()
@@ -1519,7 +2789,7 @@ void VkEngine::InitDefaultData()
         // Allocate buffer for material constants (color and metallic-roughness)
         AllocatedBuffer materialConstants = CreateBuffer(
             sizeof(GLTFMetallicRoughness::MaterialConstants),
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
             VMA_MEMORY_USAGE_CPU_TO_GPU
         );
 
@@ -1556,20 +2826,22 @@ void VkEngine::InitDefaultData()
     // Add final destruction callbacks for all resources
     mainDeletionQueue_.pushFunction([=, this]()
     {
+        descriptorCache_.Invalidate(defaultSamplerNearest_);
+        descriptorCache_.Invalidate(defaultSamplerLinear_);
         vkDestroySampler(vd.device, defaultSamplerNearest_, nullptr);
         vkDestroySampler(vd.device, defaultSamplerLinear_, nullptr);
 
-        VkImages::DestroyImage(whiteImage_, vd.device, allocator_);
-        VkImages::DestroyImage(greyImage_, vd.device, allocator_);
-        VkImages::DestroyImage(blackImage_, vd.device, allocator_);
-        VkImages::DestroyImage(errorCheckerboardImage_, vd.device, allocator_);
+        DestroyImage(whiteImage_);
+        DestroyImage(greyImage_);
+        DestroyImage(blackImage_);
+        DestroyImage(errorCheckerboardImage_);
 		},
 		"Images");
 }
 
-void VkEngine::UpdateScene()
+void VkEngine::UpdateScene(RenderPacket& packet)
 {
-	mainDrawContext.OpaqueSurfaces.clear();
+	DrawContext& drawContext = packet.drawContext;
 	Timer sceneTimer("Update Scene", timingResults);
 
 	// Accumulate the delta time
@@ -1590,42 +2862,134 @@ void VkEngine::UpdateScene()
 		frameCount = 0;
 	}
 
-	camera_.Update(deltaTime);
+	// Run the simulation steps this frame's time pays for, moved nodes publish their proxies once at the end
+	{
+		Timer simulationTimer("Simulation", timingResults);
+		simulationClock_.SetRate(static_cast<f64>(simulationRate_));
+		const u32 steps = simulationClock_.Advance(deltaTime);
+		for (u32 i = 0; i < steps; i++)
+		{
+			SimulateStep(static_cast<f32>(simulationClock_.StepSeconds()));
+		}
+		renderProxies_.Publish();
+	}
+	const f32 alpha = simulationClock_.Alpha();
+	packet.interpolation = alpha;
 
-	// Get the updated view matrix
-	glm::mat4 view = camera_.GetViewMatrix();
+	// Get the view matrix between the last two steps
+	Camera renderCamera = camera_;
+	renderCamera.position = glm::mix(previousCameraPosition_, camera_.position, alpha);
+	glm::mat4 view = renderCamera.GetViewMatrix();
 
 	// Calculate the aspect ratio for projection
-	aspectRatio = static_cast<f32>(windowContext_->screenWidth) / static_cast<f32>(windowContext_->screenWidth > 0 ? windowContext_->screenHeight : 1);
+	const VkExtent3D resolution = sceneResolution_; // the render thread owns the swapchain
+	aspectRatio = static_cast<f32>(resolution.width) / static_cast<f32>(resolution.width > 0 ? resolution.height : 1);
 
 	// Correct the perspective projection matrix
-	glm::mat4 projection = glm::perspective(glm::radians(fov), aspectRatio, nearPlane, farPlane);
+	glm::mat4 projection = glm::perspective(glm::radians(fov), aspectRatio, uiSettings_.nearPlane, farPlane);
 	projection[1][1] *= -1; // Correct for Vulkan Y-axis inversion
 
 	// Update scene data matrices
-	sceneData.view = view;
-	sceneData.proj = projection;
-	sceneData.viewproj = projection * view;
+	GPUSceneData& frameScene = packet.sceneData;
+	frameScene.view = view;
+	frameScene.proj = projection;
+	frameScene.viewproj = projection * view;
 
     // Set default lighting for the scene
-    sceneData.ambientColor = glm::vec4(0.1f);  // Set ambient light color
-    sceneData.sunlightColor = glm::vec4(1.f);  // Set sunlight color
-    sceneData.sunlightDirection = glm::vec4(0, 1, 0.5, 1.f);  // Sunlight direction in the scene
+    frameScene.ambientColor = glm::vec4(0.1f);  // Set ambient light color
+    frameScene.sunlightColor = glm::vec4(1.f);  // Set sunlight color
+    frameScene.sunlightDirection = glm::vec4(0, 1, 0.5, 1.f);  // Sunlight direction in the scene
+
+	// Only says whether LODs are on, Draw works out the scale from the projection and extent it renders with
+	drawContext.view = view;
+	drawContext.lodProjScale = lodEnabled ? 1.f : 0.f;
+	drawContext.lodErrorPixels = lodBias;
+	packet.settings = uiSettings_;
+	uiSettings_.dumpGpuTimings = false;
+	sceneUpdateMs_ = sceneTimer.Elapsed() * 1000.f;
+}
+
+void VkEngine::SimulateStep(f32 dt)
+{
+	previousCameraPosition_ = camera_.position;
+	camera_.Update(dt);
+
+	// Only nodes moved in this step write their proxies
+	renderProxies_.BeginStep();
+	loadedScenes["structure"]->UpdateProxies(glm::mat4{ 1.f }, renderProxies_);
+}
+
+void VkEngine::BuildDrawList(const RenderProxies::Snapshot& proxies, f32 interpolation)
+{
+	Timer buildTimer("Build Draw List", renderTimingResults_);
+	mainDrawContext.OpaqueSurfaces.clear();
+	mainDrawContext.TransparentSurfaces.clear();
+	mainDrawContext.lodTrianglesSaved = 0;
+
+	// Proxies at rest skip the blend
+	auto transformAt = [&](u32 proxy)
+	{
+		const glm::mat4& previous = proxies.previousTransforms[proxy];
+		const glm::mat4& current = proxies.transforms[proxy];
+		return previous == current ? current : RenderProxies::Interpolate(previous, current, interpolation);
+	};
+	// Culled and LOD picked where the proxy is drawn, between its last two steps
+	auto addProxy = [&](u32 proxy)
+	{
+		const glm::mat4 transform = transformAt(proxy);
+		const GeoSurface& surface = *proxies.surfaces[proxy];
+		const glm::vec4 sphere(glm::vec3(transform * glm::vec4(surface.bounds.origin, 1.f)), proxies.bounds[proxy].w);
+		AddSurface(*proxies.meshes[proxy], surface, proxies.materials[proxy], transform, sphere, mainDrawContext);
+	};
+
+	mainDrawContext.frustum = nullptr;
+	if (frustumCuller_.enabled)
+	{
+		frustumCuller_.BeginFrame(sceneData.view, sceneData.proj, settings_.nearPlane);
+		mainDrawContext.frustum = &frustumCuller_;
+	}
 
-    // Draw the Suzanne (monkey head) mesh node
-    // loadedNodes["Suzanne"]->Draw(glm::mat4{1.f}, mainDrawContext);
+	// Rasterize the occluders first so the surfaces can be rejected
+	mainDrawContext.occlusion = nullptr;
+	if (occlusionCuller_.enabled)
 	{
-		Timer drawTimer("Draw Structure", timingResults);
-		loadedScenes["structure"]->Draw(glm::mat4{ 1.f }, mainDrawContext);
+		Timer occlusionTimer("Occlusion Culling", renderTimingResults_);
+		occlusionCuller_.BeginFrame(sceneData.viewproj);
+		for (u32 i = 0; i < proxies.Count(); i++)
+		{
+			// Occluders belong to the mesh, its first surface adds them
+			const MeshAsset& mesh = *proxies.meshes[i];
+			if (!mesh.occluderIndices.empty() && proxies.surfaces[i] == &mesh.surfaces.front())
+			{
+				occlusionCuller_.AddOccluder(mesh.occluderPositions, mesh.occluderIndices, transformAt(i));
+			}
+		}
+		occlusionCuller_.Rasterize(&jobSystem_);
+		mainDrawContext.occlusion = &occlusionCuller_;
 	}
 
-    // // Optional: Draw a line of cubes for visual debugging or testing
-    // for (int x = -3; x < 3; x++)
-    // {
-    //     glm::mat4 scale = glm::scale(glm::vec3{0.2f});  // Set cube scale
-    //     glm::mat4 translation = glm::translate(glm::vec3{x, 1, 0});  // Set cube position
-    //     loadedNodes["Cube"]->Draw(translation * scale, mainDrawContext);  // Draw the cube
-    // }
+	mainDrawContext.OpaqueSurfaces.reserve(proxies.Count());
+	if (settings_.retainedStaticDraws)
+	{
+		// Static proxies come out of the retained list, only the dynamic ones are generated
+		if (staticDrawList_.Update(proxies))
+		{
+			frustumCuller_.ResetStatic(staticDrawList_.SurfaceCount());
+		}
+		staticDrawList_.Emit(mainDrawContext);
+		for (const u32 i : staticDrawList_.Dynamic())
+		{
+			addProxy(i);
+		}
+	}
+	else
+	{
+		for (u32 i = 0; i < proxies.Count(); i++)
+		{
+			addProxy(i);
+		}
+	}
+	stats.lodTrisSaved = static_cast<int>(mainDrawContext.lodTrianglesSaved);
 
     // Log the number of rendered objects if a model was drawn
     if (modelDrawn)
@@ -1636,80 +3000,342 @@ void VkEngine::UpdateScene()
 }
 
 
-void VkEngine::Draw()
+void VkEngine::WaitForTimeline(u64 value) const
 {
-	Timer drawTime("DrawTime", timingResults);
+	VkSemaphoreWaitInfo waitInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &frameTimeline_,
+		.pValues = &value
+	};
+	VK_CHECK(vkWaitSemaphores(vd.device, &waitInfo, UINT64_MAX));
+}
+
+void VkEngine::ApplySettings(const RenderSettings& settings)
+{
+	// Limits first, Reset clamps to them
+	dynamicResolution_.targetHz = settings.targetHz;
+	dynamicResolution_.minScale = settings.minScale;
+	dynamicResolution_.maxScale = settings.maxScale;
+	if (settings.dynamicResolution && !dynamicResolution_.enabled)
+	{
+		dynamicResolution_.Reset(renderScale);
+	}
+	dynamicResolution_.enabled = settings.dynamicResolution;
+	if (!dynamicResolution_.enabled)
+	{
+		renderScale = settings.renderScale;
+	}
+
+	frustumCuller_.enabled = settings.frustumCulling;
+	frustumCuller_.temporal = settings.temporalFrustumCache;
+	occlusionCuller_.enabled = settings.occlusionCulling;
+	gpuProfiler_.pipelineStatistics = settings.pipelineStatistics;
+	if (settings.dumpGpuTimings)
+	{
+		gpuProfiler_.WriteJson("gpu_timings.json");
+	}
+	settings_ = settings;
+	settings_.bindless = settings.bindless && bindlessSupported_;
+	settings_.meshletCulling = settings.meshletCulling && meshletCullingSupported_;
+}
+
+void VkEngine::PublishStats()
+{
+	RenderStats published
+	{
+		.stats = stats,
+		.drawExtent = drawExtent_,
+		.renderScale = renderScale,
+		.dynamicResolutionGpuMs = dynamicResolution_.LastGpuMs(),
+		.dynamicResolutionBudgetMs = dynamicResolution_.BudgetMs(),
+		.framesInFlight = framesInFlight_,
+		.timings = renderTimingResults_,
+		.gpuProfilerEnabled = gpuProfiler_.IsEnabled(),
+		.pipelineStatisticsSupported = gpuProfiler_.PipelineStatisticsSupported(),
+		.frameCounters = gpuProfiler_.FrameCounters(),
+		.gpuScopes = gpuProfiler_.Stats(),
+		.graphPasses = renderGraph_.PassCount(),
+		.graphCulled = renderGraph_.CulledCount(),
+		.graphBarriers = renderGraph_.BarrierCount(),
+		.graphBarrierBatches = renderGraph_.BarrierBatchCount(),
+		.materialPermutations = metalRoughMaterial.PermutationCount(),
+		.descriptorCacheSize = descriptorCache_.Size(),
+		.descriptorCacheHits = descriptorCache_.Hits(),
+		.descriptorCacheMisses = descriptorCache_.Misses(),
+		.descriptorBufferUsed = GetCurrentFrame().frameDescriptorBuffer_.Used(),
+		.descriptorBufferCapacity = GetCurrentFrame().frameDescriptorBuffer_.Capacity(),
+		.bindless = settings_.bindless && bindless_.IsValid(),
+		.bindlessMaterials = bindless_.MaterialCount(),
+		.bindlessTextures = bindless_.TextureCount(),
+		.geometrySlices = geometrySlices_,
+		.staticSurfaces = staticDrawList_.SurfaceCount(),
+		.staticCells = staticDrawList_.CellCount(),
+		.staticCulledCells = staticDrawList_.CulledCells(),
+		.staticRebuilds = staticDrawList_.Rebuilds(),
+		.staticDynamic = staticDrawList_.Dynamic().size(),
+		.clusterDraws = clusterDrawCount_,
+		.clusterMeshlets = clusterMeshletCount_,
+		.frustum = frustumCuller_.GetStats(),
+		.occlusion = occlusionCuller_.GetStats(),
+		.transientPeakBytes = renderGraph_.Transients().PeakBytes(),
+		.transientNaiveBytes = renderGraph_.Transients().NaiveBytes()
+	};
+
+	// Built outside the lock, the swap is all the main thread can wait on
+	std::lock_guard lock(renderStateMutex_);
+	std::swap(publishedStats_, published);
+}
+
+void VkEngine::Draw(RenderPacket& packet)
+{
+	Timer drawTime("DrawTime", renderTimingResults_);
+	ApplySettings(packet.settings);
+	const u32 requestedFrames = static_cast<u32>(std::clamp(settings_.framesInFlight, 1, static_cast<int>(MAX_FRAMES_IN_FLIGHT)));
+
+	const auto waitStart = std::chrono::high_resolution_clock::now();
+	if (requestedFrames != framesInFlight_)
+	{
+		// The slot mapping changes with the count, so everything submitted has to finish first
+		WaitForTimeline(frameNumber_);
+
+		// Slots past the new count would otherwise hold their deletions and descriptors until the count grows again
+		for (FrameData& slot : frames_)
+		{
+			slot.deletionQueue_.Flush();
+			slot.frameDescriptors_.ClearPools(vd.device);
+			slot.frameDescriptorBuffer_.Reset();
+		}
+	}
+	else if (frameNumber_ >= framesInFlight_)
+	{
+		// The frame that last used this slot signaled frameNumber_ + 1 - framesInFlight_ when it finished
+		WaitForTimeline(frameNumber_ + 1 - framesInFlight_);
+	}
+	const f32 cpuWaitTime = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+
+	framesInFlight_ = requestedFrames;
+	stats.cpuWaitTime = cpuWaitTime;
+
 	TracyVkZone(tracyContext_, GetCurrentFrame().mainCommandBuffer_, "Frame Start"); // TODO: this crashes when Tracy is attached
-    VK_CHECK(vkWaitForFences(vd.device, 1, &GetCurrentFrame().renderFence_, true, UINT64_MAX));
 
     GetCurrentFrame().deletionQueue_.Flush();
 	GetCurrentFrame().frameDescriptors_.ClearPools(vd.device);
+	GetCurrentFrame().frameDescriptorBuffer_.Reset();
+	bindless_.BeginFrame(frameNumber_, framesInFlight_);
+	pipelineRegistry_.PublishCompleted();
+	descriptorCache_.BeginFrame(vd.device, frameNumber_);
 
-    VK_CHECK(vkResetFences(vd.device, 1, &GetCurrentFrame().renderFence_));
-
-    u32 swapchainImageIndex;
-	VkResult e = vkAcquireNextImageKHR(vd.device, swapchain_, 1000000000, GetCurrentFrame().swapChainSemaphore_, nullptr, &swapchainImageIndex);
-	if (e == VK_ERROR_OUT_OF_DATE_KHR)
+    u32 swapchainImageIndex = 0;
+	if (!headless_)
 	{
-		resizeRequested_ = true;
-		return ;
+		VkResult e = vkAcquireNextImageKHR(vd.device, swapchain_, 1000000000, GetCurrentFrame().swapChainSemaphore_, nullptr, &swapchainImageIndex);
+		if (e == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			resizeRequested_ = true;
+			return ;
+		}
 	}
+
     VkCommandBuffer cmd = GetCurrentFrame().mainCommandBuffer_;
 
     VK_CHECK(vkResetCommandBuffer(cmd, 0));
 
     VkCommandBufferBeginInfo cmdBeginInfo = VkInfo::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-	drawExtent_.height = static_cast<u32>(
-		std::min(static_cast<f32>(swapchainExtent_.height), static_cast<f32>(drawImage_.imageExtent.height)) * renderScale);
-	drawExtent_.width = static_cast<u32>(
-		std::min(static_cast<f32>(swapchainExtent_.width), static_cast<f32>(drawImage_.imageExtent.width)) * renderScale);
-
 	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
-	// Transition draw image to GENERAL layout for compute shader
-	VkImages::TransitionImage(cmd, drawImage_.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-
-	// Draw the background using compute shader
-	DrawBackground(cmd);
+	stats.drawcallCount = 0;
+	stats.triCout = 0;
 
-	// Transition draw image for color attachment
-	VkImages::TransitionImage(cmd, drawImage_.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	// The frame that last used this slot has finished, so the timestamps it wrote are ready
+	gpuProfiler_.BeginFrame(cmd, static_cast<u32>(frameNumber_ % framesInFlight_));
+	stats.meshDrawtime = gpuProfiler_.AverageMs("Geometry");
+	stats.gpuFrametime = gpuProfiler_.AverageMs("Frame");
+	const u32 frameScope = gpuProfiler_.BeginScope(cmd, "Frame");
 
-	// Transition depth image for depth attachment
-	VkImages::TransitionImage(cmd, depthImage_.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
-
-	// Draw geometry
-	DrawGeometry(cmd);
-
-	// Transition the draw image to TRANSFER_SRC_OPTIMAL layout for copying
-	VkImages::TransitionImage(cmd, drawImage_.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	// The newest GPU time is framesInFlight_ frames old, the controller's gains are small enough for that delay.
+	// Headless runs keep a fixed resolution so their images and timings stay comparable.
+	if (dynamicResolution_.enabled && !headless_ && gpuProfiler_.IsEnabled())
+	{
+		renderScale = dynamicResolution_.Update(gpuProfiler_.LastMs("Frame"));
+	}
+	// The draw targets follow the swapchain and the scale. Under dynamic resolution they are sized for the largest
+	// scale it may pick, so its small steps only move drawExtent_ instead of reallocating every few frames.
+	auto scaled = [this](f32 scale)
+	{
+		return VkExtent2D
+		{
+			std::max(static_cast<u32>(static_cast<f32>(swapchainExtent_.width) * scale), 1u),
+			std::max(static_cast<u32>(static_cast<f32>(swapchainExtent_.height) * scale), 1u)
+		};
+	};
+	ResizeDrawTargets(scaled(dynamicResolution_.enabled && !headless_ ? std::max(dynamicResolution_.maxScale, renderScale)
+	                                                                  : renderScale));
+	drawExtent_ = scaled(renderScale);
+	drawExtent_.width = std::min(drawExtent_.width, drawImage_.imageExtent.width);
+	drawExtent_.height = std::min(drawExtent_.height, drawImage_.imageExtent.height);
+
+	// This frame's camera, the scene is the newest proxy snapshot
+	sceneData = packet.sceneData;
+	mainDrawContext.view = packet.drawContext.view;
+	// LOD selection works in pixels of the draw extent, through the same projection the frame is rendered with
+	mainDrawContext.lodProjScale = packet.drawContext.lodProjScale > 0.f
+		? std::abs(sceneData.proj[1][1]) * 0.5f * static_cast<f32>(drawExtent_.height)
+		: 0.f;
+	mainDrawContext.lodErrorPixels = packet.drawContext.lodErrorPixels;
+	BuildDrawList(renderProxies_.Acquire(), packet.interpolation);
+
+	// Every pass declares what it touches, the graph places the barriers between them
+	renderGraph_.Reset();
+	const RenderGraph::Resource drawImage = renderGraph_.ImportImage("Draw Image", { .image = drawImage_.image });
+	// Dead after the geometry pass, the upscale targets below share its memory
+	const RenderGraph::Resource depthImage = renderGraph_.CreateImage("Depth Image",
+		{
+			.extent = depthImage_.imageExtent,
+			.format = depthImage_.imageFormat,
+			.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+			.aspect = VK_IMAGE_ASPECT_DEPTH_BIT
+		});
+	renderGraph_.AddPass("Background", [this](VkCommandBuffer c) { DrawBackground(c); })
+		.Write(drawImage, RenderGraph::Usage::ComputeStorage);
+
+	// Build this frame's per meshlet draws before any rendering starts
+	const bool meshletCull = PrepareMeshletCull();
+	RenderGraph::Resource clusterCommands = 0;
+	RenderGraph::Resource clusterCounts = 0;
+	if (meshletCull)
+	{
+		clusterCommands = renderGraph_.ImportBuffer("Cluster Commands", clusterCommandBuffer_.buffer);
+		clusterCounts = renderGraph_.ImportBuffer("Cluster Counts", clusterCountBuffer_.buffer);
+		renderGraph_.AddPass("Meshlet Cull", [this](VkCommandBuffer c) { CullMeshlets(c); })
+			.Write(clusterCommands, RenderGraph::Usage::ComputeStorage)
+			.Write(clusterCounts, RenderGraph::Usage::TransferDst)
+			.Write(clusterCounts, RenderGraph::Usage::ComputeStorage);
+	}
 
-	// Transition the swapchain image to TRANSFER_DST_OPTIMAL layout for copying
-	VkImages::TransitionImage(cmd, swapchainImages_[swapchainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	RenderGraph::Pass& geometry = renderGraph_.AddPass("Geometry", [this](VkCommandBuffer c) { DrawGeometry(c); })
+		.Write(drawImage, RenderGraph::Usage::ColorAttachment)
+		.Write(depthImage, RenderGraph::Usage::DepthAttachment);
+	if (meshletCull)
+	{
+		geometry.Read(clusterCommands, RenderGraph::Usage::IndirectRead)
+		        .Read(clusterCounts, RenderGraph::Usage::IndirectRead);
+	}
 
-	// Copy image from drawImage_.image to swapchainImages_[swapchainImageIndex]
-	VkImages::CopyImageToImage(cmd, drawImage_.image, swapchainImages_[swapchainImageIndex], drawExtent_, swapchainExtent_);
+	if (headless_)
+	{
+		// The draw image is the output, nothing reads it unless this frame is read back
+		geometry.KeepAlive();
+		if (packet.readback)
+		{
+			const RenderGraph::Resource readback = renderGraph_.ImportBuffer("Readback", readbackBuffer_.buffer);
+			renderGraph_.AddPass("Readback", [this](VkCommandBuffer c) { CopyDrawImageToReadback(c); })
+				.Read(drawImage, RenderGraph::Usage::TransferSrc)
+				.Write(readback, RenderGraph::Usage::TransferDst)
+				.KeepAlive();
+		}
+	}
+	else
+	{
+		const RenderGraph::Resource swapchainImage = renderGraph_.ImportImage("Swapchain Image",
+			{
+				.image = swapchainImages_[swapchainImageIndex],
+				.waitStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+			});
+
+		// Below full resolution the picture is upscaled and sharpened at swapchain size, the blit then only copies.
+		// Under dynamic resolution both passes stay in the graph at every scale and sharpness, otherwise crossing
+		// 1.0 would change the transient set and place every transient again. At 1:1 upscale.comp copies texels
+		// exactly instead of filtering, and sharpen.comp is an identity at a sharpness of 0.
+		const bool belowFull = drawExtent_.width < swapchainExtent_.width || drawExtent_.height < swapchainExtent_.height;
+		const bool stableUpscale = dynamicResolution_.enabled;
+		RenderGraph::Resource presentSource = drawImage;
+		VkExtent2D presentExtent = drawExtent_;
+		if (settings_.computeUpscale && (belowFull || stableUpscale))
+		{
+			const RenderGraph::ImageDesc upscaledDesc
+			{
+				.extent = { swapchainExtent_.width, swapchainExtent_.height, 1 },
+				.format = drawImage_.imageFormat,
+				.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+			};
+			const RenderGraph::Resource upscaled = renderGraph_.CreateImage("Upscaled Image", upscaledDesc);
+			renderGraph_.AddPass("Upscale", [this, upscaled](VkCommandBuffer c)
+			{
+				DispatchUpscale(c, upscalePipeline_, drawImage_.imageView, drawExtent_,
+				                renderGraph_.GetImageView(upscaled), swapchainExtent_);
+			})
+				.Read(drawImage, RenderGraph::Usage::ComputeSampled)
+				.Write(upscaled, RenderGraph::Usage::ComputeStorage);
+			presentSource = upscaled;
+			presentExtent = swapchainExtent_;
+
+			if (settings_.upscaleSharpness > 0.f || stableUpscale)
+			{
+				const RenderGraph::Resource sharpened = renderGraph_.CreateImage("Sharpened Image", upscaledDesc);
+				renderGraph_.AddPass("Sharpen", [this, upscaled, sharpened](VkCommandBuffer c)
+				{
+					DispatchUpscale(c, sharpenPipeline_, renderGraph_.GetImageView(upscaled), swapchainExtent_,
+					                renderGraph_.GetImageView(sharpened), swapchainExtent_);
+				})
+					.Read(upscaled, RenderGraph::Usage::ComputeSampled)
+					.Write(sharpened, RenderGraph::Usage::ComputeStorage);
+				presentSource = sharpened;
+			}
+		}
 
-	// Transition the swapchain image to COLOR_ATTACHMENT_OPTIMAL layout for rendering ImGui
-	VkImages::TransitionImage(cmd, swapchainImages_[swapchainImageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		renderGraph_.AddPass("Blit", [this, swapchainImageIndex, presentSource, presentExtent](VkCommandBuffer c)
+		{
+			VkImages::CopyImageToImage(c, renderGraph_.GetImage(presentSource), swapchainImages_[swapchainImageIndex],
+			                           presentExtent, swapchainExtent_);
+		})
+			.Read(presentSource, RenderGraph::Usage::TransferSrc)
+			.Write(swapchainImage, RenderGraph::Usage::TransferDst);
 
-	// Draw the ImGui interface
-	DrawImGui(cmd, swapchainImageViews_[swapchainImageIndex]);
+		renderGraph_.AddPass("ImGui", [this, swapchainImageIndex, &packet](VkCommandBuffer c)
+		{
+			DrawImGui(c, swapchainImageViews_[swapchainImageIndex], &packet.uiDrawData);
+		})
+			.Write(swapchainImage, RenderGraph::Usage::ColorAttachment);
+	}
 
-	// Transition the swapchain image to PRESENT_SRC_KHR layout for presentation
-	VkImages::TransitionImage(cmd, swapchainImages_[swapchainImageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	renderGraph_.Compile(frameNumber_);
+	depthImage_.image = renderGraph_.GetImage(depthImage);
+	depthImage_.imageView = renderGraph_.GetImageView(depthImage);
+	renderGraph_.Execute(cmd);
 
+	gpuProfiler_.EndScope(cmd, frameScope);
 	VK_CHECK(vkEndCommandBuffer(cmd));
+	PublishStats();
 
     VkCommandBufferSubmitInfo cmdinfo = VkInfo::CommandBufferSubmitInfo(cmd);
 
+	VkSemaphoreSubmitInfo timelineInfo = VkInfo::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frameTimeline_);
+	timelineInfo.value = frameNumber_ + 1;
+
+	if (headless_)
+	{
+		// No acquire to wait on and no present to signal, the timeline alone paces the frames
+		VkSubmitInfo2 submit = VkInfo::SubmitInfo(&cmdinfo, &timelineInfo, nullptr);
+		VK_CHECK(vkQueueSubmit2(graphicsQueue_, 1, &submit, VK_NULL_HANDLE));
+		frameNumber_++;
+		return;
+	}
+
     VkSemaphoreSubmitInfo waitInfo = VkInfo::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, GetCurrentFrame().swapChainSemaphore_);
-    VkSemaphoreSubmitInfo signalInfo = VkInfo::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, GetCurrentFrame().renderSemaphore_);
+    VkSemaphoreSubmitInfo signalInfos[]
+    {
+	    VkInfo::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, GetCurrentFrame().renderSemaphore_),
+	    timelineInfo
+    };
 
-    VkSubmitInfo2 submit = VkInfo::SubmitInfo(&cmdinfo, &signalInfo, &waitInfo);
+    VkSubmitInfo2 submit = VkInfo::SubmitInfo(&cmdinfo, signalInfos, &waitInfo);
+    submit.signalSemaphoreInfoCount = static_cast<u32>(std::size(signalInfos));
 
-    VK_CHECK(vkQueueSubmit2(graphicsQueue_, 1, &submit, GetCurrentFrame().renderFence_));
+    VK_CHECK(vkQueueSubmit2(graphicsQueue_, 1, &submit, VK_NULL_HANDLE));
 	TracyVkCollect(tracyContext_, GetCurrentFrame().mainCommandBuffer_);
 
     VkPresentInfoKHR presentInfo_
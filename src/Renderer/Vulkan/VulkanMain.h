@@ -6,27 +6,48 @@
 #ifdef VULKAN_BUILD
 
 #include "VulkanDescriptor.h"
+#include "VulkanDescriptorBuffer.h"
+#include "VulkanGpuProfiler.h"
 #include "VulkanHeader.h"
 #include "VulkanInitializers.h"
 #include "VulkanLoader.h"
 #include "VulkanMaterials.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanPipelineRegistry.h"
+#include "VulkanRenderGraph.h"
+#include "VulkanRenderProxies.h"
 #include "VulkanSceneNode.h"
+#include "VulkanStaticDrawList.h"
 #include "../Camera.h"
+#include "../DynamicResolution.h"
+#include "../FrustumCullCache.h"
+#include "../OcclusionCuller.h"
+#include "../../Core/FixedTimestep.h"
 #include "../../Core/InputHandler.h"
+#include "../../Core/JobSystem.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
 
 // Vulkan Includes
 #include <tracy/TracyVulkan.hpp>
 
 namespace GraphicsAPI::Vulkan
 {
-	constexpr unsigned int FRAME_OVERLAP = 2;
+	// Per frame resources exist for this many frames, VkEngine::framesInFlight_ picks how many are used
+	constexpr u32 MAX_FRAMES_IN_FLIGHT = 3;
 
 	struct DeletionQueue
 	{
 		std::deque<std::pair<std::string, std::function<void()>>> deletors;
+		std::mutex mutex; // pipelines are created on worker threads at startup
 
 		void pushFunction(std::function<void()>&& function, const std::string& label = "")
 		{
+			std::lock_guard lock(mutex);
 			deletors.emplace_back(label, std::move(function));
 		}
 
@@ -63,6 +84,14 @@ namespace GraphicsAPI::Vulkan
 		glm::vec4 data4;
 	};
 
+	// Shared by upscale.comp and sharpen.comp
+	struct UpscalePushConstants
+	{
+		glm::vec2 sourceSize; // texels of the source holding the picture, from its top left corner
+		glm::vec2 targetSize;
+		f32       sharpness;
+	};
+
 	struct ComputeEffect
 	{
 		const char *name;
@@ -75,23 +104,31 @@ namespace GraphicsAPI::Vulkan
 
 	struct FrameData
 	{
+		// Binary, for the swapchain. Frame completion is tracked by VkEngine::frameTimeline_.
 		VkSemaphore swapChainSemaphore_{}, renderSemaphore_{};
-		VkFence renderFence_{};
 
 		VkCommandPool commandPool_{};
 		VkCommandBuffer mainCommandBuffer_{};
 
+		// Secondary command buffers for the geometry pass, one pool per recording slice so no two threads share one
+		std::vector<VkCommandPool> workerCommandPools_;
+		std::vector<VkCommandBuffer> workerCommandBuffers_;
+
 		DeletionQueue deletionQueue_;
 		DescriptorAllocatorGrowable frameDescriptors_;
+		DescriptorBufferAllocator frameDescriptorBuffer_; // used instead of the pools when descriptor buffers are supported
+		AllocatedBuffer sceneDataBuffer_{}; // persistently mapped, keeps the cached scene descriptor valid
 	};
 
 	struct EngineStats
 	{
 		float frametime;
-		int triCout;
-		int drawcallCount;
-		float sceneUpdateTime;
-		float meshDrawtime;
+		float cpuWaitTime; // ms the CPU blocked on the frame timeline before recording, the GPU bound part of a frame
+		int triCout;       // this frame, each surface counted at the LOD it was drawn with
+		int drawcallCount; // this frame
+		float meshDrawtime;    // GPU ms of the geometry pass, averaged by the profiler
+		float gpuFrametime;    // GPU ms of the whole command buffer, averaged by the profiler
+		int lodTrisSaved; // not in triCout, what full detail would have added on top of it
 
 	};
 
@@ -117,13 +154,114 @@ namespace GraphicsAPI::Vulkan
 	};
 
 
+	// What the UI can change that the render thread reads. The UI edits its own copy, UpdateScene hands it to Draw in
+	// the packet, so neither thread sees the other's copy mid frame.
+	struct RenderSettings
+	{
+		f32 renderScale = 1.0f;  // fixed scale, while dynamic resolution is on the UI shows the one it picked
+		bool dynamicResolution = true;
+		f32 targetHz = 60.f;
+		f32 minScale = 0.5f;
+		f32 maxScale = 1.0f;
+		bool computeUpscale = true; // below full resolution, upscale and sharpen instead of a linear blit
+		f32 upscaleSharpness = 0.8f;
+		int backgroundEffect = 0;
+		f32 nearPlane = 0.1f;
+		bool frustumCulling = true;
+		bool temporalFrustumCache = true;
+		bool occlusionCulling = true;
+		bool meshletCulling = true;
+		bool meshletConeCulling = true;
+		bool parallelRecording = true; // record big geometry passes into secondary command buffers on the job system
+		bool retainedStaticDraws = true; // reuse the static draw list, otherwise every proxy is rebuilt each frame
+		bool bindless = true;
+		bool pipelineStatistics = false;
+		int framesInFlight = 2; // fewer trades throughput for latency
+		bool dumpGpuTimings = false; // one shot, cleared once a packet carries it
+	};
+
+	// What the UI shows of the render thread, copied by Draw once a frame is recorded
+	struct RenderStats
+	{
+		EngineStats stats{};
+		VkExtent2D drawExtent{};
+		f32 renderScale = 1.f;
+		f32 dynamicResolutionGpuMs = 0.f;
+		f32 dynamicResolutionBudgetMs = 0.f;
+		u32 framesInFlight = 0;
+		std::unordered_map<std::string, float> timings; // render thread timers
+		bool gpuProfilerEnabled = false;
+		bool pipelineStatisticsSupported = false;
+		GpuProfiler::PassCounters frameCounters{};
+		std::vector<GpuProfiler::ScopeStats> gpuScopes;
+		u32 graphPasses = 0, graphCulled = 0, graphBarriers = 0, graphBarrierBatches = 0;
+		u32 materialPermutations = 0;
+		u32 descriptorCacheSize = 0, descriptorCacheHits = 0, descriptorCacheMisses = 0;
+		VkDeviceSize descriptorBufferUsed = 0, descriptorBufferCapacity = 0;
+		bool bindless = false;
+		u32 bindlessMaterials = 0, bindlessTextures = 0;
+		u32 geometrySlices = 0;
+		u32 staticSurfaces = 0, staticCells = 0, staticCulledCells = 0, staticRebuilds = 0;
+		size_t staticDynamic = 0;
+		u32 clusterDraws = 0, clusterMeshlets = 0;
+		FrustumCullCache::Stats frustum{};
+		OcclusionCuller::Stats occlusion{};
+		VkDeviceSize transientPeakBytes = 0, transientNaiveBytes = 0;
+	};
+
+	// One frame of work for the render thread, built by the main thread. Once submitted only the render thread touches
+	// it. The scene itself reaches the render thread through RenderProxies.
+	struct RenderPacket
+	{
+		GPUSceneData sceneData{};
+		DrawContext drawContext; // view and LOD settings, Draw adds the surfaces from the proxy snapshot
+		f32 interpolation = 1.f; // where the frame sits between the last two simulation steps, see FixedTimestep::Alpha
+		ImDrawData uiDrawData;  // clones of ImGui's lists, ImGui reuses its own on the next NewFrame
+		bool readback = false;  // headless, copy the draw image into the readback buffer
+		RenderSettings settings; // the UI's settings as of this frame
+
+		RenderPacket() = default;
+		RenderPacket(const RenderPacket&) = delete;
+		RenderPacket& operator=(const RenderPacket&) = delete;
+		~RenderPacket() { ReleaseUI(); }
+
+		void CaptureUI(const ImDrawData* drawData);
+		void ReleaseUI();
+	};
+
+	// Rendering without a window or swapchain, for automated frame time and image regression runs
+	struct HeadlessOptions
+	{
+		u32 width  = 1280;
+		u32 height = 720;
+		u32 frames = 300;
+		std::filesystem::path readbackPath;                   // binary PPM of the last frame, empty skips the readback
+		std::filesystem::path timingsPath = "gpu_timings.json"; // GPU profiler dump, empty skips it
+	};
+
+	struct MaterialWriteBenchmark
+	{
+		u32 materials{};
+		u32 runs{};
+		f64 perSetMs{};   // per run, one vkUpdateDescriptorSets per material set
+		f64 batchedMs{};  // per run, recording and the single flush
+		f64 flushMs{};    // per run, the flush alone
+	};
+
 	class VkEngine
 	{
 	public:
 		explicit VkEngine(Platform::WindowContext* winManager, const std::wstring& renderName = L" - Vulkan");
+		explicit VkEngine(const HeadlessOptions& options);
 		~VkEngine();
 
 		void Run();
+		// Renders options.frames frames into the draw image, returns false if the engine isn't headless or the
+		// readback failed
+		bool RunHeadless();
+		// Writes materialCount material sets runs times, one update call per set and then batched into a single
+		// Flush. Needs an initialized engine, headless is enough.
+		MaterialWriteBenchmark BenchmarkMaterialWrites(u32 materialCount, u32 runs);
 		void Cleanup();
 
 		// Initialization
@@ -139,13 +277,20 @@ namespace GraphicsAPI::Vulkan
 		void        InitBackgroundPipelines();
 		void        InitImgui();
 		void        InitMeshPipeline();
+		void        InitMeshletCullPipeline();
+		void        InitUpscalePipelines();
 		void        InitDefaultData();
 		static void InitImguiStyles();
 		// Rendering
-		void Draw();
+		void Draw(RenderPacket& packet);
 		void DrawBackground(VkCommandBuffer cmd);
+		bool PrepareMeshletCull();
+		void CullMeshlets(VkCommandBuffer cmd);
 		void DrawGeometry(VkCommandBuffer cmd);
-		void DrawImGui(VkCommandBuffer cmd, VkImageView targetImageView);
+		// One upscale.comp or sharpen.comp dispatch over target
+		void DispatchUpscale(VkCommandBuffer cmd, VkPipeline pipeline, VkImageView source, VkExtent2D sourceSize,
+		                     VkImageView target, VkExtent2D targetSize);
+		void DrawImGui(VkCommandBuffer cmd, VkImageView targetImageView, ImDrawData* drawData);
 		void RenderUI();
 		void RenderMainMenu() const;
 		void RenderMemoryUsageImGui();
@@ -154,20 +299,49 @@ namespace GraphicsAPI::Vulkan
 
 		// Utility Functions
 		AllocatedBuffer        CreateBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) const;
-		void                   DestroyBuffer(const AllocatedBuffer& buffer) const;
+		void                   DestroyBuffer(const AllocatedBuffer& buffer);
+		void                   DestroyImage(const AllocatedImage& image);
 		void                   CleanupAlloc();
-		GPUMeshBuffers         UploadMesh(std::span<u32> indices, std::span<Vertex> vertices);
+		GPUMeshBuffers         UploadMesh(std::span<u32> indices, std::span<Vertex> vertices,
+		                                  std::span<const GPUMeshlet> meshlets = {});
 		static VkDeviceAddress GetBufferDeviceAddress(VkBuffer buffer);
 		void*                  MapBuffer(const AllocatedBuffer& buffer);
 		void                   UnmapBuffer(const AllocatedBuffer& buffer);
 		void                   ImmediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function) const;
 		static void            SetViewportAndScissor(VkCommandBuffer cmd, const VkExtent2D& extent);
 
+		// Geometry recording, one slice of the frame's draw list
+		struct GeometrySlice
+		{
+			GpuProfiler::PassCounters counters;
+			u32 triangles{};
+		};
+		// Fewer draws than this per slice and the job overhead eats the gain
+		static constexpr u32 MIN_DRAWS_PER_SLICE = 256;
+		// Sets the geometry pass binds. With descriptor buffers the material pipelines read the scene set and their
+		// material sets out of the frame's buffer, bindless pipelines keep using the scene descriptor set.
+		struct GeometryDescriptors
+		{
+			VkDescriptorSet scene{ VK_NULL_HANDLE };
+			const DescriptorBufferAllocator* buffer{ nullptr }; // null on the descriptor set path
+			DescriptorBufferAllocator::Allocation sceneBuffer{};
+			std::span<const DescriptorBufferAllocator::Allocation> materials; // one per draw of the draw list
+		};
+		void RecordGeometryDraws(VkCommandBuffer cmd, u32 begin, u32 end, const GeometryDescriptors& descriptors,
+		                         GeometrySlice& slice) const;
+
+		// Headless readback
+		void CopyDrawImageToReadback(VkCommandBuffer cmd);
+		bool WriteReadback(const std::filesystem::path& path);
+
 		// Swapchain Management
 		void CreateSwapchain(u32 width, u32 height);
 		void ResizeSwapchain();
 		[[nodiscard]] VkExtent3D GetScreenResolution() const;
 		void DestroySwapchain() const;
+		// Draw targets sized to what is rendered instead of the screen, reallocated when that changes
+		void CreateDrawImage(VkExtent3D extent);
+		void ResizeDrawTargets(VkExtent2D extent);
 
 		// Textures
 		AllocatedImage CreateImageData(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
@@ -178,19 +352,25 @@ namespace GraphicsAPI::Vulkan
 		static std::string decodeDriverVersion(u32 driverVersion, u32 vendorID);
 		void               GetVRAMUsage(VkPhysicalDevice physicalDevice, VmaAllocator allocator, VRAMUsage& usage);
 
-		void UpdateScene();
+		// Runs the simulation steps due this frame, fills the packet's camera and publishes the moved render proxies
+		void UpdateScene(RenderPacket& packet);
+		// One fixed simulation step
+		void SimulateStep(f32 dt);
+		// Render thread, culls the proxy snapshot into mainDrawContext with transforms blended by interpolation
+		void BuildDrawList(const RenderProxies::Snapshot& proxies, f32 interpolation);
 
 		VmaAllocator allocator_;
 
 		// Draw resources
 		AllocatedImage drawImage_{};
-		AllocatedImage depthImage_{};
+		AllocatedImage depthImage_{}; // handles point into the render graph's transient memory for the current frame
 		AllocatedImage whiteImage_{};
 		AllocatedImage blackImage_{};
 		AllocatedImage greyImage_{};
 		AllocatedImage errorCheckerboardImage_{};
 
 		VkDescriptorSetLayout gpuSceneDataDescriptorLayout_{};
+		VkDescriptorSetLayout gpuSceneDataBufferLayout_{}; // descriptor buffer variant, null when they are unsupported
 		VkFormat swapchainImageFormat_;
 
 		VkSampler defaultSamplerLinear_{};
@@ -199,8 +379,14 @@ namespace GraphicsAPI::Vulkan
 		// Materials
 		MaterialInstance defaultData;
 		GLTFMetallicRoughness metalRoughMaterial;
-
-		DrawContext mainDrawContext;
+		BindlessRegistry bindless_;
+		PipelineCache pipelineCache_;
+		PipelineRegistry pipelineRegistry_;
+		DescriptorSetCache descriptorCache_;
+
+		DrawContext mainDrawContext; // draw list of the frame being recorded, built by BuildDrawList
+		RenderProxies renderProxies_; // written by UpdateScene, read by Draw
+		StaticDrawList staticDrawList_; // render thread only, rebuilt from the proxies when the static set changes
 		std::unordered_map<std::string, std::shared_ptr<Node>> loadedNodes;
 
 		bool isInit = false;
@@ -227,17 +413,34 @@ namespace GraphicsAPI::Vulkan
 
 		std::wstring renderName = L" - Vulkan";
 		std::string gpuName;
-		bool stopRendering_ = false;
-		bool resizeRequested_ = false;
+		std::atomic<bool> stopRendering_ = false; // set by the render thread, polled by Run
+		bool headless_ = false; // no window, surface, swapchain or ImGui
+		HeadlessOptions headlessOptions_;
+		AllocatedBuffer readbackBuffer_{};
+		VkExtent2D readbackExtent_{};
+		bool resizeRequested_ = false; // handled by the render thread before its next frame
 		f32 renderScale = 1.0f;
+		DynamicResolution dynamicResolution_; // sets renderScale from the GPU frame time while enabled
+		bool lodEnabled = true;
+		f32 lodBias = 1.0f; // allowed LOD error in pixels, higher picks coarser levels sooner
+		RenderSettings settings_;   // render thread, taken from the packet at the start of Draw
+		RenderSettings uiSettings_; // main thread, edited by the UI
+		u32 geometrySlices_ = 1;       // secondary command buffers the last geometry pass was recorded into
 
 
+		// Simulation runs at a fixed rate, rendering blends between its last two steps
+		FixedTimestep simulationClock_;
+		int simulationRate_ = 60; // Hz
+		glm::vec3 previousCameraPosition_{ 0.f };
+
 		// Timing and performance metrics
 		float deltaTime = 0.0f, renderTime = 0.0f, displayedFPS = 0.0f, accumulatedTime = 0.0f;
 		int frameCount = 0;
-		EngineStats stats;
+		EngineStats stats; // render thread
+		f32 sceneUpdateMs_ = 0.f; // CPU ms spent in UpdateScene
 		VRAMUsage vramUsage;
 		std::unordered_map<std::string, float> timingResults;
+		std::unordered_map<std::string, float> renderTimingResults_; // timers on the render thread
 
 		std::vector<VkPresentModeKHR> availablePresentModes_;
 		std::vector<std::string> presentModeNames_;
@@ -249,15 +452,58 @@ namespace GraphicsAPI::Vulkan
 		VkExtent2D swapchainExtent_{};
 		VkExtent2D drawExtent_{};
 
+		// Rebuilt by Draw every frame
+		RenderGraph renderGraph_;
+		GpuProfiler gpuProfiler_;
+
 		// Frame data
-		FrameData frames_[FRAME_OVERLAP];
-		FrameData& GetCurrentFrame() { return frames_[frameNumber_ % FRAME_OVERLAP]; }
-		int frameNumber_{0};
+		FrameData frames_[MAX_FRAMES_IN_FLIGHT];
+		FrameData& GetCurrentFrame() { return frames_[frameNumber_ % framesInFlight_]; }
+		u64 frameNumber_{0};
+		// Frame N signals N + 1 when its commands complete, one wait on it replaces a fence per frame
+		VkSemaphore frameTimeline_{};
+		u32 framesInFlight_ = 2; // settings_.framesInFlight, applied by Draw between frames
+		void WaitForTimeline(u64 value) const;
+
+		// Render thread. Run simulates and builds the UI into packets, RenderThreadMain records and submits them. At most
+		// RENDER_QUEUE_DEPTH packets are between the two, so the simulation of frame N + 1 overlaps the recording of
+		// frame N but never runs further ahead than that.
+		static constexpr u32 RENDER_QUEUE_DEPTH = 2;
+		RenderPacket renderPackets_[RENDER_QUEUE_DEPTH];
+		u64 packetsSubmitted_{0}; // guarded by renderQueueMutex_
+		u64 packetsCompleted_{0}; // guarded by renderQueueMutex_
+		bool renderThreadQuit_ = false;
+		std::thread renderThread_;
+		std::mutex renderQueueMutex_;
+		std::condition_variable renderQueueCondition_;
+		// Guards publishedStats_ only, both sides copy it under the lock and never record or build UI while holding it
+		std::mutex renderStateMutex_;
+		RenderStats publishedStats_; // the newest recorded frame's stats
+		RenderStats uiStats_;        // main thread, what the UI shows this frame
+		VkExtent3D sceneResolution_{}; // GetScreenResolution as of the last UI frame, the main thread's copy
+
+		// Render thread, takes the packet's settings before recording
+		void ApplySettings(const RenderSettings& settings);
+		// Render thread, copies this frame's stats for the UI once it is recorded
+		void PublishStats();
+
+		void RenderThreadMain();
+		// Blocks while RENDER_QUEUE_DEPTH packets are pending
+		RenderPacket& AcquireRenderPacket();
+		void SubmitRenderPacket();
+		void StopRenderThread();
 
 		// Descriptor-related members
 		DescriptorAllocatorGrowable globalDescriptorAllocator{};
-		VkDescriptorSet drawImageDescriptors_{};
 		VkDescriptorSetLayout drawImageDescriptorLayout_{};
+		bool useDescriptorBuffers_ = false; // per frame sets are written into frameDescriptorBuffer_
+		// Descriptor buffer copies of the materials drawn this frame, shared by every draw of the same material
+		std::unordered_map<const MaterialInstance*, DescriptorBufferAllocator::Allocation> frameMaterialSets_;
+		std::vector<DescriptorBufferAllocator::Allocation> drawMaterialSets_;
+		bool pipelineStatisticsSupported_ = false; // optional per pass pipeline statistics in the profiler
+		bool inheritedQueriesSupported_ = false;   // secondary command buffers may run inside a statistics query
+		bool bindlessSupported_ = false;       // descriptor indexing features of the bindless texture array
+		bool meshletCullingSupported_ = false; // multiDrawIndirect and drawIndirectCount for the cluster draws
 		VkDescriptorSetLayout singleImageDescriptorLayout_{};
 
 		VkPipelineLayout gradientPipelineLayout_{};
@@ -272,9 +518,37 @@ namespace GraphicsAPI::Vulkan
 		VkPipelineLayout meshPipelineLayout_;
 		VkPipeline meshPipeline_;
 
+		// GPU cluster culling, PrepareMeshletCull creates this frame's buffers and CullMeshlets fills the command
+		// and count buffers on the GPU
+		VkPipelineLayout meshletCullPipelineLayout_{};
+		VkPipeline meshletCullPipeline_{};
+		VkBuffer clusterCullDataBuffer_{VK_NULL_HANDLE};
+		// Kept out of the render graph's transients: their size follows the scene, and every new size would place
+		// the whole transient set again. Grown to the next power of two when outgrown, never shrunk.
+		AllocatedBuffer clusterCommandBuffer_{};
+		AllocatedBuffer clusterCountBuffer_{};
+		VkDeviceSize clusterCommandCapacity_{0};
+		VkDeviceSize clusterCountCapacity_{0};
+		void GrowClusterBuffer(AllocatedBuffer& buffer, VkDeviceSize& capacity, VkDeviceSize size, VkBufferUsageFlags usage);
+		u32 clusterDrawCount_{0};
+		u32 clusterMeshletCount_{0};
+		u32 clusterMaxMeshlets_{0};
+
+		// Compute upscaler from the draw extent to the swapchain, an edge adaptive upscale then a sharpening pass
+		VkDescriptorSetLayout upscaleDescriptorLayout_{}; // sampled source, storage target
+		VkPipelineLayout upscalePipelineLayout_{};
+		VkPipeline upscalePipeline_{};
+		VkPipeline sharpenPipeline_{};
+
 		// Background effects
 		std::vector<ComputeEffect> backgroundEffects;
-		int currentBackgroundEffect_{0};
+
+		// Worker threads shared by CPU side systems
+		JobSystem jobSystem_;
+
+		// CPU occlusion culling against designated occluders
+		OcclusionCuller occlusionCuller_;
+		FrustumCullCache frustumCuller_; // static set indexed like staticDrawList_, dynamic proxies tested each frame
 
 		// Asset loading
 		VkLoader loader_;
@@ -286,7 +560,6 @@ namespace GraphicsAPI::Vulkan
 		// Camera and projection parameters
 		glm::vec3 cameraPosition = glm::vec3(0, 0, -5);
 		f32 fov = 70.0f;
-		f32 nearPlane = 0.1f;
 		f32 farPlane = 10000.0f;
 
 		TracyVkCtx tracyContext_{};
@@ -11,19 +11,18 @@ using namespace GraphicsAPI::Vulkan;
 
 void GLTFMetallicRoughness::BuildPipelines(VkEngine* engine, VkDevice device)
 {
-    // Load vertex and fragment shaders
-    VkShaderModule meshFragShader;
-    if (!LoadShader("shaders/mesh.frag.spv", device, &meshFragShader))
+    // Load vertex and fragment shaders, the registry owns the modules
+    VkShaderModule meshFragShader = engine->pipelineRegistry_.LoadShader(device, "shaders/mesh.frag.spv");
+    if (!meshFragShader)
     {
         LOG(ERR, "Error loading fragment shader module");
         return;
     }
 
-    VkShaderModule meshVertexShader;
-    if (!LoadShader("shaders/mesh.vert.spv", device, &meshVertexShader))
+    VkShaderModule meshVertexShader = engine->pipelineRegistry_.LoadShader(device, "shaders/mesh.vert.spv");
+    if (!meshVertexShader)
     {
         LOG(ERR, "Error loading vertex shader module");
-        vkDestroyShaderModule(device, meshFragShader, nullptr); // Clean up previously loaded shader
         return;
     }
 
@@ -43,9 +42,17 @@ void GLTFMetallicRoughness::BuildPipelines(VkEngine* engine, VkDevice device)
 
     materialLayout = layoutBuilder.Build(device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
 
+    // With descriptor buffers the scene and material sets come from the frame's buffer instead
+    const bool descriptorBuffers = engine->gpuSceneDataBufferLayout_ != VK_NULL_HANDLE;
+    if (descriptorBuffers)
+    {
+        materialBufferLayout = layoutBuilder.Build(device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                                                   nullptr, VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+    }
+
     VkDescriptorSetLayout layouts[] = {
-        engine->gpuSceneDataDescriptorLayout_,
-        materialLayout
+        descriptorBuffers ? engine->gpuSceneDataBufferLayout_ : engine->gpuSceneDataDescriptorLayout_,
+        descriptorBuffers ? materialBufferLayout : materialLayout
     };
 
     // Create pipeline layout using newLayout
@@ -69,41 +76,228 @@ void GLTFMetallicRoughness::BuildPipelines(VkEngine* engine, VkDevice device)
 		.EnableDepthTest(true, VK_COMPARE_OP_GREATER_OR_EQUAL)
 		.SetColorAttachmentFormat(engine->drawImage_.imageFormat)
 		.SetDepthFormat(engine->depthImage_.imageFormat)
-		.Layout(newLayout);
+		.Layout(newLayout)
+		.SetFlags(descriptorBuffers ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0);
 
-    // Build opaque pipeline
-    opaquePipeline.pipeline = pipelineBuilder.BuildPipeline(device, pipelineBuilder.data);
+    // Build opaque pipeline, the permutations inherit its flags through opaqueData_
+    opaquePipeline.pipeline = engine->pipelineRegistry_.GetOrCreate(device, pipelineBuilder.data);
+    opaqueData_ = pipelineBuilder.data;
 
     // Build transparent pipeline (with additive blending and no depth test)
     pipelineBuilder.EnableBlendingAdditive();
     pipelineBuilder.EnableDepthTest(false, VK_COMPARE_OP_GREATER_OR_EQUAL);
-    transparentPipeline.pipeline = pipelineBuilder.BuildPipeline(device, pipelineBuilder.data);
+    transparentPipeline.pipeline = engine->pipelineRegistry_.GetOrCreate(device, pipelineBuilder.data);
+    transparentData_ = pipelineBuilder.data;
+
+    if (!engine->bindless_.IsValid())
+    {
+        return;
+    }
+
+    VkShaderModule bindlessFragShader = engine->pipelineRegistry_.LoadShader(device, "shaders/mesh_bindless.frag.spv");
+    if (!bindlessFragShader)
+    {
+        LOG(ERR, "Error loading bindless fragment shader module");
+        return;
+    }
+
+    VkShaderModule bindlessVertexShader = engine->pipelineRegistry_.LoadShader(device, "shaders/mesh_bindless.vert.spv");
+    if (!bindlessVertexShader)
+    {
+        LOG(ERR, "Error loading bindless vertex shader module");
+        return;
+    }
+
+    VkPushConstantRange bindlessRange
+    {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(GPUBindlessDrawPushConstants)
+    };
+
+    VkDescriptorSetLayout bindlessLayouts[] = {
+        engine->gpuSceneDataDescriptorLayout_,
+        engine->bindless_.Layout()
+    };
+
+    VkPipelineLayoutCreateInfo bindlessLayoutInfo = VkInfo::CreatePipelineLayoutInfo(2, bindlessLayouts, 1, &bindlessRange);
+
+    VkPipelineLayout bindlessLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &bindlessLayoutInfo, nullptr, &bindlessLayout));
+
+    bindlessOpaquePipeline.layout = bindlessLayout;
+    bindlessTransparentPipeline.layout = bindlessLayout;
+
+    pipelineBuilder
+        .SetShaders(bindlessVertexShader, bindlessFragShader)
+        .DisableBlending()
+        .EnableDepthTest(true, VK_COMPARE_OP_GREATER_OR_EQUAL)
+        .Layout(bindlessLayout)
+        .SetFlags(0);
+    // Not needed for the first frames, the draw loop uses the descriptor set path until these are published
+    bindlessOpaquePipeline.pipeline = engine->pipelineRegistry_.GetOrCreateAsync(
+        device, pipelineBuilder.data, VK_NULL_HANDLE, &bindlessOpaquePipeline.pipeline);
+
+    pipelineBuilder.EnableBlendingAdditive();
+    pipelineBuilder.EnableDepthTest(false, VK_COMPARE_OP_GREATER_OR_EQUAL);
+    bindlessTransparentPipeline.pipeline = engine->pipelineRegistry_.GetOrCreateAsync(
+        device, pipelineBuilder.data, VK_NULL_HANDLE, &bindlessTransparentPipeline.pipeline);
+}
+
+MaterialPipeline* GLTFMetallicRoughness::GetPermutation(VkEngine* engine, VkDevice device, MaterialPass pass,
+                                                        const MaterialFeatures& features)
+{
+	const bool transparent = pass == MaterialPass::Transparent;
+	MaterialPipeline& generic = transparent ? transparentPipeline : opaquePipeline;
+
+	// The generic pipeline already is the default permutation
+	if (features.Index() == MaterialFeatures{}.Index() || generic.pipeline == VK_NULL_HANDLE)
+	{
+		return &generic;
+	}
+
+	Permutation& permutation = (transparent ? transparentPermutations_ : opaquePermutations_)[features.Index()];
+	if (permutation.requested)
+	{
+		return &permutation.pipeline;
+	}
+
+	// Must match the constant_id declarations in mesh.vert and mesh.frag
+	static constexpr VkSpecializationMapEntry entries[]
+	{
+		{ .constantID = 0, .offset = 0 * sizeof(VkBool32), .size = sizeof(VkBool32) },
+		{ .constantID = 1, .offset = 1 * sizeof(VkBool32), .size = sizeof(VkBool32) },
+		{ .constantID = 2, .offset = 2 * sizeof(VkBool32), .size = sizeof(VkBool32) }
+	};
+
+	permutation.constants = { features.textured, features.alphaTest, features.vertexColors };
+	permutation.specialization =
+	{
+		.mapEntryCount = static_cast<u32>(std::size(entries)),
+		.pMapEntries = entries,
+		.dataSize = sizeof(permutation.constants),
+		.pData = permutation.constants.data()
+	};
+	permutation.requested = true;
+
+	PipelineBuilder builder;
+	builder.data = transparent ? transparentData_ : opaqueData_;
+	builder.SetSpecialization(&permutation.specialization);
 
-    // Clean up shader modules
-    vkDestroyShaderModule(device, meshFragShader, nullptr);
-    vkDestroyShaderModule(device, meshVertexShader, nullptr);
+	permutation.pipeline.layout   = generic.layout;
+	permutation.pipeline.pipeline = engine->pipelineRegistry_.GetOrCreateAsync(
+		device, builder.data, generic.pipeline, &permutation.pipeline.pipeline);
+
+	return &permutation.pipeline;
+}
+
+u32 GLTFMetallicRoughness::PermutationCount() const
+{
+	u32 count = 0;
+	for (const Permutation& permutation : opaquePermutations_)
+	{
+		count += permutation.requested ? 1 : 0;
+	}
+	for (const Permutation& permutation : transparentPermutations_)
+	{
+		count += permutation.requested ? 1 : 0;
+	}
+	return count;
 }
 
 MaterialInstance GLTFMetallicRoughness::WriteMaterial(VkDevice device, MaterialPass pass, const MaterialResources& resources, DescriptorAllocatorGrowable& descriptorAllocator)
+{
+	// Clear previous writes and prepare to write new resources
+	writer.Clear();
+	MaterialInstance matData = QueueMaterial(device, pass, resources, descriptorAllocator);
+
+	// Update the descriptor set with the written resources
+	FlushMaterialWrites(device);
+
+	return matData;
+}
+
+void GLTFMetallicRoughness::BeginMaterialWrites(u32 materialCount)
+{
+	// One uniform buffer and two images per material
+	writer.Clear();
+	writer.Reserve(materialCount * 3, materialCount * 2, materialCount);
+}
+
+MaterialInstance GLTFMetallicRoughness::QueueMaterial(VkDevice device, MaterialPass pass, const MaterialResources& resources, DescriptorAllocatorGrowable& descriptorAllocator)
 {
 	// Initialize the material instance with the correct pipeline based on pass type
 	MaterialInstance matData
 	{
 		.pipeline = (pass == MaterialPass::Transparent) ? &transparentPipeline : &opaquePipeline,
-		.materialSet = descriptorAllocator.Allocate(device, materialLayout),
 		.passType = pass
 	};
 
-	// Clear previous writes and prepare to write new resources
-	writer.Clear();
+	// The pipelines read descriptor buffers, so the set is written into the instance and copied in when drawn
+	if (materialBufferLayout != VK_NULL_HANDLE)
+	{
+		matData.descriptors.resize(DescriptorBufferAllocator::LayoutSize(device, materialBufferLayout));
+		const DescriptorBufferAllocator::Allocation set
+		{
+			.layout = materialBufferLayout,
+			.data = matData.descriptors.data()
+		};
+		DescriptorBufferAllocator::WriteBuffer(device, set, 0,
+		                                       VkEngine::GetBufferDeviceAddress(resources.dataBuffer) + resources.dataBufferOffset,
+		                                       sizeof(MaterialConstants), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		DescriptorBufferAllocator::WriteImage(device, set, 1, resources.colorImage.imageView, resources.colorSampler,
+		                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		DescriptorBufferAllocator::WriteImage(device, set, 2, resources.metalRoughImage.imageView, resources.metalRoughSampler,
+		                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		return matData;
+	}
+
+	matData.materialSet = descriptorAllocator.Allocate(device, materialLayout);
+
 	// Write the material's uniform buffer and images
 	writer.WriteBuffer(0, resources.dataBuffer, sizeof(MaterialConstants), resources.dataBufferOffset, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
 	writer.WriteImage(1, resources.colorImage.imageView, resources.colorSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 	writer.WriteImage(2, resources.metalRoughImage.imageView, resources.metalRoughSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-
-	// Update the descriptor set with the written resources
-	writer.UpdateSet(device, matData.materialSet);
+	writer.QueueSet(matData.materialSet);
 
 	return matData;
 }
 
+u32 GLTFMetallicRoughness::FlushMaterialWrites(VkDevice device)
+{
+	return writer.Flush(device);
+}
+
+void GLTFMetallicRoughness::WriteBindlessMaterial(VkDevice device, BindlessRegistry& registry,
+                                                  const MaterialConstants& constants,
+                                                  const MaterialResources& resources, MaterialInstance& instance)
+{
+	// The pipelines themselves may still be compiling, the layout tells whether they were requested at all
+	if (!registry.IsValid() || bindlessOpaquePipeline.layout == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	GPUBindlessMaterial material
+	{
+		.colorFactors = constants.colorFactors,
+		.metalRoughFactors = constants.metalRoughnessFactors,
+		.colorTexture = registry.RegisterTexture(device, resources.colorImage.imageView, resources.colorSampler),
+		.metalRoughTexture = registry.RegisterTexture(device, resources.metalRoughImage.imageView, resources.metalRoughSampler),
+		.features = MaterialFeatures{}.Index() // the loader sets the real ones once its primitives are known
+	};
+
+	const u32 index = registry.AddMaterial(material);
+	if (index == BindlessRegistry::INVALID_INDEX)
+	{
+		registry.ReleaseTexture(material.colorTexture);
+		registry.ReleaseTexture(material.metalRoughTexture);
+		return;
+	}
+
+	instance.bindlessIndex = index;
+	instance.bindlessPipeline = instance.passType == MaterialPass::Transparent
+		? &bindlessTransparentPipeline
+		: &bindlessOpaquePipeline;
+}
+
@@ -4,6 +4,9 @@
 #pragma once
 
 #ifdef VULKAN_BUILD
+#include <array>
+
+#include "VulkanBindless.h"
 #include "VulkanDescriptor.h"
 #include "VulkanLoader.h"
 #include "VulkanPipelines.h"
@@ -24,15 +27,22 @@ namespace GraphicsAPI::Vulkan
 		MaterialPipeline opaquePipeline{};
 		MaterialPipeline transparentPipeline{};
 
+		// Same shading through the global bindless set, only built when the registry is available
+		MaterialPipeline bindlessOpaquePipeline{};
+		MaterialPipeline bindlessTransparentPipeline{};
+
 		MaterialInstance data;
 
 		VkDescriptorSetLayout materialLayout{ VK_NULL_HANDLE };  // Descriptor set layout for material resources
+		// Same bindings for descriptor buffers, only created when the engine uses them. Materials then carry their
+		// set as bytes instead of a descriptor set and the generic pipelines are built for descriptor buffers.
+		VkDescriptorSetLayout materialBufferLayout{ VK_NULL_HANDLE };
 
 		// Constants used in the material (uniform buffer)
 		struct MaterialConstants
 		{
 			glm::vec4 colorFactors{};
-			glm::vec4 metalRoughnessFactors{};
+			glm::vec4 metalRoughnessFactors{};  // x: metallic, y: roughness, z: alpha cutoff
 			glm::vec4 extra[14];
 		};
 
@@ -53,6 +63,12 @@ namespace GraphicsAPI::Vulkan
 		// Builds the graphics pipelines for opaque and transparent materials
 		void BuildPipelines(VkEngine* engine, VkDevice device);
 
+		// Pipeline specialized for the given features. Compiled in the background on first request, until then the
+		// returned pipeline holds the generic one for the pass, which draws the same material minus the alpha test.
+		MaterialPipeline* GetPermutation(VkEngine* engine, VkDevice device, MaterialPass pass,
+		                                 const MaterialFeatures& features);
+		[[nodiscard]] u32 PermutationCount() const;
+
 		// Clears any Vulkan resources associated with the material
 		void ClearResources(VkDevice device);
 
@@ -63,6 +79,44 @@ namespace GraphicsAPI::Vulkan
 		    const MaterialResources& resources,
 		    DescriptorAllocatorGrowable& descriptorAllocator
 		);
+
+		// Batched variant for scene loading: allocates the set but only records its writes.
+		// The set must not be used before FlushMaterialWrites.
+		void             BeginMaterialWrites(u32 materialCount);
+		MaterialInstance QueueMaterial(
+		    VkDevice device,
+		    MaterialPass pass,
+		    const MaterialResources& resources,
+		    DescriptorAllocatorGrowable& descriptorAllocator
+		);
+		// Writes every queued material with one vkUpdateDescriptorSets, returns the number of sets written
+		u32              FlushMaterialWrites(VkDevice device);
+
+		// Registers the material's textures and constants with the bindless registry and points the instance at
+		// the bindless pipelines. Leaves the instance untouched when the registry is unavailable or full.
+		void WriteBindlessMaterial(
+		    VkDevice device,
+		    BindlessRegistry& registry,
+		    const MaterialConstants& constants,
+		    const MaterialResources& resources,
+		    MaterialInstance& instance
+		);
+
+	private:
+		struct Permutation
+		{
+			MaterialPipeline pipeline{};
+			std::array<VkBool32, 3> constants{};
+			VkSpecializationInfo specialization{};  // points at constants, outlives the background compile
+			bool requested{ false };
+		};
+
+		// Generic pipeline state the permutations are specialized from
+		PipelineData opaqueData_{};
+		PipelineData transparentData_{};
+
+		std::array<Permutation, MaterialFeatures::PERMUTATION_COUNT> opaquePermutations_{};
+		std::array<Permutation, MaterialFeatures::PERMUTATION_COUNT> transparentPermutations_{};
 	};
 }
 #endif
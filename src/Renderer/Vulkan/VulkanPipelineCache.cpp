@@ -0,0 +1,129 @@
+//
+// Created by Orgest on 10/23/2024.
+//
+
+#include "VulkanPipelineCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace GraphicsAPI::Vulkan;
+
+void PipelineCache::Init(VkDevice device, const VkPhysicalDeviceProperties& properties,
+                         const std::filesystem::path& path)
+{
+	properties_ = properties;
+	path_       = path;
+	loaded_     = false;
+
+	std::vector<u8> data;
+	if (std::ifstream file(path_, std::ios::binary); file)
+	{
+		FileHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (file && Matches(header))
+		{
+			data.resize(header.dataSize);
+			file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+			if (!file)
+			{
+				LOG(WARN, "Pipeline cache file is truncated, starting cold");
+				data.clear();
+			}
+		}
+		else
+		{
+			LOG(INFO, "Pipeline cache file is from another device or driver, starting cold");
+		}
+	}
+
+	VkPipelineCacheCreateInfo info
+	{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = data.size(),
+		.pInitialData = data.empty() ? nullptr : data.data()
+	};
+
+	// Drivers may still reject data they don't like, retry empty rather than fail
+	if (vkCreatePipelineCache(device, &info, nullptr, &cache_) != VK_SUCCESS && !data.empty())
+	{
+		LOG(WARN, "Driver rejected the pipeline cache file, starting cold");
+		data.clear();
+		info.initialDataSize = 0;
+		info.pInitialData    = nullptr;
+		VK_CHECK(vkCreatePipelineCache(device, &info, nullptr, &cache_));
+	}
+
+	loaded_ = !data.empty();
+	if (loaded_)
+	{
+		LOG(INFO, "Loaded pipeline cache: ", data.size(), " bytes from ", path_.string());
+	}
+}
+
+bool PipelineCache::Matches(const FileHeader& header) const
+{
+	return header.magic == FILE_MAGIC &&
+	       header.version == FILE_VERSION &&
+	       header.vendorID == properties_.vendorID &&
+	       header.deviceID == properties_.deviceID &&
+	       header.driverVersion == properties_.driverVersion &&
+	       std::memcmp(header.pipelineCacheUUID, properties_.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::Save(VkDevice device) const
+{
+	if (cache_ == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	size_t size = 0;
+	VK_CHECK(vkGetPipelineCacheData(device, cache_, &size, nullptr));
+	std::vector<u8> data(size);
+	VK_CHECK(vkGetPipelineCacheData(device, cache_, &size, data.data()));
+
+	FileHeader header
+	{
+		.magic = FILE_MAGIC,
+		.version = FILE_VERSION,
+		.vendorID = properties_.vendorID,
+		.deviceID = properties_.deviceID,
+		.driverVersion = properties_.driverVersion,
+		.dataSize = size
+	};
+	std::memcpy(header.pipelineCacheUUID, properties_.pipelineCacheUUID, VK_UUID_SIZE);
+
+	// Write next to the old file and swap it in so a crash mid write can't leave a corrupt cache behind
+	std::filesystem::path tempPath = path_;
+	tempPath += ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			LOG(WARN, "Could not write pipeline cache to ", tempPath.string());
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(size));
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path_, error);
+	if (error)
+	{
+		LOG(WARN, "Could not replace pipeline cache file: ", error.message());
+		return;
+	}
+	LOG(INFO, "Saved pipeline cache: ", size, " bytes to ", path_.string());
+}
+
+void PipelineCache::Destroy(VkDevice device)
+{
+	if (cache_ != VK_NULL_HANDLE)
+	{
+		vkDestroyPipelineCache(device, cache_, nullptr);
+		cache_ = VK_NULL_HANDLE;
+	}
+}
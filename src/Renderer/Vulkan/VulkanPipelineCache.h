@@ -0,0 +1,53 @@
+//
+// Created by Orgest on 10/23/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include <filesystem>
+
+#include "VulkanHeader.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	// VkPipelineCache persisted between runs. The file starts with our own header naming the vendor, device,
+	// driver version and cache UUID it was produced on; any mismatch (new driver, different GPU) discards it and
+	// starts cold. The cache is internally synchronized, so pipelines may be created with it from several threads.
+	class PipelineCache
+	{
+	public:
+		void Init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::filesystem::path& path);
+		// Writes the current cache contents back to the file
+		void Save(VkDevice device) const;
+		void Destroy(VkDevice device);
+
+		[[nodiscard]] VkPipelineCache Handle() const { return cache_; }
+		// True when Init found a valid cache file, i.e. pipelines are created warm
+		[[nodiscard]] bool            WasLoaded() const { return loaded_; }
+
+	private:
+		struct FileHeader
+		{
+			u32 magic;
+			u32 version;
+			u32 vendorID;
+			u32 deviceID;
+			u32 driverVersion;
+			u8  pipelineCacheUUID[VK_UUID_SIZE];
+			u64 dataSize;
+		};
+
+		static constexpr u32 FILE_MAGIC   = 0x4F524750; // "ORGP"
+		static constexpr u32 FILE_VERSION = 1;
+
+		[[nodiscard]] bool Matches(const FileHeader& header) const;
+
+		VkPipelineCache            cache_{ VK_NULL_HANDLE };
+		VkPhysicalDeviceProperties properties_{};
+		std::filesystem::path      path_;
+		bool                       loaded_{ false };
+	};
+}
+
+#endif
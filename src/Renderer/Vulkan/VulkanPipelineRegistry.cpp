@@ -0,0 +1,269 @@
+//
+// Created by Orgest on 10/23/2024.
+//
+
+#include "VulkanPipelineRegistry.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+using namespace GraphicsAPI::Vulkan;
+
+namespace
+{
+	void Combine(u64& hash, u64 word)
+	{
+		hash ^= word + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	}
+
+	u64 HashBytes(const void* data, size_t size)
+	{
+		// FNV-1a
+		u64 hash = 0xcbf29ce484222325ull;
+		const auto* bytes = static_cast<const u8*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+}
+
+void PipelineRegistry::Init(VkPipelineCache cache, u32 compileThreads)
+{
+	cache_ = cache;
+	compileJobs_.Init(std::max(1u, compileThreads));
+}
+
+void PipelineRegistry::Destroy(VkDevice device)
+{
+	// Background compiles still reference the shader modules
+	compileJobs_.Shutdown();
+
+	std::lock_guard lock(mutex_);
+	for (auto& [key, entry] : pipelines_)
+	{
+		if (VkPipeline pipeline = entry.pipeline.get(); pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+	}
+	for (auto& [path, module] : shaders_)
+	{
+		vkDestroyShaderModule(device, module, nullptr);
+	}
+
+	pipelines_.clear();
+	shaders_.clear();
+	completed_.clear();
+}
+
+VkShaderModule PipelineRegistry::LoadShader(VkDevice device, const std::filesystem::path& path)
+{
+	const std::string name = path.generic_string();
+	{
+		std::lock_guard lock(mutex_);
+		if (auto it = shaders_.find(name); it != shaders_.end())
+		{
+			return it->second;
+		}
+	}
+
+	VkShaderModule module = VK_NULL_HANDLE;
+	if (!VkLoader::LoadShader(path, device, &module))
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	std::lock_guard lock(mutex_);
+	// Another thread may have loaded the same file meanwhile, keep the first one
+	auto [it, inserted] = shaders_.emplace(name, module);
+	if (!inserted)
+	{
+		vkDestroyShaderModule(device, module, nullptr);
+	}
+	return it->second;
+}
+
+PipelineRegistry::Key PipelineRegistry::MakeKey(const PipelineData& data)
+{
+	Key key;
+	auto& w = key.words;
+
+	for (const auto& stage : data.shaderStages.stages)
+	{
+		w.push_back(stage.stage);
+		w.push_back(reinterpret_cast<u64>(stage.module));
+		w.push_back(HashBytes(stage.pName, std::strlen(stage.pName)));
+		if (const VkSpecializationInfo* spec = stage.pSpecializationInfo)
+		{
+			w.push_back(HashBytes(spec->pMapEntries, spec->mapEntryCount * sizeof(VkSpecializationMapEntry)));
+			w.push_back(HashBytes(spec->pData, spec->dataSize));
+		}
+	}
+
+	const PipelineConfig& c = data.config;
+	w.push_back(c.inputAssembly.topology);
+	w.push_back(c.inputAssembly.primitiveRestartEnable);
+
+	w.push_back(c.rasterizer.polygonMode);
+	w.push_back(c.rasterizer.cullMode);
+	w.push_back(c.rasterizer.frontFace);
+	w.push_back(c.rasterizer.depthClampEnable);
+	w.push_back(c.rasterizer.rasterizerDiscardEnable);
+	w.push_back(c.rasterizer.depthBiasEnable);
+	w.push_back(std::bit_cast<u32>(c.rasterizer.lineWidth));
+
+	const VkPipelineColorBlendAttachmentState& b = c.colorBlendAttachment;
+	w.push_back(b.blendEnable);
+	w.push_back(static_cast<u64>(b.srcColorBlendFactor) << 32 | b.dstColorBlendFactor);
+	w.push_back(static_cast<u64>(b.srcAlphaBlendFactor) << 32 | b.dstAlphaBlendFactor);
+	w.push_back(static_cast<u64>(b.colorBlendOp) << 32 | b.alphaBlendOp);
+	w.push_back(b.colorWriteMask);
+
+	w.push_back(c.multisampling.rasterizationSamples);
+	w.push_back(c.multisampling.sampleShadingEnable);
+	w.push_back(std::bit_cast<u32>(c.multisampling.minSampleShading));
+	w.push_back(c.multisampling.alphaToCoverageEnable);
+	w.push_back(c.multisampling.alphaToOneEnable);
+
+	w.push_back(c.depthStencil.depthTestEnable);
+	w.push_back(c.depthStencil.depthWriteEnable);
+	w.push_back(c.depthStencil.depthCompareOp);
+	w.push_back(c.depthStencil.depthBoundsTestEnable);
+	w.push_back(c.depthStencil.stencilTestEnable);
+
+	w.push_back(c.renderInfo.colorAttachmentCount);
+	w.push_back(c.colorAttachmentFormat);
+	w.push_back(c.renderInfo.depthAttachmentFormat);
+
+	w.push_back(reinterpret_cast<u64>(c.layout));
+	w.push_back(c.flags);
+
+	for (const u64 word : w)
+	{
+		Combine(key.hash, word);
+	}
+	return key;
+}
+
+VkPipeline PipelineRegistry::Compile(VkDevice device, const PipelineData& data) const
+{
+	PipelineBuilder builder;
+	return builder.BuildPipeline(device, data, cache_);
+}
+
+VkPipeline PipelineRegistry::GetOrCreate(VkDevice device, const PipelineData& data)
+{
+	Key key = MakeKey(data);
+
+	std::promise<VkPipeline> promise;
+	{
+		std::unique_lock lock(mutex_);
+		if (auto it = pipelines_.find(key); it != pipelines_.end())
+		{
+			hits_.fetch_add(1, std::memory_order_relaxed);
+			std::shared_future<VkPipeline> pipeline = it->second.pipeline;
+			lock.unlock();
+			// Blocks when another thread is still compiling it
+			return pipeline.get();
+		}
+		pipelines_.emplace(key, Entry{ .pipeline = promise.get_future().share() });
+	}
+
+	VkPipeline pipeline = Compile(device, data);
+	promise.set_value(pipeline);
+	Finish(key, pipeline);
+	return pipeline;
+}
+
+VkPipeline PipelineRegistry::GetOrCreateAsync(VkDevice device, const PipelineData& data, VkPipeline fallback,
+                                              VkPipeline* target)
+{
+	Key key = MakeKey(data);
+
+	auto promise = std::make_shared<std::promise<VkPipeline>>();
+	{
+		std::lock_guard lock(mutex_);
+		if (auto it = pipelines_.find(key); it != pipelines_.end())
+		{
+			hits_.fetch_add(1, std::memory_order_relaxed);
+			if (it->second.pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				// Null only for a failed compile that Finish is about to drop
+				const VkPipeline pipeline = it->second.pipeline.get();
+				return pipeline != VK_NULL_HANDLE ? pipeline : fallback;
+			}
+			it->second.targets.push_back(target);
+			return fallback;
+		}
+
+		Entry entry{ .pipeline = promise->get_future().share(), .targets = { target } };
+		pipelines_.emplace(key, std::move(entry));
+		pending_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// The job gets its own copy of the state, the caller's builder is usually gone by the time it runs.
+	// Specialization data is referenced, not copied, and has to outlive the compile.
+	compileJobs_.Execute([this, device, data, key = std::move(key), promise]() mutable
+	{
+		const VkPipeline pipeline = Compile(device, data);
+		promise->set_value(pipeline);
+		Finish(key, pipeline);
+		pending_.fetch_sub(1, std::memory_order_relaxed);
+	});
+
+	return fallback;
+}
+
+void PipelineRegistry::Finish(const Key& key, VkPipeline pipeline)
+{
+	std::lock_guard lock(mutex_);
+	auto it = pipelines_.find(key);
+	if (it == pipelines_.end())
+	{
+		return;
+	}
+
+	if (pipeline == VK_NULL_HANDLE)
+	{
+		// Not cached so the next request tries again, waiting targets keep their fallback
+		LOG(ERR, "Pipeline compile failed, ", it->second.targets.size(), " async requests keep their fallback");
+		pipelines_.erase(it);
+		return;
+	}
+
+	// Async requests may have attached to a compile started by GetOrCreate, they are published like any other
+	if (!it->second.targets.empty())
+	{
+		completed_.push_back(key);
+	}
+}
+
+void PipelineRegistry::PublishCompleted()
+{
+	std::lock_guard lock(mutex_);
+	for (const Key& key : completed_)
+	{
+		auto it = pipelines_.find(key);
+		if (it == pipelines_.end())
+		{
+			continue;
+		}
+
+		const VkPipeline pipeline = it->second.pipeline.get();
+		for (VkPipeline* target : it->second.targets)
+		{
+			*target = pipeline;
+		}
+		it->second.targets.clear();
+	}
+	completed_.clear();
+}
+
+u32 PipelineRegistry::PipelineCount()
+{
+	std::lock_guard lock(mutex_);
+	return static_cast<u32>(pipelines_.size());
+}
@@ -0,0 +1,88 @@
+//
+// Created by Orgest on 10/23/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanLoader.h"
+#include "VulkanPipelines.h"
+#include "../../Core/JobSystem.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	// Owns every graphics pipeline and the shader modules they are built from. Pipelines are keyed by a hash of
+	// the full PipelineData (shader modules, entry points, specialization data and all fixed function state), so
+	// asking twice for the same state returns the same VkPipeline. Shader modules are cached by path and kept alive
+	// for the registry's lifetime, which keeps their handles a stable identity and lets compiles run in the background.
+	class PipelineRegistry final : public VkLoader
+	{
+	public:
+		// Background compiles get their own workers. A compile can take tens of milliseconds, sharing the engine's
+		// job system would stall every per frame Wait() on it.
+		void Init(VkPipelineCache cache, u32 compileThreads = 1);
+		void Destroy(VkDevice device);
+
+		// Loaded once per path, never destroy the returned module yourself
+		VkShaderModule LoadShader(VkDevice device, const std::filesystem::path& path);
+
+		// Returns the matching pipeline, compiling it on this thread if nobody has yet. A failed compile returns
+		// VK_NULL_HANDLE and isn't cached, the next request compiles it again.
+		VkPipeline GetOrCreate(VkDevice device, const PipelineData& data);
+
+		// Returns the pipeline if it has already been compiled. Otherwise queues the compile on a compile worker and
+		// returns fallback; *target is set to the pipeline by the first PublishCompleted after it finished.
+		VkPipeline GetOrCreateAsync(VkDevice device, const PipelineData& data, VkPipeline fallback, VkPipeline* target);
+
+		// Hands finished background compiles to their targets, call on the render thread between frames
+		void PublishCompleted();
+
+		[[nodiscard]] u32 PipelineCount();
+		[[nodiscard]] u32 PendingCount() const { return pending_.load(std::memory_order_relaxed); }
+		[[nodiscard]] u32 Hits() const { return hits_.load(std::memory_order_relaxed); }
+
+	private:
+		struct Key
+		{
+			std::vector<u64> words;
+			u64 hash{};
+
+			bool operator==(const Key& other) const { return hash == other.hash && words == other.words; }
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const { return key.hash; }
+		};
+
+		struct Entry
+		{
+			std::shared_future<VkPipeline> pipeline;
+			std::vector<VkPipeline*> targets; // waiting for an async compile
+		};
+
+		static Key MakeKey(const PipelineData& data);
+		VkPipeline Compile(VkDevice device, const PipelineData& data) const;
+		// Drops failed compiles from the cache and queues the targets of successful ones for PublishCompleted
+		void Finish(const Key& key, VkPipeline pipeline);
+
+		VkPipelineCache cache_{ VK_NULL_HANDLE };
+		JobSystem compileJobs_;
+
+		std::mutex mutex_;
+		std::unordered_map<Key, Entry, KeyHash> pipelines_;
+		std::unordered_map<std::string, VkShaderModule> shaders_;
+		std::vector<Key> completed_; // async compiles whose targets still need updating
+
+		std::atomic<u32> pending_{ 0 };
+		std::atomic<u32> hits_{ 0 };
+	};
+}
+
+#endif
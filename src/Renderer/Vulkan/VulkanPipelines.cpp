@@ -20,6 +20,7 @@ void PipelineBuilder::Clear(PipelineData& data)
 	};
 
 	data.config.layout = VK_NULL_HANDLE;
+	data.config.flags = 0;
 
 	data.config.depthStencil = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO
@@ -31,7 +32,7 @@ void PipelineBuilder::Clear(PipelineData& data)
 	data.shaderStages.stages.clear();
 }
 
-VkPipeline PipelineBuilder::BuildPipeline(VkDevice device, const PipelineData& data)
+VkPipeline PipelineBuilder::BuildPipeline(VkDevice device, const PipelineData& data, VkPipelineCache cache)
 {
     VkPipelineViewportStateCreateInfo viewportState = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
@@ -53,9 +54,17 @@ VkPipeline PipelineBuilder::BuildPipeline(VkDevice device, const PipelineData& d
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO
     };
 
+    // The stored format pointer belongs to whichever PipelineData it was set on, point it at this one
+    VkPipelineRenderingCreateInfo renderInfo = data.config.renderInfo;
+    if (renderInfo.colorAttachmentCount > 0)
+    {
+        renderInfo.pColorAttachmentFormats = &data.config.colorAttachmentFormat;
+    }
+
     VkGraphicsPipelineCreateInfo pipelineInfo = {
     	.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-    	.pNext = &data.config.renderInfo,
+    	.pNext = &renderInfo,
+    	.flags = data.config.flags,
     	.stageCount = static_cast<u32>(data.shaderStages.stages.size()),
     	.pStages = data.shaderStages.stages.data(),
     	.pVertexInputState = &vertexInputInfo,
@@ -82,7 +91,7 @@ VkPipeline PipelineBuilder::BuildPipeline(VkDevice device, const PipelineData& d
 	pipelineInfo.pDynamicState = &dynamicInfo;
 
     VkPipeline pipeline;
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo,
+	if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo,
 		nullptr, &pipeline) != VK_SUCCESS)
 	{
 		LOG(ERR, "Failed to create pipeline");
@@ -101,6 +110,15 @@ PipelineBuilder& PipelineBuilder::SetShaders(VkShaderModule vertexShader, VkShad
 	return *this;
 }
 
+PipelineBuilder& PipelineBuilder::SetSpecialization(const VkSpecializationInfo* info)
+{
+    for (VkPipelineShaderStageCreateInfo& stage : data.shaderStages.stages)
+    {
+        stage.pSpecializationInfo = info;
+    }
+	return *this;
+}
+
 PipelineBuilder& PipelineBuilder::SetInputTopology(VkPrimitiveTopology topology)
 {
     data.config.inputAssembly.topology = topology;
@@ -228,3 +246,9 @@ PipelineBuilder& PipelineBuilder::Layout(VkPipelineLayout& layout)
 	return *this;
 }
 
+PipelineBuilder& PipelineBuilder::SetFlags(VkPipelineCreateFlags flags)
+{
+	data.config.flags = flags;
+	return *this;
+}
+
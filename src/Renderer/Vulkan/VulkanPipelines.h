@@ -24,6 +24,7 @@ namespace GraphicsAPI::Vulkan
 		VkPipelineRenderingCreateInfo renderInfo = {};
 		VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
 		VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+		VkPipelineCreateFlags flags = 0;
 	};
 
 	struct PipelineData
@@ -48,8 +49,10 @@ namespace GraphicsAPI::Vulkan
 
 		static void Clear(PipelineData& data);
 
-		VkPipeline       BuildPipeline(VkDevice device, const PipelineData& data);
+		VkPipeline       BuildPipeline(VkDevice device, const PipelineData& data, VkPipelineCache cache = VK_NULL_HANDLE);
 		PipelineBuilder& SetShaders(VkShaderModule vertexShader, VkShaderModule fragmentShader);
+		// Applies to every stage set so far, call after SetShaders. The info is referenced, not copied.
+		PipelineBuilder& SetSpecialization(const VkSpecializationInfo* info);
 		PipelineBuilder& SetInputTopology(VkPrimitiveTopology topology);
 		PipelineBuilder& SetPolygonMode(VkPolygonMode mode);
 		PipelineBuilder& SetCullMode(VkCullModeFlags cullMode, VkFrontFace frontFace);
@@ -62,6 +65,7 @@ namespace GraphicsAPI::Vulkan
 		PipelineBuilder& EnableBlendingAdditive();
 		PipelineBuilder& EnableBlendingAlphaBlend();
 		PipelineBuilder& Layout(VkPipelineLayout& layout);
+		PipelineBuilder& SetFlags(VkPipelineCreateFlags flags);
 	};
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,466 @@
+//
+// Created by Orgest on 10/24/2024.
+//
+
+#include "VulkanRenderGraph.h"
+
+#include <algorithm>
+
+#include "VulkanImages.h"
+
+using namespace GraphicsAPI::Vulkan;
+
+RenderGraph::Pass& RenderGraph::Pass::Read(Resource resource, Usage usage)
+{
+	accesses.push_back({ .resource = resource, .usage = usage, .write = false });
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::Write(Resource resource, Usage usage)
+{
+	accesses.push_back({ .resource = resource, .usage = usage, .write = true });
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::KeepAlive()
+{
+	keepAlive = true;
+	return *this;
+}
+
+void RenderGraph::Init(VkDevice device, VmaAllocator allocator, u32 framesInFlight)
+{
+	transients_.Init(device, allocator, framesInFlight);
+}
+
+void RenderGraph::Destroy()
+{
+	transients_.Destroy();
+	Reset();
+	imageHistory_.clear();
+	bufferHistory_.clear();
+}
+
+void RenderGraph::Reset()
+{
+	resources_.clear();
+	passes_.clear();
+}
+
+void RenderGraph::ResetHistory()
+{
+	imageHistory_.clear();
+	bufferHistory_.clear();
+}
+
+void RenderGraph::ForgetImage(VkImage image)
+{
+	imageHistory_.erase(image);
+}
+
+void RenderGraph::ForgetBuffer(VkBuffer buffer)
+{
+	bufferHistory_.erase(buffer);
+}
+
+RenderGraph::Resource RenderGraph::ImportImage(const char* name, const ImageImport& import)
+{
+	ResourceEntry entry
+	{
+		.name = name,
+		.image = import.image,
+		.aspect = import.aspect,
+		.finalLayout = import.finalLayout
+	};
+
+	if (auto it = imageHistory_.find(import.image); it != imageHistory_.end())
+	{
+		entry.state = it->second;
+	}
+	if (!import.preserveContents)
+	{
+		entry.state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+	// Makes the first barrier wait for the semaphore, like the acquire of a swapchain image
+	entry.state.writeStages |= import.waitStage;
+
+	resources_.push_back(entry);
+	return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::ImportBuffer(const char* name, VkBuffer buffer)
+{
+	ResourceEntry entry{ .name = name, .buffer = buffer };
+	if (auto it = bufferHistory_.find(buffer); it != bufferHistory_.end())
+	{
+		entry.state = it->second;
+	}
+
+	resources_.push_back(entry);
+	return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::CreateImage(const char* name, const ImageDesc& desc)
+{
+	resources_.push_back({ .name = name, .aspect = desc.aspect, .transient = true, .isImage = true, .imageDesc = desc });
+	return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::CreateBuffer(const char* name, const BufferDesc& desc)
+{
+	resources_.push_back({ .name = name, .transient = true, .bufferDesc = desc });
+	return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Pass& RenderGraph::AddPass(const char* name, std::function<void(VkCommandBuffer)>&& execute)
+{
+	Pass& pass = passes_.emplace_back();
+	pass.name = name;
+	pass.execute = std::move(execute);
+	return pass;
+}
+
+RenderGraph::UsageInfo RenderGraph::GetUsageInfo(Usage usage)
+{
+	switch (usage)
+	{
+	case Usage::ColorAttachment:
+		return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+		         VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	case Usage::DepthAttachment:
+		return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		         VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		         VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL };
+	case Usage::ComputeStorage:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+		         VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+	case Usage::ComputeSampled:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE,
+		         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	case Usage::FragmentSampled:
+		return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE,
+		         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	case Usage::TransferSrc:
+		return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_ACCESS_2_NONE,
+		         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+	case Usage::TransferDst:
+		return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+	case Usage::IndirectRead:
+		return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_2_NONE,
+		         VK_IMAGE_LAYOUT_UNDEFINED };
+	}
+	return { VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+	         VK_IMAGE_LAYOUT_GENERAL };
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk backwards from the graph's outputs, a pass lives if a live pass (or the outside) reads what it writes
+	std::vector<bool> needed(resources_.size(), false);
+	for (size_t i = 0; i < resources_.size(); i++)
+	{
+		needed[i] = resources_[i].finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	alive_.assign(passes_.size(), false);
+	for (size_t p = passes_.size(); p-- > 0;)
+	{
+		const Pass& pass = passes_[p];
+		bool live = pass.keepAlive;
+		for (const Pass::Access& access : pass.accesses)
+		{
+			live |= access.write && needed[access.resource];
+		}
+		if (!live)
+		{
+			continue;
+		}
+
+		alive_[p] = true;
+		for (const Pass::Access& access : pass.accesses)
+		{
+			// Attachments are loaded, so writing one also reads what earlier passes left in it
+			if (!access.write || access.usage == Usage::ColorAttachment)
+			{
+				needed[access.resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::AllocateTransients(u64 frame)
+{
+	// Pass range and everything done to each transient by the passes that survived culling
+	const size_t count = resources_.size();
+	std::vector<u32> firstPass(count, ~0u);
+	std::vector<u32> lastPass(count, 0);
+	std::vector<VkPipelineStageFlags2> stages(count, VK_PIPELINE_STAGE_2_NONE);
+	std::vector<VkAccessFlags2> writes(count, VK_ACCESS_2_NONE);
+
+	for (u32 p = 0; p < passes_.size(); p++)
+	{
+		if (!alive_[p])
+		{
+			continue;
+		}
+		for (const Pass::Access& access : passes_[p].accesses)
+		{
+			if (!resources_[access.resource].transient)
+			{
+				continue;
+			}
+			const UsageInfo info = GetUsageInfo(access.usage);
+			firstPass[access.resource] = std::min(firstPass[access.resource], p);
+			lastPass[access.resource]  = std::max(lastPass[access.resource], p);
+			stages[access.resource] |= info.stages;
+			writes[access.resource] |= access.write ? info.writeAccess : VK_ACCESS_2_NONE;
+		}
+	}
+
+	std::vector<TransientAllocator::Request> requests;
+	std::vector<Resource> requested;
+	for (Resource r = 0; r < count; r++)
+	{
+		const ResourceEntry& entry = resources_[r];
+		if (!entry.transient || firstPass[r] == ~0u)
+		{
+			continue;
+		}
+		requests.push_back({
+			.image = entry.isImage,
+			.imageDesc = entry.imageDesc,
+			.bufferDesc = entry.bufferDesc,
+			.firstPass = firstPass[r],
+			.lastPass = lastPass[r]
+		});
+		requested.push_back(r);
+	}
+
+	const std::span<const TransientAllocator::Allocation> allocations = transients_.Realize(requests, frame);
+
+	VkPipelineStageFlags2 frameStages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 frameAccess = VK_ACCESS_2_NONE;
+	for (u32 i = 0; i < requested.size(); i++)
+	{
+		ResourceEntry& entry = resources_[requested[i]];
+		entry.image  = allocations[i].image;
+		entry.view   = allocations[i].view;
+		entry.buffer = allocations[i].buffer;
+
+		// The first use has to wait for whoever had the bytes before: last frame's transients and the earlier
+		// resources of this frame it aliases
+		entry.state = { .writeStages = heapStages_, .writeAccess = heapAccess_ };
+		for (u32 j = 0; j < requested.size(); j++)
+		{
+			if (lastPass[requested[j]] < firstPass[requested[i]] && transients_.Aliases(i, j))
+			{
+				entry.state.writeStages |= stages[requested[j]];
+				entry.state.writeAccess |= writes[requested[j]];
+			}
+		}
+
+		frameStages |= stages[requested[i]];
+		frameAccess |= writes[requested[i]];
+	}
+
+	heapStages_ = frameStages;
+	heapAccess_ = frameAccess;
+}
+
+void RenderGraph::Compile(u64 frame)
+{
+	CullPasses();
+	AllocateTransients(frame);
+}
+
+void RenderGraph::Transition(ResourceEntry& entry, VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+                             VkImageLayout layout, bool write)
+{
+	State& state = entry.state;
+	const bool image = entry.image != VK_NULL_HANDLE;
+	const bool layoutChange = image && state.layout != layout;
+
+	VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+	if (write || layoutChange)
+	{
+		// Write after write needs the old writes made available, write after read only has to wait for the readers
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+	}
+	else if ((stages & ~state.readStages) != 0 || (access & ~state.readAccess) != 0)
+	{
+		// Read after write from a stage that hasn't been synchronized with the last write yet
+		srcStages = state.writeStages;
+		srcAccess = state.writeAccess;
+	}
+
+	if (write || layoutChange)
+	{
+		// A layout transition counts as a write, later readers have to wait for it
+		state.writeStages = stages;
+		state.writeAccess = write ? access : VK_ACCESS_2_NONE;
+		state.readStages  = write ? VK_PIPELINE_STAGE_2_NONE : stages;
+		state.readAccess  = write ? VK_ACCESS_2_NONE : access;
+	}
+	else
+	{
+		state.readStages |= stages;
+		state.readAccess |= access;
+	}
+
+	// Nothing to wait for and nothing to transition, e.g. the first use of a buffer
+	if (srcStages == VK_PIPELINE_STAGE_2_NONE && !layoutChange)
+	{
+		return;
+	}
+
+	if (image)
+	{
+		imageBarriers_.push_back({
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcStageMask = srcStages,
+			.srcAccessMask = srcAccess,
+			.dstStageMask = stages,
+			.dstAccessMask = access,
+			.oldLayout = state.layout,
+			.newLayout = layout,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = entry.image,
+			.subresourceRange = VkImages::ImageSubresourceRange(entry.aspect)
+		});
+		state.layout = layout;
+	}
+	else
+	{
+		bufferBarriers_.push_back({
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+			.srcStageMask = srcStages,
+			.srcAccessMask = srcAccess,
+			.dstStageMask = stages,
+			.dstAccessMask = access,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = entry.buffer,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE
+		});
+	}
+}
+
+void RenderGraph::Execute(VkCommandBuffer cmd)
+{
+	culledPasses_ = 0;
+	barrierCount_ = 0;
+	batchCount_   = 0;
+
+	auto flushBarriers = [&]()
+	{
+		if (imageBarriers_.empty() && bufferBarriers_.empty())
+		{
+			return;
+		}
+
+		VkDependencyInfo depInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.bufferMemoryBarrierCount = static_cast<u32>(bufferBarriers_.size()),
+			.pBufferMemoryBarriers = bufferBarriers_.data(),
+			.imageMemoryBarrierCount = static_cast<u32>(imageBarriers_.size()),
+			.pImageMemoryBarriers = imageBarriers_.data()
+		};
+		vkCmdPipelineBarrier2(cmd, &depInfo);
+
+		barrierCount_ += depInfo.bufferMemoryBarrierCount + depInfo.imageMemoryBarrierCount;
+		batchCount_++;
+		imageBarriers_.clear();
+		bufferBarriers_.clear();
+	};
+
+	struct MergedAccess
+	{
+		VkPipelineStageFlags2 stages{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 access{ VK_ACCESS_2_NONE };
+		VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+		bool write{ false };
+		bool used{ false };
+	};
+	std::vector<MergedAccess> merged(resources_.size());
+
+	for (size_t p = 0; p < passes_.size(); p++)
+	{
+		Pass& pass = passes_[p];
+		if (!alive_[p])
+		{
+			culledPasses_++;
+			continue;
+		}
+
+		const u32 scope = profiler_ ? profiler_->BeginScope(cmd, pass.name, true) : 0;
+
+		std::ranges::fill(merged, MergedAccess{});
+		for (const Pass::Access& access : pass.accesses)
+		{
+			const UsageInfo info = GetUsageInfo(access.usage);
+			MergedAccess& m = merged[access.resource];
+			if (m.used && m.layout != info.layout && resources_[access.resource].image != VK_NULL_HANDLE)
+			{
+				LOG(ERR, "Render graph pass ", pass.name, " uses ", resources_[access.resource].name,
+				    " in two layouts");
+			}
+			m.stages |= info.stages;
+			m.access |= info.readAccess | (access.write ? info.writeAccess : VK_ACCESS_2_NONE);
+			m.layout = info.layout;
+			m.write |= access.write;
+			m.used = true;
+		}
+
+		for (size_t r = 0; r < resources_.size(); r++)
+		{
+			if (merged[r].used)
+			{
+				Transition(resources_[r], merged[r].stages, merged[r].access, merged[r].layout, merged[r].write);
+			}
+		}
+		flushBarriers();
+
+		pass.execute(cmd);
+
+		if (profiler_)
+		{
+			profiler_->EndScope(cmd, scope);
+		}
+	}
+
+	// Hand images leaving the graph over in the layout the outside expects. Whoever takes them (the present) orders
+	// their next use with a semaphore, everything else remembers where it ended for next frame's first barrier.
+	for (ResourceEntry& entry : resources_)
+	{
+		if (entry.transient)
+		{
+			continue;
+		}
+		if (entry.buffer != VK_NULL_HANDLE)
+		{
+			bufferHistory_[entry.buffer] = entry.state;
+			continue;
+		}
+		if (entry.image == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		if (entry.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			imageHistory_[entry.image] = entry.state;
+			continue;
+		}
+		if (entry.finalLayout != entry.state.layout)
+		{
+			Transition(entry, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, entry.finalLayout, false);
+		}
+		imageHistory_.erase(entry.image);
+	}
+	flushBarriers();
+}
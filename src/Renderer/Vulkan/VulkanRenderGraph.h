@@ -0,0 +1,183 @@
+//
+// Created by Orgest on 10/24/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanGpuProfiler.h"
+#include "VulkanHeader.h"
+#include "VulkanTransientAllocator.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	// Rebuilt every frame: import the frame's images and buffers, add passes declaring how they use them, then
+	// Execute. Passes run in the order they were added. Each pass gets one batched vkCmdPipelineBarrier2 with exactly
+	// the stages, access masks and layout transitions its declared usages need, and passes whose output nobody
+	// reads are culled. The last state of every imported image and buffer is remembered across frames, so the first
+	// barrier of a frame waits on the previous frame's work on that resource and nothing more. Images given a final layout
+	// leave the graph and are not remembered, their next use is ordered by a semaphore instead.
+	//
+	// Resources the graph creates itself are transient: they live from the first to the last pass using them and are
+	// placed by the TransientAllocator, so ones that are never alive together share memory.
+	class RenderGraph
+	{
+	public:
+		using Resource = u32;
+		using ImageDesc = TransientAllocator::ImageDesc;
+		using BufferDesc = TransientAllocator::BufferDesc;
+
+		enum class Usage : u8
+		{
+			ColorAttachment,
+			DepthAttachment,
+			ComputeStorage,  // storage image (GENERAL) or storage buffer in a compute shader
+			ComputeSampled,
+			FragmentSampled,
+			TransferSrc,
+			TransferDst,
+			IndirectRead
+		};
+
+		struct ImageImport
+		{
+			VkImage image{ VK_NULL_HANDLE };
+			VkImageAspectFlags aspect{ VK_IMAGE_ASPECT_COLOR_BIT };
+			bool preserveContents{ false };                        // otherwise the first use transitions from UNDEFINED
+			VkPipelineStageFlags2 waitStage{ VK_PIPELINE_STAGE_2_NONE }; // stage the submit's semaphore wait for it blocks
+			VkImageLayout finalLayout{ VK_IMAGE_LAYOUT_UNDEFINED }; // set for images leaving the graph, e.g. presented
+		};
+
+		class Pass
+		{
+		public:
+			// Declaring the same resource twice in a pass merges the usages, their layouts have to agree
+			Pass& Read(Resource resource, Usage usage);
+			Pass& Write(Resource resource, Usage usage);
+			// Never culled, for passes with effects outside the graph
+			Pass& KeepAlive();
+
+		private:
+			friend class RenderGraph;
+
+			struct Access
+			{
+				Resource resource;
+				Usage usage;
+				bool write;
+			};
+
+			std::string name;
+			std::function<void(VkCommandBuffer)> execute;
+			std::vector<Access> accesses;
+			bool keepAlive{ false };
+		};
+
+		void Init(VkDevice device, VmaAllocator allocator, u32 framesInFlight);
+		void Destroy();
+
+		// Drops last frame's passes and resources, the history is kept
+		void Reset();
+		// Forget remembered image and buffer states, call when they are destroyed (e.g. swapchain resize)
+		void ResetHistory();
+		// Same for a single image, e.g. a reallocated draw target whose handle may come back for a new image
+		void ForgetImage(VkImage image);
+		void ForgetBuffer(VkBuffer buffer);
+
+		Resource ImportImage(const char* name, const ImageImport& import);
+		Resource ImportBuffer(const char* name, VkBuffer buffer);
+		// Contents are undefined at the first use every frame
+		Resource CreateImage(const char* name, const ImageDesc& desc);
+		Resource CreateBuffer(const char* name, const BufferDesc& desc);
+
+		// The reference is valid until the next AddPass
+		Pass& AddPass(const char* name, std::function<void(VkCommandBuffer)>&& execute);
+
+		// Culls passes and backs the transient resources with memory, after this their handles are valid
+		void Compile(u64 frame);
+		// Records the barriers and runs the surviving passes
+		void Execute(VkCommandBuffer cmd);
+
+		// Every executed pass, barriers included, becomes a profiler scope named after it
+		void SetProfiler(GpuProfiler* profiler) { profiler_ = profiler; }
+
+		[[nodiscard]] VkImage     GetImage(Resource resource) const { return resources_[resource].image; }
+		[[nodiscard]] VkImageView GetImageView(Resource resource) const { return resources_[resource].view; }
+		[[nodiscard]] VkBuffer    GetBuffer(Resource resource) const { return resources_[resource].buffer; }
+
+		[[nodiscard]] u32 PassCount() const { return static_cast<u32>(passes_.size()); }
+		[[nodiscard]] u32 CulledCount() const { return culledPasses_; }
+		[[nodiscard]] u32 BarrierCount() const { return barrierCount_; }
+		[[nodiscard]] u32 BarrierBatchCount() const { return batchCount_; }
+		[[nodiscard]] const TransientAllocator& Transients() const { return transients_; }
+
+	private:
+		struct State
+		{
+			VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+			VkPipelineStageFlags2 writeStages{ VK_PIPELINE_STAGE_2_NONE };
+			VkAccessFlags2 writeAccess{ VK_ACCESS_2_NONE };
+			VkPipelineStageFlags2 readStages{ VK_PIPELINE_STAGE_2_NONE }; // already synchronized with the last write
+			VkAccessFlags2 readAccess{ VK_ACCESS_2_NONE };
+		};
+
+		struct ResourceEntry
+		{
+			const char* name;
+			VkImage image{ VK_NULL_HANDLE };
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			VkImageAspectFlags aspect{};
+			VkImageLayout finalLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+			State state;
+
+			// Transient resources only
+			bool transient{ false };
+			bool isImage{ false };
+			VkImageView view{ VK_NULL_HANDLE };
+			ImageDesc imageDesc{};
+			BufferDesc bufferDesc{};
+		};
+
+		struct UsageInfo
+		{
+			VkPipelineStageFlags2 stages;
+			VkAccessFlags2 readAccess;
+			VkAccessFlags2 writeAccess;
+			VkImageLayout layout;
+		};
+
+		static UsageInfo GetUsageInfo(Usage usage);
+		void CullPasses();
+		void AllocateTransients(u64 frame);
+		// Appends the barrier moving the resource into the given stages, access and layout, if one is needed
+		void Transition(ResourceEntry& entry, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout,
+		                bool write);
+
+		std::vector<ResourceEntry> resources_;
+		std::vector<Pass> passes_;
+		std::vector<bool> alive_;
+		std::unordered_map<VkImage, State> imageHistory_;
+		std::unordered_map<VkBuffer, State> bufferHistory_;
+
+		TransientAllocator transients_;
+		GpuProfiler* profiler_{ nullptr };
+		// Everything last frame's transients did to the shared heaps, the first use of one this frame waits on it
+		VkPipelineStageFlags2 heapStages_{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 heapAccess_{ VK_ACCESS_2_NONE };
+
+		// Scratch, reused between passes and frames
+		std::vector<VkImageMemoryBarrier2> imageBarriers_;
+		std::vector<VkBufferMemoryBarrier2> bufferBarriers_;
+
+		u32 culledPasses_{ 0 };
+		u32 barrierCount_{ 0 };
+		u32 batchCount_{ 0 };
+	};
+}
+
+#endif
@@ -0,0 +1,156 @@
+//
+// Created by Orgest on 10/28/2024.
+//
+
+#include "VulkanRenderProxies.h"
+
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
+
+#include "VulkanLoader.h"
+
+using namespace GraphicsAPI::Vulkan;
+
+RenderProxies::Handle RenderProxies::Add(const MeshAsset* mesh, const GeoSurface* surface, MaterialInstance* material,
+                                         const glm::mat4& transform)
+{
+	const Handle proxy = source_.Count();
+	source_.transforms.push_back(transform);
+	source_.previousTransforms.push_back(transform);
+	source_.bounds.push_back(WorldSphere(*surface, transform));
+	source_.meshes.push_back(mesh);
+	source_.surfaces.push_back(surface);
+	source_.materials.push_back(material);
+	source_.dynamic.push_back(0);
+	source_.staticVersion++;
+	stale_.push_back(0);
+	moving_.push_back(0);
+	MarkDirty(proxy);
+	return proxy;
+}
+
+void RenderProxies::BeginStep()
+{
+	// Proxies that moved last step start this one at rest, unless they are moved again
+	for (const Handle proxy : movingList_)
+	{
+		source_.previousTransforms[proxy] = source_.transforms[proxy];
+		moving_[proxy] = 0;
+		MarkDirty(proxy);
+	}
+	movingList_.clear();
+}
+
+void RenderProxies::SetTransform(Handle proxy, const glm::mat4& transform)
+{
+	if (!source_.dynamic[proxy])
+	{
+		source_.dynamic[proxy] = 1;
+		source_.staticVersion++;
+	}
+	if (!moving_[proxy])
+	{
+		source_.previousTransforms[proxy] = source_.transforms[proxy];
+		moving_[proxy] = 1;
+		movingList_.push_back(proxy);
+	}
+	source_.transforms[proxy] = transform;
+	source_.bounds[proxy] = WorldSphere(*source_.surfaces[proxy], transform);
+	MarkDirty(proxy);
+}
+
+void RenderProxies::SetMaterial(Handle proxy, MaterialInstance* material)
+{
+	source_.materials[proxy] = material;
+	if (!source_.dynamic[proxy])
+	{
+		source_.staticVersion++;
+	}
+	MarkDirty(proxy);
+}
+
+void RenderProxies::MarkDirty(Handle proxy)
+{
+	for (u32 b = 0; b < BUFFER_COUNT; b++)
+	{
+		if (!(stale_[proxy] & (1u << b)))
+		{
+			staleLists_[b].push_back(proxy);
+		}
+	}
+	stale_[proxy] = ALL_BUFFERS;
+}
+
+void RenderProxies::Publish()
+{
+	// Bring the buffer up to date with everything written since it was last published
+	Snapshot& target = buffers_[writeIndex_];
+	const size_t count = source_.transforms.size();
+	target.transforms.resize(count);
+	target.previousTransforms.resize(count);
+	target.bounds.resize(count);
+	target.meshes.resize(count);
+	target.surfaces.resize(count);
+	target.materials.resize(count);
+	target.dynamic.resize(count);
+
+	std::vector<Handle>& staleList = staleLists_[writeIndex_];
+	for (const Handle proxy : staleList)
+	{
+		target.transforms[proxy]         = source_.transforms[proxy];
+		target.previousTransforms[proxy] = source_.previousTransforms[proxy];
+		target.bounds[proxy]             = source_.bounds[proxy];
+		target.meshes[proxy]             = source_.meshes[proxy];
+		target.surfaces[proxy]           = source_.surfaces[proxy];
+		target.materials[proxy]          = source_.materials[proxy];
+		target.dynamic[proxy]            = source_.dynamic[proxy];
+		stale_[proxy] &= static_cast<u8>(~(1u << writeIndex_));
+	}
+	publishedWrites_ = static_cast<u32>(staleList.size());
+	staleList.clear();
+	target.sequence = ++sequence_;
+	target.staticVersion = source_.staticVersion;
+
+	// Release orders the writes above before the reader can see the index, the buffer handed back is the one
+	// published before (never taken) or the one the reader let go of
+	writeIndex_ = published_.exchange(writeIndex_ | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+const RenderProxies::Snapshot& RenderProxies::Acquire()
+{
+	if (published_.load(std::memory_order_relaxed) & FRESH_BIT)
+	{
+		readIndex_ = published_.exchange(readIndex_, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+	return buffers_[readIndex_];
+}
+
+glm::mat4 RenderProxies::Interpolate(const glm::mat4& from, const glm::mat4& to, f32 t)
+{
+	auto decompose = [](const glm::mat4& m, glm::vec3& scale, glm::quat& rotation)
+	{
+		scale = { glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])) };
+		rotation = glm::quat_cast(glm::mat3(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y, glm::vec3(m[2]) / scale.z));
+	};
+
+	glm::vec3 fromScale, toScale;
+	glm::quat fromRotation, toRotation;
+	decompose(from, fromScale, fromRotation);
+	decompose(to, toScale, toRotation);
+
+	const glm::vec3 scale = glm::mix(fromScale, toScale, t);
+	glm::mat4 result = glm::mat4_cast(glm::slerp(fromRotation, toRotation, t));
+	result[0] *= scale.x;
+	result[1] *= scale.y;
+	result[2] *= scale.z;
+	result[3] = glm::mix(from[3], to[3], t);
+	return result;
+}
+
+glm::vec4 RenderProxies::WorldSphere(const GeoSurface& surface, const glm::mat4& transform)
+{
+	const f32 scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+	                             glm::length(glm::vec3(transform[2])) });
+	const glm::vec3 center = glm::vec3(transform * glm::vec4(surface.bounds.origin, 1.f));
+	return { center, surface.bounds.sphereRadius * scale };
+}
@@ -0,0 +1,95 @@
+//
+// Created by Orgest on 10/28/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include <atomic>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "../../Core/PrimTypes.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	struct GeoSurface;
+	struct MaterialInstance;
+	struct MeshAsset;
+
+	// Render side copy of every mesh surface in the scene, one proxy per MeshNode surface. The simulation writes into
+	// its own copy and Publish() hands a snapshot to the render thread; snapshots live in BUFFER_COUNT SoA buffers
+	// that rotate through a single atomic, so neither side ever locks or waits on the other. Publishing copies only
+	// the proxies written since the buffer being filled was last published, a static scene costs nothing per frame.
+	//
+	// Transforms are kept for the last two simulation steps, the renderer blends between them (see Interpolate).
+	//
+	// Proxies start out static. The first SetTransform makes a proxy dynamic for good, so renderers can keep whatever
+	// they derive from the static ones until staticVersion changes.
+	//
+	// One writer thread (Add, BeginStep, Set*, Publish) and one reader thread (Acquire).
+	class RenderProxies
+	{
+	public:
+		using Handle = u32;
+
+		// One buffer for the reader, one for the writer and one published in between
+		static constexpr u32 BUFFER_COUNT = 3;
+
+		struct Snapshot
+		{
+			std::vector<glm::mat4>         transforms;
+			std::vector<glm::mat4>         previousTransforms; // one simulation step earlier
+			std::vector<glm::vec4>         bounds;    // world space bounding sphere, xyz center and w radius
+			std::vector<const MeshAsset*>  meshes;    // index and vertex buffers of the surface
+			std::vector<const GeoSurface*> surfaces;  // index range, LODs and meshlets
+			std::vector<MaterialInstance*> materials;
+			std::vector<u8>                dynamic;   // moved since it was added, 0 while it never has
+			u64 sequence{ 0 };      // Publish() that produced it, 0 before the first
+			u64 staticVersion{ 0 }; // changes whenever a static proxy is added, moved or given another material
+
+			[[nodiscard]] u32 Count() const { return static_cast<u32>(transforms.size()); }
+		};
+
+		// Writer side. Call BeginStep before every simulation step that may move proxies.
+		void   BeginStep();
+		Handle Add(const MeshAsset* mesh, const GeoSurface* surface, MaterialInstance* material, const glm::mat4& transform);
+		void   SetTransform(Handle proxy, const glm::mat4& transform);
+		void   SetMaterial(Handle proxy, MaterialInstance* material);
+		void   Publish();
+
+		// Reader side. The newest published snapshot, it stays untouched until the next Acquire.
+		const Snapshot& Acquire();
+
+		// Blend between two transforms, translation and scale linearly and rotation spherically. Shear is not kept.
+		static glm::mat4 Interpolate(const glm::mat4& from, const glm::mat4& to, f32 t);
+
+		// Writer side statistics, proxies in total and written by the last Publish
+		[[nodiscard]] u32 Count() const { return source_.Count(); }
+		[[nodiscard]] u32 PublishedWrites() const { return publishedWrites_; }
+
+	private:
+		void MarkDirty(Handle proxy);
+		static glm::vec4 WorldSphere(const GeoSurface& surface, const glm::mat4& transform);
+
+		static constexpr u32 INDEX_MASK = 0x3;
+		static constexpr u32 FRESH_BIT  = 0x4; // set by Publish, cleared by the Acquire that takes the buffer
+		static constexpr u8  ALL_BUFFERS = (1u << BUFFER_COUNT) - 1;
+
+		Snapshot source_;            // writer's copy, always current
+		Snapshot buffers_[BUFFER_COUNT];
+		std::vector<u8> stale_;      // per proxy, bit b set while buffers_[b] misses its latest value
+		std::vector<u8> moving_;     // per proxy, moved in the current step
+		std::vector<Handle> movingList_;
+		std::vector<Handle> staleLists_[BUFFER_COUNT]; // proxies with their bit set, by buffer
+		u64 sequence_{ 0 };
+		u32 publishedWrites_{ 0 };
+
+		u32 writeIndex_{ 0 };        // writer only
+		u32 readIndex_{ 1 };         // reader only
+		std::atomic<u32> published_{ 2 }; // the buffer in between, plus FRESH_BIT
+	};
+}
+
+#endif
@@ -3,10 +3,102 @@
 //
 
 #include "VulkanSceneNode.h"
+
+#include <algorithm>
+
 #include "VulkanLoader.h"
+#include "VulkanRenderProxies.h"
+#include "../FrustumCullCache.h"
+#include "../OcclusionCuller.h"
 
 using namespace GraphicsAPI::Vulkan;
 
+namespace
+{
+	// Coarsest level whose object space error stays under the pixel threshold at the surface's distance,
+	// using the bounding sphere's closest point so the choice is conservative
+	const MeshLod* SelectLod(const GeoSurface& surface, const glm::mat4& nodeMatrix, const glm::vec4& worldSphere,
+	                         const DrawContext& ctx)
+	{
+		const f32 scale = std::max({ glm::length(glm::vec3(nodeMatrix[0])), glm::length(glm::vec3(nodeMatrix[1])),
+		                             glm::length(glm::vec3(nodeMatrix[2])) });
+
+		const glm::vec4 center = ctx.view * glm::vec4(glm::vec3(worldSphere), 1.f);
+		const f32 distance = -center.z - worldSphere.w;
+		if (distance <= 0.f)
+		{
+			return nullptr; // camera inside or right at the bounds
+		}
+
+		const f32 pixelsPerUnit = ctx.lodProjScale * scale / distance;
+		const MeshLod* selected = nullptr;
+		for (const MeshLod& lod : surface.lods)
+		{
+			if (lod.error * pixelsPerUnit > ctx.lodErrorPixels)
+			{
+				break;
+			}
+			selected = &lod;
+		}
+		return selected;
+	}
+}
+
+RenderObject GraphicsAPI::Vulkan::MakeRenderObject(const MeshAsset& mesh, const GeoSurface& surface,
+                                                   MaterialInstance* material, const glm::mat4& nodeMatrix)
+{
+	return RenderObject
+	{
+		.indexCount = surface.count,
+		.firstIndex = surface.startIndex,
+		.indexBuffer = mesh.meshBuffers.indexBuffer.buffer,
+		.material = material,
+		.transform = nodeMatrix,
+		.vertexBufferAddress = mesh.meshBuffers.vertexBufferAddress,
+		.meshletBufferAddress = surface.meshletCount > 0
+			? mesh.meshBuffers.meshletBufferAddress + surface.firstMeshlet * sizeof(GPUMeshlet)
+			: 0,
+		.meshletCount = surface.meshletCount
+	};
+}
+
+void GraphicsAPI::Vulkan::ApplyLod(RenderObject& object, const GeoSurface& surface, const glm::vec4& worldSphere,
+                                   DrawContext& ctx)
+{
+	if (ctx.lodProjScale <= 0.f || surface.lods.empty())
+	{
+		return;
+	}
+
+	if (const MeshLod* lod = SelectLod(surface, object.transform, worldSphere, ctx))
+	{
+		ctx.lodTrianglesSaved += (surface.count - lod->count) / 3;
+		object.indexCount = lod->count;
+		object.firstIndex = lod->startIndex;
+		object.meshletBufferAddress = 0;
+		object.meshletCount = 0; // meshlets only cover LOD 0
+	}
+}
+
+void GraphicsAPI::Vulkan::AddSurface(const MeshAsset& mesh, const GeoSurface& surface, MaterialInstance* material,
+                                     const glm::mat4& nodeMatrix, const glm::vec4& worldSphere, DrawContext& ctx)
+{
+	if (ctx.frustum && !ctx.frustum->IsVisible(worldSphere))
+	{
+		return;
+	}
+	if (ctx.occlusion && !ctx.occlusion->IsVisible(nodeMatrix, surface.bounds.origin, surface.bounds.extents))
+	{
+		return;
+	}
+
+	RenderObject def = MakeRenderObject(mesh, surface, material, nodeMatrix);
+	ApplyLod(def, surface, worldSphere, ctx);
+
+	// Add render object to opaque surfaces
+	ctx.OpaqueSurfaces.push_back(def);
+}
+
 // Implementation of Node::RefreshTransform
 void Node::RefreshTransform(const glm::mat4& parentMatrix)
 {
@@ -17,36 +109,47 @@ void Node::RefreshTransform(const glm::mat4& parentMatrix)
 	}
 }
 
-// Implementation of Node::Draw
-void Node::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
+void Node::SetLocalTransform(const glm::mat4& transform)
+{
+	localTransform = transform;
+	transformDirty = true;
+}
+
+void Node::RegisterProxies(const glm::mat4& topMatrix, RenderProxies& renderProxies)
 {
 	for (auto& child : children)
 	{
-		child->Draw(topMatrix, ctx);
+		child->RegisterProxies(topMatrix, renderProxies);
 	}
 }
 
-// Implementation of MeshNode::Draw
-void MeshNode::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
+void Node::UpdateProxies(const glm::mat4& topMatrix, const glm::mat4& parentMatrix, RenderProxies& renderProxies,
+                         bool parentMoved)
 {
-	glm::mat4 nodeMatrix = topMatrix * worldTransform;
-
-	for (auto& s : mesh->surfaces)
+	const bool moved = parentMoved || transformDirty;
+	if (moved)
 	{
-		RenderObject def
+		worldTransform = parentMatrix * localTransform;
+		transformDirty = false;
+		for (const u32 proxy : proxies)
 		{
-			.indexCount = s.count,
-			.firstIndex = s.startIndex,
-			.indexBuffer = mesh->meshBuffers.indexBuffer.buffer,
-			.material = &s.material->data,
-			.transform = nodeMatrix,
-			.vertexBufferAddress = mesh->meshBuffers.vertexBufferAddress
-		};
+			renderProxies.SetTransform(proxy, topMatrix * worldTransform);
+		}
+	}
 
-		// Add render object to opaque surfaces
-		ctx.OpaqueSurfaces.push_back(def);
+	for (auto& child : children)
+	{
+		child->UpdateProxies(topMatrix, worldTransform, renderProxies, moved);
+	}
+}
+
+void MeshNode::RegisterProxies(const glm::mat4& topMatrix, RenderProxies& renderProxies)
+{
+	proxies.clear();
+	for (GeoSurface& s : mesh->surfaces)
+	{
+		proxies.push_back(renderProxies.Add(mesh.get(), &s, &s.material->data, topMatrix * worldTransform));
 	}
 
-	// Recursively call Draw on child nodes
-	Node::Draw(topMatrix, ctx);
+	Node::RegisterProxies(topMatrix, renderProxies);
 }
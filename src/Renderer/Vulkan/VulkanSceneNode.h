@@ -3,39 +3,51 @@
 #include <memory>
 #include <vector>
 #include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
 #include <vulkan/vulkan.h>
 
 #include "../../Core/PrimTypes.h"
 
 using NodeID = u32;
 
+namespace GraphicsAPI
+{
+	class FrustumCullCache;
+	class OcclusionCuller;
+}
+
 namespace GraphicsAPI::Vulkan
 {
 	// Forward declarations
 	struct MaterialInstance;
 	struct MeshAsset;
+	struct GeoSurface;
 	struct DrawContext;
+	class RenderProxies;
 
-	class IRenderable
+	struct Node
 	{
-	public:
-		virtual ~IRenderable() = default;
-		virtual void Draw(const glm::mat4& topMatrix, DrawContext& ctx) = 0;
-	};
+		virtual ~Node() = default;
 
-	struct Node : IRenderable
-	{
 		std::weak_ptr<Node> parent;
 		std::vector<std::shared_ptr<Node>> children;
 
 		glm::mat4 localTransform;
 		glm::mat4 worldTransform;
+		bool transformDirty{ false }; // localTransform changed since the proxies were last updated
+		std::vector<u32> proxies;     // render proxies of the node's surfaces, empty unless it draws
 
 		// Refresh the transformation matrix of the node
 		void RefreshTransform(const glm::mat4& parentMatrix);
 
-		// Draw the node and its children
-		void Draw(const glm::mat4& topMatrix, DrawContext& ctx) override;
+		// For the simulation, the change reaches the render proxies with the next UpdateProxies
+		void SetLocalTransform(const glm::mat4& transform);
+
+		// Render proxies of the node and its children. UpdateProxies recomputes world transforms below dirty nodes
+		// and writes only the proxies that moved.
+		virtual void RegisterProxies(const glm::mat4& topMatrix, RenderProxies& renderProxies);
+		void UpdateProxies(const glm::mat4& topMatrix, const glm::mat4& parentMatrix, RenderProxies& renderProxies,
+		                   bool parentMoved);
 	};
 
 	// Drawable mesh node class
@@ -43,8 +55,7 @@ namespace GraphicsAPI::Vulkan
 	{
 		std::shared_ptr<MeshAsset> mesh;
 
-		// Draw method for MeshNode
-		void Draw(const glm::mat4& topMatrix, DrawContext& ctx) override;
+		void RegisterProxies(const glm::mat4& topMatrix, RenderProxies& renderProxies) override; // one per surface
 	};
 
 	// Structure to hold rendering-related data
@@ -58,6 +69,14 @@ namespace GraphicsAPI::Vulkan
 
 		glm::mat4         transform;
 		VkDeviceAddress   vertexBufferAddress;
+
+		// Full detail draws of meshlet split surfaces, culled per cluster on the GPU (see VkEngine::CullMeshlets)
+		VkDeviceAddress   meshletBufferAddress{};
+		u32               meshletCount{};
+		u32               clusterDrawIndex{ NO_CLUSTER_DRAW }; // filled by CullMeshlets, indexes its count buffer
+		u32               clusterCommandOffset{};
+
+		static constexpr u32 NO_CLUSTER_DRAW = ~0u;
 	};
 
 	// Structure to hold a list of RenderObjects
@@ -65,5 +84,28 @@ namespace GraphicsAPI::Vulkan
 	{
 		std::vector<RenderObject> OpaqueSurfaces;
 		std::vector<RenderObject> TransparentSurfaces;
+
+		// Optional CPU frustum and occlusion tests applied before surfaces are added
+		FrustumCullCache* frustum = nullptr;
+		const OcclusionCuller* occlusion = nullptr;
+
+		// LOD selection: a level is picked when its error projects to at most lodErrorPixels on screen.
+		// lodProjScale is proj[1][1] * viewport height / 2 (pixels per unit at distance 1), 0 disables LODs.
+		glm::mat4 view{ 1.f };
+		f32       lodProjScale = 0.f;
+		f32       lodErrorPixels = 1.f;
+		u32       lodTrianglesSaved = 0;
 	};
+
+	// Full detail RenderObject of one surface
+	RenderObject MakeRenderObject(const MeshAsset& mesh, const GeoSurface& surface, MaterialInstance* material,
+	                              const glm::mat4& nodeMatrix);
+
+	// Swaps the object's index range for the coarsest LOD the context allows, worldSphere as for AddSurface
+	void ApplyLod(RenderObject& object, const GeoSurface& surface, const glm::vec4& worldSphere, DrawContext& ctx);
+
+	// Frustum and occlusion tests, LOD pick and RenderObject of one render proxy surface.
+	// worldSphere is the surface's bounding sphere under nodeMatrix, xyz center and w radius.
+	void AddSurface(const MeshAsset& mesh, const GeoSurface& surface, MaterialInstance* material,
+	                const glm::mat4& nodeMatrix, const glm::vec4& worldSphere, DrawContext& ctx);
 }
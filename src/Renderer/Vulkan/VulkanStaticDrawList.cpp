@@ -0,0 +1,133 @@
+//
+// Created by Orgest on 10/30/2024.
+//
+
+#include "VulkanStaticDrawList.h"
+
+#include <algorithm>
+#include <tuple>
+#include <glm/common.hpp>
+
+#include "VulkanLoader.h"
+#include "../FrustumCullCache.h"
+#include "../OcclusionCuller.h"
+
+using namespace GraphicsAPI::Vulkan;
+
+bool StaticDrawList::Update(const RenderProxies::Snapshot& proxies)
+{
+	if (proxies.staticVersion == version_)
+	{
+		return false;
+	}
+
+	Build(proxies);
+	version_ = proxies.staticVersion;
+	rebuilds_++;
+	return true;
+}
+
+void StaticDrawList::Build(const RenderProxies::Snapshot& proxies)
+{
+	struct Entry
+	{
+		glm::ivec3 cell;
+		RenderProxies::Handle proxy;
+	};
+
+	std::vector<Entry> entries;
+	entries.reserve(proxies.Count());
+	dynamic_.clear();
+	for (RenderProxies::Handle proxy = 0; proxy < proxies.Count(); proxy++)
+	{
+		if (proxies.dynamic[proxy])
+		{
+			dynamic_.push_back(proxy);
+			continue;
+		}
+		const glm::vec3 center(proxies.bounds[proxy]);
+		entries.push_back({ glm::ivec3(glm::floor(center / cellSize)), proxy });
+	}
+
+	// Cell first so every cell is one range, then the state RecordGeometryDraws rebinds on
+	auto key = [&](const Entry& e)
+	{
+		const MaterialInstance* material = proxies.materials[e.proxy];
+		return std::make_tuple(e.cell.x, e.cell.y, e.cell.z, material->pipeline, material,
+		                       proxies.meshes[e.proxy]->meshBuffers.indexBuffer.buffer);
+	};
+	std::ranges::sort(entries, [&](const Entry& a, const Entry& b) { return key(a) < key(b); });
+
+	cells_.clear();
+	objects_.clear();
+	surfaces_.clear();
+	bounds_.clear();
+	objects_.reserve(entries.size());
+	surfaces_.reserve(entries.size());
+	bounds_.reserve(entries.size());
+
+	glm::vec3 boxMin{}, boxMax{};
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const RenderProxies::Handle proxy = entries[i].proxy;
+		const glm::vec4& sphere = proxies.bounds[proxy];
+		if (i == 0 || entries[i].cell != entries[i - 1].cell)
+		{
+			cells_.push_back({ .first = static_cast<u32>(objects_.size()), .count = 0 });
+			boxMin = glm::vec3(sphere) - sphere.w;
+			boxMax = glm::vec3(sphere) + sphere.w;
+		}
+
+		objects_.push_back(MakeRenderObject(*proxies.meshes[proxy], *proxies.surfaces[proxy], proxies.materials[proxy],
+		                                    proxies.transforms[proxy]));
+		surfaces_.push_back(proxies.surfaces[proxy]);
+		bounds_.push_back(sphere);
+
+		// Members may reach past the cell, the box grows to hold them
+		Cell& cell = cells_.back();
+		cell.count++;
+		boxMin = glm::min(boxMin, glm::vec3(sphere) - sphere.w);
+		boxMax = glm::max(boxMax, glm::vec3(sphere) + sphere.w);
+		cell.center = (boxMin + boxMax) * 0.5f;
+		cell.extents = (boxMax - boxMin) * 0.5f;
+	}
+}
+
+void StaticDrawList::Emit(DrawContext& ctx)
+{
+	culledCells_ = 0;
+	const glm::mat4 identity{ 1.f };
+	const bool lods = ctx.lodProjScale > 0.f;
+
+	for (const Cell& cell : cells_)
+	{
+		if (ctx.occlusion && !ctx.occlusion->IsVisible(identity, cell.center, cell.extents))
+		{
+			culledCells_++;
+			continue;
+		}
+
+		// A visible cell can still hide some of its members
+		for (u32 i = cell.first; i < cell.first + cell.count; i++)
+		{
+			// Frustum results are cached per object, indexed like objects_
+			if (ctx.frustum && !ctx.frustum->IsStaticVisible(i, bounds_[i]))
+			{
+				continue;
+			}
+
+			const GeoSurface& surface = *surfaces_[i];
+			if (cell.count > 1 && ctx.occlusion &&
+			    !ctx.occlusion->IsVisible(objects_[i].transform, surface.bounds.origin, surface.bounds.extents))
+			{
+				continue;
+			}
+
+			ctx.OpaqueSurfaces.push_back(objects_[i]);
+			if (lods)
+			{
+				ApplyLod(ctx.OpaqueSurfaces.back(), surface, bounds_[i], ctx);
+			}
+		}
+	}
+}
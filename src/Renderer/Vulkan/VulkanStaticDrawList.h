@@ -0,0 +1,67 @@
+//
+// Created by Orgest on 10/30/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "VulkanRenderProxies.h"
+#include "VulkanSceneNode.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	// Retained draw list of the static render proxies. The RenderObjects are built once, bucketed into a uniform grid
+	// of cells and sorted by pipeline, material and index buffer inside each cell, then reused every frame until the
+	// snapshot's staticVersion says a static proxy was added, moved or given another material. A frame only tests the
+	// cells against the occlusion buffer and copies the survivors out, LODs are still picked per surface since they
+	// depend on the camera. Dynamic proxies are listed for the caller to generate per frame.
+	class StaticDrawList
+	{
+	public:
+		// Rebuilds when the static set changed since the last call, returns whether it did
+		bool Update(const RenderProxies::Snapshot& proxies);
+
+		// Appends the surfaces of every cell passing ctx.occlusion to ctx.OpaqueSurfaces, static frustum results are
+		// looked up in ctx.frustum by the surface's index, call FrustumCullCache::ResetStatic after every rebuild
+		void Emit(DrawContext& ctx);
+
+		// Proxies left out of the list, in handle order
+		[[nodiscard]] const std::vector<RenderProxies::Handle>& Dynamic() const { return dynamic_; }
+
+		[[nodiscard]] u32 SurfaceCount() const { return static_cast<u32>(objects_.size()); }
+		[[nodiscard]] u32 CellCount() const { return static_cast<u32>(cells_.size()); }
+		[[nodiscard]] u32 Rebuilds() const { return rebuilds_; }
+		// Cells rejected by the last Emit
+		[[nodiscard]] u32 CulledCells() const { return culledCells_; }
+
+		// World units per cell edge, applies from the next rebuild
+		f32 cellSize{ 32.f };
+
+	private:
+		struct Cell
+		{
+			glm::vec3 center;  // of the box around every member's bounding sphere
+			glm::vec3 extents; // half size
+			u32 first;         // into objects_
+			u32 count;
+		};
+
+		void Build(const RenderProxies::Snapshot& proxies);
+
+		std::vector<Cell> cells_;
+		std::vector<RenderObject> objects_;       // cell after cell
+		std::vector<const GeoSurface*> surfaces_; // parallel to objects_, for the LOD pick and occlusion test
+		std::vector<glm::vec4> bounds_;           // parallel to objects_, world bounding sphere
+		std::vector<RenderProxies::Handle> dynamic_;
+
+		u64 version_{ 0 }; // staticVersion the list was built from, 0 before the first build
+		u32 rebuilds_{ 0 };
+		u32 culledCells_{ 0 };
+	};
+}
+
+#endif
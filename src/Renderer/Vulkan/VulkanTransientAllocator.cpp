@@ -0,0 +1,285 @@
+//
+// Created by Orgest on 10/25/2024.
+//
+
+#include "VulkanTransientAllocator.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "VulkanInitializers.h"
+
+using namespace GraphicsAPI::Vulkan;
+
+void TransientAllocator::Init(VkDevice device, VmaAllocator allocator, u32 framesInFlight)
+{
+	device_         = device;
+	allocator_      = allocator;
+	framesInFlight_ = framesInFlight;
+}
+
+void TransientAllocator::Destroy()
+{
+	for (Generation& generation : retired_)
+	{
+		DestroyGeneration(generation);
+	}
+	retired_.clear();
+	DestroyGeneration(current_);
+	current_ = {};
+	requests_.clear();
+	peakBytes_  = 0;
+	naiveBytes_ = 0;
+}
+
+bool TransientAllocator::SameRequests(std::span<const Request> a, std::span<const Request> b)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		const Request& x = a[i];
+		const Request& y = b[i];
+		if (x.image != y.image || x.firstPass != y.firstPass || x.lastPass != y.lastPass)
+		{
+			return false;
+		}
+		if (x.image)
+		{
+			const ImageDesc& p = x.imageDesc;
+			const ImageDesc& q = y.imageDesc;
+			if (p.extent.width != q.extent.width || p.extent.height != q.extent.height ||
+			    p.extent.depth != q.extent.depth || p.format != q.format || p.usage != q.usage || p.aspect != q.aspect)
+			{
+				return false;
+			}
+		}
+		else if (x.bufferDesc.size != y.bufferDesc.size || x.bufferDesc.usage != y.bufferDesc.usage)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+std::span<const TransientAllocator::Allocation> TransientAllocator::Realize(std::span<const Request> requests,
+                                                                           u64 frame)
+{
+	// Whatever was retired framesInFlight frames ago can't be in use anymore
+	std::erase_if(retired_, [&](Generation& generation)
+	{
+		if (generation.retiredFrame + framesInFlight_ > frame)
+		{
+			return false;
+		}
+		DestroyGeneration(generation);
+		return true;
+	});
+
+	if (SameRequests(requests, requests_))
+	{
+		return current_.allocations;
+	}
+
+	if (!current_.allocations.empty() || !current_.heaps.empty())
+	{
+		current_.retiredFrame = frame;
+		retired_.push_back(std::move(current_));
+		current_ = {};
+	}
+	requests_.assign(requests.begin(), requests.end());
+	Place(requests);
+
+	return current_.allocations;
+}
+
+void TransientAllocator::Place(std::span<const Request> requests)
+{
+	std::vector<Allocation>& allocations = current_.allocations;
+	allocations.assign(requests.size(), {});
+	std::vector<VkMemoryRequirements> memoryRequirements(requests.size());
+
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		const Request& request = requests[i];
+		if (request.image)
+		{
+			VkImageCreateInfo imageInfo = VkInfo::ImageInfo(request.imageDesc.format, request.imageDesc.usage,
+			                                                request.imageDesc.extent);
+			VK_CHECK(vkCreateImage(device_, &imageInfo, nullptr, &allocations[i].image));
+			vkGetImageMemoryRequirements(device_, allocations[i].image, &memoryRequirements[i]);
+		}
+		else
+		{
+			VkBufferCreateInfo bufferInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+				.size = request.bufferDesc.size,
+				.usage = request.bufferDesc.usage
+			};
+			VK_CHECK(vkCreateBuffer(device_, &bufferInfo, nullptr, &allocations[i].buffer));
+			vkGetBufferMemoryRequirements(device_, allocations[i].buffer, &memoryRequirements[i]);
+		}
+		allocations[i].size = memoryRequirements[i].size;
+	}
+
+	// Largest first packs tighter, ties keep request order so the placement is stable
+	std::vector<u32> order(requests.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::ranges::stable_sort(order, [&](u32 a, u32 b) { return allocations[a].size > allocations[b].size; });
+
+	struct Heap
+	{
+		bool image;
+		u32 memoryTypeBits;
+		VkDeviceSize size;
+		VkDeviceSize alignment;
+		std::vector<u32> members;
+	};
+	std::vector<Heap> heaps;
+
+	const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+	vmaGetMemoryProperties(allocator_, &memoryProperties);
+	auto hasDeviceLocal = [&](u32 memoryTypeBits)
+	{
+		for (u32 type = 0; type < memoryProperties->memoryTypeCount; type++)
+		{
+			if ((memoryTypeBits & (1u << type)) != 0 &&
+			    (memoryProperties->memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	naiveBytes_ = 0;
+	for (const u32 index : order)
+	{
+		const Request& request = requests[index];
+		const VkMemoryRequirements& requirements = memoryRequirements[index];
+		naiveBytes_ += requirements.size;
+
+		// Depth and color images often report different type bits that still overlap, the heap narrows to the
+		// types every member accepts
+		auto heapIt = std::ranges::find_if(heaps, [&](const Heap& heap)
+		{
+			return heap.image == request.image && hasDeviceLocal(heap.memoryTypeBits & requirements.memoryTypeBits);
+		});
+		if (heapIt == heaps.end())
+		{
+			heaps.push_back({ .image = request.image, .memoryTypeBits = requirements.memoryTypeBits });
+			heapIt = heaps.end() - 1;
+		}
+		Heap& heap = *heapIt;
+		heap.memoryTypeBits &= requirements.memoryTypeBits;
+
+		// Byte ranges taken by members alive at the same time as this request, by offset
+		std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+		for (const u32 member : heap.members)
+		{
+			const Request& other = requests[member];
+			if (other.firstPass <= request.lastPass && request.firstPass <= other.lastPass)
+			{
+				taken.emplace_back(allocations[member].offset, allocations[member].offset + allocations[member].size);
+			}
+		}
+		std::ranges::sort(taken);
+
+		const VkDeviceSize alignment = requirements.alignment;
+		VkDeviceSize offset = 0;
+		for (const auto& [begin, end] : taken)
+		{
+			if (offset + requirements.size <= begin)
+			{
+				break;
+			}
+			offset = std::max(offset, (end + alignment - 1) / alignment * alignment);
+		}
+
+		allocations[index].heap   = static_cast<u32>(heapIt - heaps.begin());
+		allocations[index].offset = offset;
+		heap.size      = std::max(heap.size, offset + requirements.size);
+		heap.alignment = std::max(heap.alignment, alignment);
+		heap.members.push_back(index);
+	}
+
+	peakBytes_ = 0;
+	for (const Heap& heap : heaps)
+	{
+		VkMemoryRequirements requirements
+		{
+			.size = heap.size,
+			.alignment = heap.alignment,
+			.memoryTypeBits = heap.memoryTypeBits
+		};
+		VmaAllocationCreateInfo allocInfo
+		{
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+			.requiredFlags = static_cast<VkMemoryPropertyFlags>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+
+		VmaAllocation heapAllocation = VK_NULL_HANDLE;
+		VK_CHECK(vmaAllocateMemory(allocator_, &requirements, &allocInfo, &heapAllocation, nullptr));
+		current_.heaps.push_back(heapAllocation);
+		peakBytes_ += heap.size;
+
+		for (const u32 member : heap.members)
+		{
+			Allocation& allocation = allocations[member];
+			if (heap.image)
+			{
+				VK_CHECK(vmaBindImageMemory2(allocator_, heapAllocation, allocation.offset, allocation.image, nullptr));
+
+				const ImageDesc& desc = requests[member].imageDesc;
+				VkImageViewCreateInfo viewInfo = VkInfo::ImageViewInfo(desc.format, allocation.image, desc.aspect);
+				VK_CHECK(vkCreateImageView(device_, &viewInfo, nullptr, &allocation.view));
+			}
+			else
+			{
+				VK_CHECK(vmaBindBufferMemory2(allocator_, heapAllocation, allocation.offset, allocation.buffer, nullptr));
+			}
+		}
+	}
+
+	if (!requests.empty())
+	{
+		LOG(INFO, "Transient resources: ", requests.size(), " in ", heaps.size(), " heaps, ", peakBytes_, " bytes (",
+		    naiveBytes_, " without aliasing)");
+	}
+}
+
+bool TransientAllocator::Aliases(u32 a, u32 b) const
+{
+	const Allocation& x = current_.allocations[a];
+	const Allocation& y = current_.allocations[b];
+	return x.heap == y.heap && x.offset < y.offset + y.size && y.offset < x.offset + x.size;
+}
+
+void TransientAllocator::DestroyGeneration(Generation& generation) const
+{
+	for (const Allocation& allocation : generation.allocations)
+	{
+		if (allocation.view != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(device_, allocation.view, nullptr);
+		}
+		if (allocation.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImage(device_, allocation.image, nullptr);
+		}
+		if (allocation.buffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(device_, allocation.buffer, nullptr);
+		}
+	}
+	for (const VmaAllocation heap : generation.heaps)
+	{
+		vmaFreeMemory(allocator_, heap);
+	}
+	generation.allocations.clear();
+	generation.heaps.clear();
+}
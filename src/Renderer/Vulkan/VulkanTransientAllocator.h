@@ -0,0 +1,97 @@
+//
+// Created by Orgest on 10/25/2024.
+//
+
+#pragma once
+#ifdef VULKAN_BUILD
+
+#include <span>
+#include <vector>
+
+#include "VulkanHeader.h"
+
+namespace GraphicsAPI::Vulkan
+{
+	// Places a frame's transient images and buffers into shared memory heaps. Every request carries the pass range
+	// it is used in; requests whose ranges don't overlap may share bytes. Placement is greedy, largest first, at the
+	// lowest offset not used by a request alive at the same time. Images share a heap whenever their memory types
+	// have a device local one in common, so e.g. a depth buffer and a later color target can alias. Images and
+	// buffers never share a heap, which keeps bufferImageGranularity out of the picture.
+	//
+	// Resources and heaps are kept while the requests stay identical from frame to frame. A different set is placed
+	// from scratch and the old one destroyed once the frames in flight that may still use it have finished.
+	class TransientAllocator
+	{
+	public:
+		struct ImageDesc
+		{
+			VkExtent3D extent{};
+			VkFormat format{ VK_FORMAT_UNDEFINED };
+			VkImageUsageFlags usage{};
+			VkImageAspectFlags aspect{ VK_IMAGE_ASPECT_COLOR_BIT };
+		};
+
+		struct BufferDesc
+		{
+			VkDeviceSize size{};
+			VkBufferUsageFlags usage{};
+		};
+
+		struct Request
+		{
+			bool image{ false };
+			ImageDesc imageDesc{};
+			BufferDesc bufferDesc{};
+			u32 firstPass{};
+			u32 lastPass{};
+		};
+
+		struct Allocation
+		{
+			VkImage image{ VK_NULL_HANDLE };
+			VkImageView view{ VK_NULL_HANDLE };
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			u32 heap{};
+			VkDeviceSize offset{};
+			VkDeviceSize size{};
+		};
+
+		void Init(VkDevice device, VmaAllocator allocator, u32 framesInFlight);
+		void Destroy();
+
+		// One allocation per request, in request order
+		std::span<const Allocation> Realize(std::span<const Request> requests, u64 frame);
+
+		// True when the two allocations of the current set share bytes
+		[[nodiscard]] bool Aliases(u32 a, u32 b) const;
+
+		// Heap memory of the current set, and what it would take with a dedicated allocation per resource
+		[[nodiscard]] VkDeviceSize PeakBytes() const { return peakBytes_; }
+		[[nodiscard]] VkDeviceSize NaiveBytes() const { return naiveBytes_; }
+
+	private:
+		struct Generation
+		{
+			std::vector<Allocation> allocations;
+			std::vector<VmaAllocation> heaps;
+			u64 retiredFrame{};
+		};
+
+		static bool SameRequests(std::span<const Request> a, std::span<const Request> b);
+		void Place(std::span<const Request> requests);
+		void DestroyGeneration(Generation& generation) const;
+
+		VkDevice device_{ VK_NULL_HANDLE };
+		VmaAllocator allocator_{ VK_NULL_HANDLE };
+		u32 framesInFlight_{ 1 };
+
+		std::vector<Request> requests_;
+		Generation current_;
+		std::vector<Generation> retired_;
+
+		VkDeviceSize peakBytes_{ 0 };
+		VkDeviceSize naiveBytes_{ 0 };
+	};
+}
+
+#endif
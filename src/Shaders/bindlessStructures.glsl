@@ -0,0 +1,26 @@
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "sceneData.glsl"
+
+struct BindlessMaterial
+{
+    vec4 colorFactors;
+    vec4 metalRoughFactors;
+    uint colorTexture;
+    uint metalRoughTexture;
+    uint features;
+    uint pad0;
+};
+
+// BindlessMaterial.features, the same bits as MaterialFeatures::Index()
+const uint MATERIAL_TEXTURED      = 1;
+const uint MATERIAL_ALPHA_TEST    = 2;
+const uint MATERIAL_VERTEX_COLORS = 4;
+
+// Every registered texture, partially bound so unused slots may stay empty
+layout(set = 1, binding = 0) uniform sampler2D bindlessTextures[];
+
+layout(set = 1, binding = 1) readonly buffer BindlessMaterials
+{
+    BindlessMaterial materials[];
+} bindlessMaterials;
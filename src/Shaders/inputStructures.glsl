@@ -1,17 +1,9 @@
-layout(set = 0, binding = 0) uniform SceneData
-{
-    mat4 view;
-    mat4 proj;
-    mat4 viewproj;
-    vec4 ambientColor;
-    vec4 sunlightDirection; // w for sun power
-    vec4 sunlightColor;
-} sceneData;
+#include "sceneData.glsl"
 
 layout(set = 1, binding = 0) uniform GLTFMaterialData
 {
     vec4 colorFactors;
-    vec4 metalRoughFactors;
+    vec4 metalRoughFactors; // x: metallic, y: roughness, z: alpha cutoff
 
 } materialData;
 
@@ -3,17 +3,27 @@
 #extension GL_GOOGLE_include_directive : require
 #include "inputStructures.glsl"
 
+// Material permutation, see MaterialFeatures
+layout (constant_id = 0) const bool TEXTURED = true;
+layout (constant_id = 1) const bool ALPHA_TEST = false;
+
 layout (location = 0) in vec3 inNormal;
-layout (location = 1) in vec3 inColor;
+layout (location = 1) in vec4 inColor;
 layout (location = 2) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragColor;
 
 void main()
 {
+    vec4 baseColor = TEXTURED ? inColor * texture(colorTex, inUV) : inColor;
+    if (ALPHA_TEST && baseColor.a < materialData.metalRoughFactors.z)
+    {
+        discard;
+    }
+
     float lightValue = max(dot(inNormal, sceneData.sunlightDirection.xyz), 0.1f);
 
-    vec3 color = inColor * texture(colorTex,inUV).xyz;
+    vec3 color = baseColor.xyz;
     vec3 ambient = color *  sceneData.ambientColor.xyz;
 
     outFragColor = vec4(color * lightValue *  sceneData.sunlightColor.w + ambient ,1.0f);
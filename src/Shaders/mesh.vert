@@ -5,8 +5,11 @@
 
 #include "inputStructures.glsl"
 
+// Material permutation, see MaterialFeatures
+layout (constant_id = 2) const bool VERTEX_COLORS = true;
+
 layout (location = 0) out vec3 outNormal;
-layout (location = 1) out vec3 outColor;
+layout (location = 1) out vec4 outColor;
 layout (location = 2) out vec2 outUV;
 
 struct Vertex
@@ -39,7 +42,7 @@ void main()
     gl_Position =  sceneData.viewproj * PushConstants.render_matrix *position;
 
     outNormal = (PushConstants.render_matrix * vec4(v.normal, 0.f)).xyz;
-    outColor = v.color.xyz * materialData.colorFactors.xyz;
+    outColor = VERTEX_COLORS ? v.color * materialData.colorFactors : materialData.colorFactors;
     outUV.x = v.uv_x;
     outUV.y = v.uv_y;
 }
\ No newline at end of file
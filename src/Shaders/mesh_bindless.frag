@@ -0,0 +1,34 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive : require
+#include "bindlessStructures.glsl"
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec4 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) flat in uint inMaterial;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+    BindlessMaterial material = bindlessMaterials.materials[inMaterial];
+
+    // Uniform per draw, so the branches don't diverge within a draw
+    vec4 baseColor = inColor;
+    if ((material.features & MATERIAL_TEXTURED) != 0)
+    {
+        baseColor *= texture(bindlessTextures[nonuniformEXT(material.colorTexture)], inUV);
+    }
+    if ((material.features & MATERIAL_ALPHA_TEST) != 0 && baseColor.a < material.metalRoughFactors.z)
+    {
+        discard;
+    }
+
+    float lightValue = max(dot(inNormal, sceneData.sunlightDirection.xyz), 0.1f);
+
+    vec3 color = baseColor.xyz;
+    vec3 ambient = color *  sceneData.ambientColor.xyz;
+
+    outFragColor = vec4(color * lightValue *  sceneData.sunlightColor.w + ambient ,1.0f);
+}
@@ -0,0 +1,49 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+
+#include "bindlessStructures.glsl"
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec4 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) flat out uint outMaterial;
+
+struct Vertex
+{
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer
+{
+    Vertex vertices[];
+};
+
+// push constants block, materialIndex selects the entry in bindlessMaterials
+layout( push_constant ) uniform constants
+{
+    mat4 render_matrix;
+    VertexBuffer vertexBuffer;
+    uint materialIndex;
+} PushConstants;
+
+void main()
+{
+    Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+    BindlessMaterial material = bindlessMaterials.materials[PushConstants.materialIndex];
+
+    vec4 position = vec4(v.position, 1.0f);
+
+    gl_Position =  sceneData.viewproj * PushConstants.render_matrix *position;
+
+    outNormal = (PushConstants.render_matrix * vec4(v.normal, 0.f)).xyz;
+    outColor = (material.features & MATERIAL_VERTEX_COLORS) != 0 ? v.color * material.colorFactors : material.colorFactors;
+    outUV.x = v.uv_x;
+    outUV.y = v.uv_y;
+    outMaterial = PushConstants.materialIndex;
+}
@@ -0,0 +1,73 @@
+// Culling benchmarks without a window or graphics API, built on every platform so they can run headless and in CI.
+// Exits with 1 when a result is wrong.
+
+#include <cstdlib>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include "../Core/JobSystem.h"
+#include "../Renderer/FrustumCullCache.h"
+#include "../Renderer/OcclusionCuller.h"
+
+namespace
+{
+	u32 Arg(int argc, char** argv, int index, u32 fallback)
+	{
+		return argc > index ? static_cast<u32>(std::strtoul(argv[index], nullptr, 10)) : fallback;
+	}
+
+	// frustum [objects] [frames]: frustum culling cost on a camera fly-through, cached against a full re-cull
+	int RunFrustumBenchmark(int argc, char** argv)
+	{
+		const u32 objects = Arg(argc, argv, 2, 100000);
+		const u32 frames = Arg(argc, argv, 3, 600);
+
+		const GraphicsAPI::FrustumCullBenchmark result = GraphicsAPI::BenchmarkFrustumCulling(objects, frames);
+		fmt::print("Frustum culling, {} objects over {} frames: full re-cull {:.3f} ms, temporal {:.3f} ms per frame, "
+		           "{:.1f} objects re-tested per frame, {} mismatches\n",
+		           result.objects, result.frames, result.fullMs, result.temporalMs, result.retestedPerFrame,
+		           result.mismatches);
+		return result.mismatches == 0 ? 0 : 1;
+	}
+
+	// occlusion [occluders] [occludees] [frames]: software occlusion raster and test cost, checked against a known
+	// scene and against ray casting
+	int RunOcclusionBenchmark(int argc, char** argv)
+	{
+		const u32 occluders = Arg(argc, argv, 2, 256);
+		const u32 occludees = Arg(argc, argv, 3, 20000);
+		const u32 frames = Arg(argc, argv, 4, 120);
+
+		JobSystem jobs;
+		jobs.Init();
+		const GraphicsAPI::OcclusionCullBenchmark result = GraphicsAPI::BenchmarkOcclusionCulling(occluders, occludees,
+		                                                                                        frames, &jobs);
+		jobs.Shutdown();
+
+		fmt::print("Occlusion culling, {} occluders and {} occludees over {} frames: rasterize {:.3f} ms, test {:.3f} ms "
+		           "per frame, {:.1f} visible and {:.1f} culled per frame ({:.1f} hidden by ray cast), {} false culls, "
+		           "{} known case failures\n",
+		           result.occluders, result.occludees, result.frames, result.rasterizeMs, result.testMs,
+		           result.visiblePerFrame, result.culledPerFrame, result.truthCulledPerFrame, result.falseCulls,
+		           result.knownCaseFailures);
+		return result.falseCulls == 0 && result.knownCaseFailures == 0 ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string_view mode = argc > 1 ? argv[1] : "";
+	if (mode == "frustum")
+	{
+		return RunFrustumBenchmark(argc, argv);
+	}
+	if (mode == "occlusion")
+	{
+		return RunOcclusionBenchmark(argc, argv);
+	}
+
+	fmt::print("Usage: CullBenchmark frustum [objects] [frames]\n"
+	           "       CullBenchmark occlusion [occluders] [occludees] [frames]\n");
+	return 2;
+}